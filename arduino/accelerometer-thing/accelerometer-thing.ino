@@ -4,6 +4,8 @@
 #include <core/ts.h>
 #include <Wire.h>
 #include <LSM6.h> // by Pololu 
+#include "imuFifo.h"
+#include "imuFusion.h"
 
 LSM6 imu;
 
@@ -50,6 +52,137 @@ boolean preQuery(void) {
   return true;
 }
 
+// ---------------------------------------------- 2nd Vertex: FIFO Stream 
+// writing a rate (uint16, in Hz) starts the IMU's FIFO at the nearest output rate at-or-above that, 0 stops it, 
+// then we burst it out and push frames of <sampleNum (uint32), count (uint8), flags (uint8), count * <ax, ay, az, gx, gy, gz> (int16)>, 
+// sample numbers count every sample since the stream started, and flags bit 0 means the FIFO overran (and lost some) before this frame 
+#define STREAM_BATCH 12
+#define STREAM_FLAG_OVERRUN 1 
+#define STREAM_MAX_PASSES 4 
+
+// the FIFO runs while either the stream or the orientation filter (3rd Vertex) wants it, at whichever rate was set last 
+boolean streaming = false;
+boolean fusing = false;
+
+boolean setImuRate(uint16_t hz) {
+  if(!imuFifo_setRate(hz)) return false;
+  fusion_setRate(imuFifo_getRate());
+  return true;
+}
+
+EP_ONDATA_RESPONSES onStreamData(uint8_t* data, uint16_t len) {
+  uint16_t rptr = 0;
+  uint16_t hz = ts_readUint16(data, &rptr);
+  if(hz == 0){
+    streaming = false;
+    if(!fusing) imuFifo_setRate(0);
+    return EP_ONDATA_ACCEPT;
+  }
+  if(!setImuRate(hz)) return EP_ONDATA_REJECT;
+  streaming = true;
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint streamEndpoint(&osap, "imuStream", onStreamData);
+
+uint8_t streamData[6 + STREAM_BATCH * 12];
+imuSample_t streamBatch[STREAM_BATCH];
+uint8_t streamCount = 0;
+uint32_t streamSampleNum = 0;
+boolean streamOverrun = false;
+
+// we check the FIFO's level this often, (the filter wants every sample, so we drain it each time), 
+// and ship partial batches after the flush interval, so that slow rates still trickle in 
+uint32_t streamPollInterval = 1000;   // us 
+uint32_t lastStreamPoll = 0;
+uint32_t streamFlushInterval = 50;    // ms 
+uint32_t lastStreamFlush = 0;
+
+void streamShip(void) {
+  uint16_t wptr = 0;
+  ts_writeUint32(streamSampleNum, streamData, &wptr);
+  streamData[wptr ++] = streamCount;
+  streamData[wptr ++] = streamOverrun ? STREAM_FLAG_OVERRUN : 0;
+  for(uint8_t s = 0; s < streamCount; s ++){
+    for(uint8_t axis = 0; axis < 3; axis ++) ts_writeUint16((uint16_t)streamBatch[s].a[axis], streamData, &wptr);
+    for(uint8_t axis = 0; axis < 3; axis ++) ts_writeUint16((uint16_t)streamBatch[s].g[axis], streamData, &wptr);
+  }
+  streamEndpoint.write(streamData, wptr);
+  streamCount = 0;
+  streamOverrun = false;
+  lastStreamFlush = millis();
+}
+
+void streamLoop(void) {
+  if(imuFifo_getRate() == 0.0F) return;
+  if(micros() - lastStreamPoll < streamPollInterval) return;
+  lastStreamPoll = micros();
+  if(!streaming) streamCount = 0;
+  // a few batches at most, so that fast rates can't starve osap.loop() 
+  for(uint8_t pass = 0; pass < STREAM_MAX_PASSES && imuFifo_available() > 0; pass ++){
+    if(streamCount == 0) streamSampleNum = imuFifo_getSampleNum();
+    uint8_t count = imuFifo_read(&streamBatch[streamCount], STREAM_BATCH - streamCount, &streamOverrun);
+    if(count == 0) break;
+    if(fusing){
+      for(uint8_t s = 0; s < count; s ++) fusion_update(&streamBatch[streamCount + s]);
+    }
+    if(streaming){
+      streamCount += count;
+      if(streamCount >= STREAM_BATCH) streamShip();
+    } else {
+      streamOverrun = false;
+    }
+  }
+  if(streaming && streamCount > 0 && millis() - lastStreamFlush > streamFlushInterval) streamShip();
+}
+
+// ---------------------------------------------- 3rd Vertex: Orientation 
+// writing <rate (uint16, Hz), (kp, ki (float32))> starts the on-board filter at that rate (sharing the FIFO w/ the stream), 0 stops it, 
+// and queries return <sampleNum (uint32), w, x, y, z (int16, 2.14), roll, pitch, yaw (float32, degrees)>, 
+// yaw is relative to wherever we were when it started: there's no magnetometer to tell us where north is 
+boolean beforeOrientationQuery(void);
+
+EP_ONDATA_RESPONSES onOrientationData(uint8_t* data, uint16_t len) {
+  uint16_t rptr = 0;
+  uint16_t hz = ts_readUint16(data, &rptr);
+  if(hz == 0){
+    fusing = false;
+    if(!streaming) imuFifo_setRate(0);
+    return EP_ONDATA_ACCEPT;
+  }
+  if(len >= 10){
+    float kp = ts_readFloat32(data, &rptr);
+    float ki = ts_readFloat32(data, &rptr);
+    fusion_setGains(kp, ki);
+  }
+  if(!setImuRate(hz)) return EP_ONDATA_REJECT;
+  fusion_start(imuFifo_getRate());
+  fusing = true;
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint orientationEndpoint(&osap, "orientation", onOrientationData, beforeOrientationQuery);
+
+boolean beforeOrientationQuery(void) {
+  fusionState_t state;
+  fusion_getState(&state);
+  float q[4];
+  for(uint8_t i = 0; i < 4; i ++) q[i] = state.q[i].toFloat();
+  float roll = atan2f(2.0F * (q[0] * q[1] + q[2] * q[3]), 1.0F - 2.0F * (q[1] * q[1] + q[2] * q[2]));
+  float pitch = asinf(constrain(2.0F * (q[0] * q[2] - q[3] * q[1]), -1.0F, 1.0F));
+  float yaw = atan2f(2.0F * (q[0] * q[3] + q[1] * q[2]), 1.0F - 2.0F * (q[2] * q[2] + q[3] * q[3]));
+  uint8_t buf[4 + 4 * 2 + 3 * 4];
+  uint16_t wptr = 0;
+  ts_writeUint32(state.sampleNum, buf, &wptr);
+  // 2.30 down to 2.14,
+  for(uint8_t i = 0; i < 4; i ++) ts_writeUint16((uint16_t)(int16_t)(state.q[i].raw >> 16), buf, &wptr);
+  ts_writeFloat32(roll * RAD_TO_DEG, buf, &wptr);
+  ts_writeFloat32(pitch * RAD_TO_DEG, buf, &wptr);
+  ts_writeFloat32(yaw * RAD_TO_DEG, buf, &wptr);
+  orientationEndpoint.write(buf, wptr);
+  return true;
+}
+
 void setup() {
   osap.init();
   vp_arduinoSerial.begin();
@@ -57,8 +190,11 @@ void setup() {
   Wire.begin();
   imu.init();
   imu.enableDefault();
+  // the FIFO stays off 'till the host asks for a stream, or for orientation 
+  imuFifo_init();
 }
 
 void loop() {
   osap.loop();
+  streamLoop();
 }
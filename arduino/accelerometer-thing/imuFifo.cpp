@@ -0,0 +1,270 @@
+/*
+imuFifo.cpp
+
+the LSM6's hardware FIFO, for continuous accel + gyro streams at up to 1.66 kHz
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#include "imuFifo.h"
+#include <Wire.h>
+
+// ---------------------------------------------- registers
+// the two parts have FIFOs that work differently: the DS33 stores bare 16-bit words in a fixed pattern (gyro xyz, then accel xyz),
+// the DSO stores tagged 7-byte words, and we pair those up ourselves
+#define IMU_ADDR_HIGH 0x6B
+#define IMU_ADDR_LOW 0x6A
+#define IMU_WHO_AM_I 0x0F
+#define IMU_WHO_DS33 0x69
+#define IMU_WHO_DSO 0x6C
+
+#define IMU_CTRL1_XL 0x10
+#define IMU_CTRL2_G 0x11
+#define IMU_FIFO_STATUS1 0x3A
+
+#define DS33_FIFO_CTRL1 0x06
+#define DS33_FIFO_CTRL3 0x08
+#define DS33_FIFO_CTRL5 0x0A
+#define DS33_FIFO_DATA_OUT_L 0x3E
+
+#define DSO_FIFO_CTRL3 0x09
+#define DSO_FIFO_CTRL4 0x0A
+#define DSO_FIFO_DATA_OUT_TAG 0x78
+#define DSO_TAG_GYRO 0x01
+#define DSO_TAG_ACCEL 0x02
+
+#define IMU_FIFO_MODE_BYPASS 0b000
+#define IMU_FIFO_MODE_CONTINUOUS 0b110
+
+// ODR codes are the same for both sensors, on both parts, 1 thru 10:
+const float imuRates[] = { 12.5F, 26.0F, 52.0F, 104.0F, 208.0F, 416.0F, 833.0F, 1660.0F, 3330.0F, 6660.0F };
+#define IMU_RATE_COUNT 10
+// (but the DS33's gyro tops out at 1.66kHz)
+#define IMU_DS33_MAX_CODE 8
+// the DSO goes to 6.66kHz, but at 400kHz I2C, a sample (two tagged words, 14 bytes) takes ~ 0.3ms to read even in bursts,
+// so past 1.66kHz the FIFO fills faster than we can drain it, and all we'd get is overruns
+#define IMU_DSO_MAX_CODE 8
+
+// each DS33 sample is six words, and we pull this many samples per I2C transaction, (SAMD's Wire buffers 256 bytes)
+#define DS33_SAMPLE_BYTES 12
+#define DS33_BURST_SAMPLES 8
+// and the DSO's words are 7 bytes, <tag, x, y, z>, which we also pull a bunch of at a time
+#define DSO_WORD_BYTES 7
+#define DSO_BURST_WORDS 16
+
+#define IMU_NONE 0
+#define IMU_DS33 1
+#define IMU_DSO 2
+
+uint8_t imuAddress = IMU_ADDR_HIGH;
+uint8_t imuType = IMU_NONE;
+uint8_t rateCode = 0;
+uint32_t sampleNum = 0;
+
+// the DSO's accel and gyro words arrive one at a time, so we hold onto one 'till its partner shows up
+imuSample_t dsoPending;
+boolean dsoHaveAccel = false;
+boolean dsoHaveGyro = false;
+
+// ---------------------------------------------- I2C
+static void imu_writeReg(uint8_t reg, uint8_t value){
+  Wire.beginTransmission(imuAddress);
+  Wire.write(reg);
+  Wire.write(value);
+  Wire.endTransmission();
+}
+
+// with IF_INC set (enableDefault() does this), reads carry on thru the registers after reg,
+// except in the FIFO's output, where they roll back to the start of it, so one read can pull many words
+static boolean imu_readRegs(uint8_t reg, uint8_t* dest, uint8_t len){
+  Wire.beginTransmission(imuAddress);
+  Wire.write(reg);
+  if(Wire.endTransmission(false) != 0) return false;
+  if(Wire.requestFrom(imuAddress, len) != len) return false;
+  for(uint8_t b = 0; b < len; b ++){
+    dest[b] = Wire.read();
+  }
+  return true;
+}
+
+static uint8_t imu_readReg(uint8_t reg){
+  uint8_t value = 0;
+  imu_readRegs(reg, &value, 1);
+  return value;
+}
+
+static inline int16_t imu_word(uint8_t* bytes){
+  return (int16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+// ---------------------------------------------- setup
+
+boolean imuFifo_init(void){
+  Wire.setClock(400000);
+  uint8_t candidates[] = { IMU_ADDR_HIGH, IMU_ADDR_LOW };
+  for(uint8_t c = 0; c < 2; c ++){
+    imuAddress = candidates[c];
+    uint8_t who = imu_readReg(IMU_WHO_AM_I);
+    if(who == IMU_WHO_DS33){
+      imuType = IMU_DS33;
+      return true;
+    } else if (who == IMU_WHO_DSO){
+      imuType = IMU_DSO;
+      return true;
+    }
+  }
+  imuType = IMU_NONE;
+  return false;
+}
+
+static void imu_setFifoMode(uint8_t mode){
+  if(imuType == IMU_DS33){
+    imu_writeReg(DS33_FIFO_CTRL5, (rateCode << 3) | mode);
+  } else {
+    imu_writeReg(DSO_FIFO_CTRL4, mode);
+  }
+}
+
+boolean imuFifo_setRate(uint16_t hz){
+  if(imuType == IMU_NONE) return false;
+  // bypass mode empties the FIFO, and stops it
+  if(hz == 0){
+    rateCode = 0;
+    imu_setFifoMode(IMU_FIFO_MODE_BYPASS);
+    return true;
+  }
+  uint8_t code = 0;
+  for(uint8_t r = 0; r < IMU_RATE_COUNT; r ++){
+    if(imuRates[r] >= (float)hz){
+      code = r + 1;
+      break;
+    }
+  }
+  if(code == 0) return false;
+  if(imuType == IMU_DS33 && code > IMU_DS33_MAX_CODE) return false;
+  if(imuType == IMU_DSO && code > IMU_DSO_MAX_CODE) return false;
+  rateCode = code;
+  imu_setFifoMode(IMU_FIFO_MODE_BYPASS);
+  // both sensors at this rate, keeping their full-scale settings,
+  imu_writeReg(IMU_CTRL1_XL, (imu_readReg(IMU_CTRL1_XL) & 0x0F) | (code << 4));
+  imu_writeReg(IMU_CTRL2_G, (imu_readReg(IMU_CTRL2_G) & 0x0F) | (code << 4));
+  if(imuType == IMU_DS33){
+    // no decimation on either (so they're both in every pattern), and no threshold: we poll
+    imu_writeReg(DS33_FIFO_CTRL3, (0b001 << 3) | 0b001);
+    imu_writeReg(DS33_FIFO_CTRL1, 0);
+  } else {
+    imu_writeReg(DSO_FIFO_CTRL3, (code << 4) | code);
+    dsoHaveAccel = false;
+    dsoHaveGyro = false;
+  }
+  sampleNum = 0;
+  imu_setFifoMode(IMU_FIFO_MODE_CONTINUOUS);
+  return true;
+}
+
+float imuFifo_getRate(void){
+  if(rateCode == 0) return 0.0F;
+  return imuRates[rateCode - 1];
+}
+
+uint32_t imuFifo_getSampleNum(void){
+  return sampleNum;
+}
+
+// ---------------------------------------------- reading
+
+uint16_t imuFifo_available(void){
+  if(rateCode == 0) return 0;
+  uint8_t status[2];
+  if(!imu_readRegs(IMU_FIFO_STATUS1, status, 2)) return 0;
+  if(imuType == IMU_DS33){
+    return (status[0] | ((status[1] & 0x0F) << 8)) / 6;
+  } else {
+    return (status[0] | ((status[1] & 0x03) << 8)) / 2;
+  }
+}
+
+static uint8_t imu_readDS33(imuSample_t* dest, uint8_t maxCount, boolean* overrun){
+  // <DIFF_FIFO (12 bits, in words), flags>, <FIFO_PATTERN (10 bits), i.e. which word comes out next>
+  uint8_t status[4];
+  if(!imu_readRegs(IMU_FIFO_STATUS1, status, 4)) return 0;
+  uint16_t words = status[0] | ((status[1] & 0x0F) << 8);
+  if(status[1] & 0x40) *overrun = true;
+  uint16_t pattern = status[2] | ((status[3] & 0x03) << 8);
+  // if we're mid-sample, (i.e. after an overrun), skip to the next whole one
+  uint8_t bytes[DS33_BURST_SAMPLES * DS33_SAMPLE_BYTES];
+  if(pattern != 0){
+    uint8_t skip = 6 - pattern;
+    if(words < skip || !imu_readRegs(DS33_FIFO_DATA_OUT_L, bytes, skip * 2)) return 0;
+    words -= skip;
+  }
+  uint16_t whole = words / 6;
+  uint8_t count = 0;
+  while(count < whole && count < maxCount){
+    uint8_t burst = min((uint16_t)(whole - count), (uint16_t)(maxCount - count));
+    if(burst > DS33_BURST_SAMPLES) burst = DS33_BURST_SAMPLES;
+    if(!imu_readRegs(DS33_FIFO_DATA_OUT_L, bytes, burst * DS33_SAMPLE_BYTES)) break;
+    for(uint8_t s = 0; s < burst; s ++){
+      uint8_t* sample = &bytes[s * DS33_SAMPLE_BYTES];
+      for(uint8_t axis = 0; axis < 3; axis ++){
+        dest[count].g[axis] = imu_word(&sample[axis * 2]);
+        dest[count].a[axis] = imu_word(&sample[6 + axis * 2]);
+      }
+      count ++;
+    }
+  }
+  return count;
+}
+
+static uint8_t imu_readDSO(imuSample_t* dest, uint8_t maxCount, boolean* overrun){
+  uint8_t status[2];
+  if(!imu_readRegs(IMU_FIFO_STATUS1, status, 2)) return 0;
+  uint16_t words = status[0] | ((status[1] & 0x03) << 8);
+  if(status[1] & 0x40) *overrun = true;
+  uint8_t count = 0;
+  // a burst of words, <tag, x, y, z> each, and the tag tells us which sensor it is
+  uint8_t bytes[DSO_BURST_WORDS * DSO_WORD_BYTES];
+  while(words > 0 && count < maxCount){
+    // but no more than we have room for: each sample takes two words, (or one, if its partner's already waiting)
+    // and whatever we read out of the FIFO is gone
+    uint16_t room = (maxCount - count) * 2 - ((dsoHaveAccel || dsoHaveGyro) ? 1 : 0);
+    uint8_t burst = min(min(words, room), (uint16_t)DSO_BURST_WORDS);
+    if(!imu_readRegs(DSO_FIFO_DATA_OUT_TAG, bytes, burst * DSO_WORD_BYTES)) break;
+    words -= burst;
+    for(uint8_t w = 0; w < burst; w ++){
+      uint8_t* word = &bytes[w * DSO_WORD_BYTES];
+      uint8_t tag = word[0] >> 3;
+      if(tag == DSO_TAG_ACCEL){
+        for(uint8_t axis = 0; axis < 3; axis ++) dsoPending.a[axis] = imu_word(&word[1 + axis * 2]);
+        dsoHaveAccel = true;
+      } else if (tag == DSO_TAG_GYRO){
+        for(uint8_t axis = 0; axis < 3; axis ++) dsoPending.g[axis] = imu_word(&word[1 + axis * 2]);
+        dsoHaveGyro = true;
+      }
+      if(dsoHaveAccel && dsoHaveGyro){
+        dest[count ++] = dsoPending;
+        dsoHaveAccel = false;
+        dsoHaveGyro = false;
+      }
+    }
+  }
+  return count;
+}
+
+uint8_t imuFifo_read(imuSample_t* dest, uint8_t maxCount, boolean* overrun){
+  if(rateCode == 0) return 0;
+  uint8_t count;
+  if(imuType == IMU_DS33){
+    count = imu_readDS33(dest, maxCount, overrun);
+  } else {
+    count = imu_readDSO(dest, maxCount, overrun);
+  }
+  sampleNum += count;
+  return count;
+}
@@ -0,0 +1,45 @@
+/*
+imuFifo.h
+
+the LSM6's hardware FIFO, for continuous accel + gyro streams at up to 1.66 kHz,
+the IMU fills it on its own clock, and we burst it out over I2C whenever the loop gets around to it
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#ifndef IMU_FIFO_H_
+#define IMU_FIFO_H_
+
+#include <Arduino.h>
+
+// one sample is both sensors, raw, in the same order as the accelerometerQuery endpoint
+typedef struct imuSample_t {
+  int16_t a[3];
+  int16_t g[3];
+} imuSample_t;
+
+// finds the IMU (an LSM6DS33 or LSM6DSO, at either address), returns false if there isn't one,
+// call it after imu.init() / enableDefault(), which it leaves alone 'till a stream starts
+boolean imuFifo_init(void);
+
+// sets both sensors' output rate to the nearest one at-or-above this (12 Hz to 1660 Hz, on either part), and starts the FIFO,
+// 0 stops it, returns false (and leaves it alone) if the rate is out of range
+boolean imuFifo_setRate(uint16_t hz);
+// the output rate we actually got, in Hz, 0 if we're stopped
+float imuFifo_getRate(void);
+
+// how many whole samples are waiting, (one I2C read)
+uint16_t imuFifo_available(void);
+// reads up to maxCount samples out of the FIFO, returns how many,
+// sets overrun if the FIFO filled up (and dropped samples) since the last read
+uint8_t imuFifo_read(imuSample_t* dest, uint8_t maxCount, boolean* overrun);
+// counts every sample read since the stream started, (the first one in the next read is this number)
+uint32_t imuFifo_getSampleNum(void);
+
+#endif
@@ -0,0 +1,184 @@
+/*
+imuFusion.cpp
+
+complementary (Mahony-style) orientation filter, in fixed point
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#include "imuFusion.h"
+
+// ---------------------------------------------- formats
+// rates are rad/s in 8.24, gains are 16.16, and the sample period (and the gyro's scale) are 2.30,
+// raw readings are whole numbers, and products go thru fp_mulWide before they come back down to these
+typedef Fixed<8, 24> fpOmega_t;
+typedef Fixed<16, 16> fpFusionGain_t;
+typedef Fixed<2, 30> fpPeriod_t;
+typedef Fixed<32, 0> fpRaw_t;
+// quaternion products are summed at full width, and rounded once
+typedef Fixed<4, 60> fpQuatWide_t;
+// as is each sample's (half) rotation, before it's clamped into 2.30
+typedef Fixed<10, 54> fpStepWide_t;
+
+// the full scales that imu.enableDefault() sets, which are the same on both parts:
+// +/- 2g at 0.061 mg / LSB, and +/- 245 (or 250) dps at 8.75 mdps / LSB
+#define FUSION_ONE_G 16393
+#define FUSION_GYRO_RAD_PER_LSB (8.75e-3F * PI / 180.0F)
+// we only trust the accelerometer for gravity when it reads about 1g, (otherwise something is shaking it)
+#define FUSION_ACCEL_TRUST_LOW (FUSION_ONE_G * 85 / 100)
+#define FUSION_ACCEL_TRUST_HIGH (FUSION_ONE_G * 115 / 100)
+// and the bias estimate is clamped to ~ 6 dps
+#define FUSION_BIAS_LIMIT 0.1F
+// this is explicit Euler, so kp * dt has to stay well under 1 or gravity's pull overshoots (and rings), kp is capped to suit the rate
+#define FUSION_KP_DT_MAX 0.5F
+// and no sample turns us more than a radian (half of that goes in h), which 2.30 holds w/ room to spare, even at the slowest rates
+#define FUSION_HALF_STEP_LIMIT 0.5F
+
+constexpr fpQuat_t quatOne = fpQuat_t::fromInt(1);
+const fpPeriod_t gyroScale = fpPeriod_t::fromFloat(FUSION_GYRO_RAD_PER_LSB);
+const fpOmega_t biasLimit = fpOmega_t::fromFloat(FUSION_BIAS_LIMIT);
+const fpStepWide_t halfStepLimit = fpQuat_t::fromFloat(FUSION_HALF_STEP_LIMIT).as<fpStepWide_t>();
+
+static fpQuat_t q[4] = { quatOne, fpQuat_t(), fpQuat_t(), fpQuat_t() };
+static fpOmega_t bias[3];
+static fpPeriod_t halfDt;
+static fpQuat_t kiDt;
+static fpFusionGain_t kp = fpFusionGain_t::fromFloat(2.0F);
+static float userKp = 2.0F;
+static float userKi = 0.05F;
+static float rate = 0.0F;
+static boolean seeded = false;
+static uint32_t fusionSampleNum = 0;
+
+// ---------------------------------------------- maths
+
+static inline fpQuatWide_t fusion_mul(fpQuat_t a, fpQuat_t b){
+  return fp_mulWide(a, b);
+}
+
+// bitwise integer square root,
+static uint32_t fusion_isqrt(uint32_t x){
+  uint32_t result = 0;
+  uint32_t bit = (uint32_t)1 << 30;
+  while(bit > x) bit >>= 2;
+  while(bit != 0){
+    if(x >= result + bit){
+      x -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return result;
+}
+
+// tilt only, from gravity: this runs once per start, so floats are fine
+static void fusion_seed(imuSample_t* sample){
+  float roll = atan2f((float)sample->a[1], (float)sample->a[2]);
+  float pitch = atan2f(-(float)sample->a[0], sqrtf((float)sample->a[1] * sample->a[1] + (float)sample->a[2] * sample->a[2]));
+  float cr = cosf(roll * 0.5F), sr = sinf(roll * 0.5F);
+  float cp = cosf(pitch * 0.5F), sp = sinf(pitch * 0.5F);
+  q[0] = fpQuat_t::fromFloat(cr * cp);
+  q[1] = fpQuat_t::fromFloat(sr * cp);
+  q[2] = fpQuat_t::fromFloat(cr * sp);
+  q[3] = fpQuat_t::fromFloat(-sr * sp);
+  seeded = true;
+}
+
+// ---------------------------------------------- setup
+
+void fusion_setRate(float rateHz){
+  rate = rateHz;
+  if(rate <= 0.0F) return;
+  halfDt = fpPeriod_t::fromFloat(0.5F / rate);
+  kp = fpFusionGain_t::fromFloat(min(userKp, FUSION_KP_DT_MAX * rate));
+  kiDt = fpQuat_t::fromFloat(userKi / rate);
+}
+
+void fusion_start(float rateHz){
+  fusion_setRate(rateHz);
+  for(uint8_t a = 0; a < 3; a ++) bias[a] = fpOmega_t();
+  seeded = false;
+  fusionSampleNum = 0;
+}
+
+void fusion_setGains(float _kp, float _ki){
+  userKp = constrain(_kp, 0.0F, 100.0F);
+  userKi = constrain(_ki, 0.0F, 10.0F);
+  fusion_setRate(rate);
+}
+
+// ---------------------------------------------- the filter
+
+void fusion_update(imuSample_t* sample){
+  if(rate <= 0.0F) return;
+  fusionSampleNum ++;
+  if(!seeded){
+    fusion_seed(sample);
+    return;
+  }
+  // gyro, in rad/s, plus what we've learned of its bias,
+  fpOmega_t omega[3];
+  for(uint8_t a = 0; a < 3; a ++){
+    omega[a] = fp_mulWide(fpRaw_t::fromInt(sample->g[a]), gyroScale).as<fpOmega_t>() + bias[a];
+  }
+  // if the accelerometer reads ~ 1g, the difference between where it says down is and where we think it is
+  // (their cross product) turns us toward it, and integrates into the bias
+  int32_t ax = sample->a[0], ay = sample->a[1], az = sample->a[2];
+  uint32_t mag = fusion_isqrt((uint32_t)(ax * ax) + (uint32_t)(ay * ay) + (uint32_t)(az * az));
+  if(mag > FUSION_ACCEL_TRUST_LOW && mag < FUSION_ACCEL_TRUST_HIGH){
+    // one division, then a unit vector in 2.30
+    uint64_t invMag = ((uint64_t)1 << 45) / mag;
+    fpQuat_t a[3];
+    for(uint8_t i = 0; i < 3; i ++){
+      a[i] = fpQuat_t::fromRaw((int32_t)(((int64_t)sample->a[i] * (int64_t)invMag) >> 15));
+    }
+    // gravity, as we have it, in the sensor's frame
+    fpQuat_t v[3];
+    v[0] = ((fusion_mul(q[1], q[3]) - fusion_mul(q[0], q[2])) << 1).as<fpQuat_t>();
+    v[1] = ((fusion_mul(q[0], q[1]) + fusion_mul(q[2], q[3])) << 1).as<fpQuat_t>();
+    v[2] = (fusion_mul(q[0], q[0]) - fusion_mul(q[1], q[1]) - fusion_mul(q[2], q[2]) + fusion_mul(q[3], q[3])).as<fpQuat_t>();
+    fpQuat_t e[3];
+    e[0] = (fusion_mul(a[1], v[2]) - fusion_mul(a[2], v[1])).as<fpQuat_t>();
+    e[1] = (fusion_mul(a[2], v[0]) - fusion_mul(a[0], v[2])).as<fpQuat_t>();
+    e[2] = (fusion_mul(a[0], v[1]) - fusion_mul(a[1], v[0])).as<fpQuat_t>();
+    for(uint8_t i = 0; i < 3; i ++){
+      bias[i] += fp_mulWide(kiDt, e[i]).as<fpOmega_t>();
+      if(bias[i] > biasLimit) bias[i] = biasLimit;
+      if(bias[i] < -biasLimit) bias[i] = -biasLimit;
+      omega[i] += fp_mulWide(kp, e[i]).as<fpOmega_t>();
+    }
+  }
+  // half of this sample's rotation, (.as<> doesn't saturate, so we do)
+  fpQuat_t h[3];
+  for(uint8_t i = 0; i < 3; i ++){
+    fpStepWide_t step = fp_mulWide(omega[i], halfDt);
+    if(step > halfStepLimit) step = halfStepLimit;
+    if(step < -halfStepLimit) step = -halfStepLimit;
+    h[i] = step.as<fpQuat_t>();
+  }
+  // q += q (x) (0, h)
+  fpQuat_t n[4];
+  n[0] = q[0] - (fusion_mul(q[1], h[0]) + fusion_mul(q[2], h[1]) + fusion_mul(q[3], h[2])).as<fpQuat_t>();
+  n[1] = q[1] + (fusion_mul(q[0], h[0]) + fusion_mul(q[2], h[2]) - fusion_mul(q[3], h[1])).as<fpQuat_t>();
+  n[2] = q[2] + (fusion_mul(q[0], h[1]) - fusion_mul(q[1], h[2]) + fusion_mul(q[3], h[0])).as<fpQuat_t>();
+  n[3] = q[3] + (fusion_mul(q[0], h[2]) + fusion_mul(q[1], h[1]) - fusion_mul(q[2], h[0])).as<fpQuat_t>();
+  // and re-normalize: each step is tiny, so the norm is always ~ 1, and one newton step of 1 / sqrt() (from 1) does it
+  fpQuat_t norm2 = (fusion_mul(n[0], n[0]) + fusion_mul(n[1], n[1]) + fusion_mul(n[2], n[2]) + fusion_mul(n[3], n[3])).as<fpQuat_t>();
+  fpQuat_t inv = quatOne + ((quatOne - norm2) >> 1);
+  for(uint8_t i = 0; i < 4; i ++){
+    q[i] = fusion_mul(n[i], inv).as<fpQuat_t>();
+  }
+}
+
+void fusion_getState(fusionState_t* dest){
+  dest->sampleNum = fusionSampleNum;
+  for(uint8_t i = 0; i < 4; i ++) dest->q[i] = q[i];
+}
@@ -0,0 +1,41 @@
+/*
+imuFusion.h
+
+orientation, from the IMU's FIFO samples: a complementary (Mahony-style) filter on a quaternion, in fixed point,
+the gyro integrates at the IMU's own sample period, and gravity (from the accelerometer) pulls tilt back in
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#ifndef IMU_FUSION_H_
+#define IMU_FUSION_H_
+
+#include <Arduino.h>
+#include <fixedPoint.h>
+#include "imuFifo.h"
+
+// quaternion components (and unit vectors) are 2.30
+typedef Fixed<2, 30> fpQuat_t;
+
+typedef struct fusionState_t {
+  uint32_t sampleNum;   // how many samples have gone in since the start,
+  fpQuat_t q[4];        // w, x, y, z: sensor frame to world, w/ world z up (yaw is relative to where we started)
+} fusionState_t;
+
+// starts over at this sample rate (Hz), w/ tilt from the next sample's gravity, and zero yaw
+void fusion_start(float rateHz);
+// if the IMU's rate changes under us, (but keep the orientation)
+void fusion_setRate(float rateHz);
+// kp (1/s) is how hard gravity pulls, and ki (1/s^2) how fast we learn the gyro's bias, defaults 2 and 0.05,
+// kp is capped at half the sample rate, so that each sample only takes a fraction of the error out
+void fusion_setGains(float kp, float ki);
+void fusion_update(imuSample_t* sample);
+void fusion_getState(fusionState_t* dest);
+
+#endif
@@ -40,23 +40,123 @@ EP_ONDATA_RESPONSES setRGB(uint8_t* data, uint16_t len) {
 
 Endpoint rgbEndpoint(&osap, "setRGB", setRGB);
 
+// ---------------------------------------------- Scanning 
+// measure() blocks for one conversion, so we do one pad per loop(), round-robin, and keep everything we learn here: 
+// each pad's baseline drifts along w/ the untouched reading, touches are some distance above it (w/ hysteresis on release), 
+// and state changes only count after they've held for a few scans of that pad 
+typedef struct padState_t {
+  uint16_t raw;
+  int32_t baseline;     // 12.4, to track slowly w/o losing the fraction 
+  boolean touched;
+  uint8_t count;        // consecutive scans that disagree w/ touched 
+} padState_t;
+
+padState_t pads[N_PAD];
+uint8_t scanPad = 0;
+boolean scanStarted = false;
+
+// in raw counts above the baseline, 
+uint16_t touchThreshold = 100;
+uint16_t releaseThreshold = 60;
+uint8_t debounceScans = 3;
+// the baseline follows rises slowly (so a slow hand doesn't get tracked out) and falls quickly 
+#define BASELINE_RISE_SHIFT 8
+#define BASELINE_FALL_SHIFT 2
+
+uint8_t touchMask(void){
+  uint8_t mask = 0;
+  for(uint8_t p = 0; p < N_PAD; p ++){
+    if(pads[p].touched) mask |= (1 << p);
+  }
+  return mask;
+}
+
+void pushPadEvent(uint8_t p);
+
+void scanLoop(void){
+  padState_t* pad = &pads[scanPad];
+  pad->raw = qt_array[scanPad].measure();
+  if(!scanStarted){
+    pad->baseline = (int32_t)pad->raw << 4;
+  }
+  int32_t delta = (int32_t)pad->raw - (pad->baseline >> 4);
+  boolean disagree = pad->touched ? (delta < releaseThreshold) : (delta > touchThreshold);
+  if(disagree){
+    pad->count ++;
+    if(pad->count >= debounceScans){
+      pad->touched = !pad->touched;
+      pad->count = 0;
+      pushPadEvent(scanPad);
+    }
+  } else {
+    pad->count = 0;
+    // only untouched pads drift, 
+    if(!pad->touched){
+      int32_t error = ((int32_t)pad->raw << 4) - pad->baseline;
+      pad->baseline += (error > 0) ? (error >> BASELINE_RISE_SHIFT) : -((-error) >> BASELINE_FALL_SHIFT);
+    }
+  }
+  scanPad ++;
+  if(scanPad >= N_PAD){
+    scanPad = 0;
+    scanStarted = true;
+  }
+}
+
 // ---------------------------------------------- 2 Vertex
+// the latest readings, from the background scan: <N_PAD * raw (uint16), N_PAD * baseline (uint16), touch mask (uint8)> 
 boolean prePadQuery(void);
 
 Endpoint capacitiveEndpoint(&osap, "capacitivePads", prePadQuery);
 
 boolean prePadQuery(void){
   // stuff vals into yonder buffer
-  uint8_t buf[N_PAD * 2];
+  uint8_t buf[N_PAD * 4 + 1];
   uint16_t wptr = 0;
   for(uint8_t p = 0; p < N_PAD; p ++){
     // void ts_writeUint16(uint16_t val, unsigned char* buf, uint16_t* ptr); 
-    ts_writeUint16(qt_array[p].measure(), buf, &wptr);
+    ts_writeUint16(pads[p].raw, buf, &wptr);
+  }
+  for(uint8_t p = 0; p < N_PAD; p ++){
+    ts_writeUint16(pads[p].baseline >> 4, buf, &wptr);
   }
-  capacitiveEndpoint.write(buf, N_PAD * 2);
+  buf[wptr ++] = touchMask();
+  capacitiveEndpoint.write(buf, wptr);
   return true;
 }
 
+// ---------------------------------------------- 3rd Vertex: Pad Events 
+// pushes <pad (uint8), touched (uint8), touch mask (uint8), time (uint32, us)> on every touch and release, 
+// the mask is every pad's state, so if one event overwrites another before it goes out, we still end up right 
+Endpoint padEventEndpoint(&osap, "padEvents");
+
+void pushPadEvent(uint8_t p){
+  uint8_t buf[7];
+  uint16_t wptr = 0;
+  buf[wptr ++] = p;
+  buf[wptr ++] = pads[p].touched ? 1 : 0;
+  buf[wptr ++] = touchMask();
+  ts_writeUint32(micros(), buf, &wptr);
+  padEventEndpoint.write(buf, wptr);
+}
+
+// ---------------------------------------------- 4th Vertex: Pad Config 
+// <touchThreshold (uint16), releaseThreshold (uint16), debounceScans (uint8)>, thresholds in raw counts above the baseline 
+EP_ONDATA_RESPONSES onPadConfigData(uint8_t* data, uint16_t len){
+  if(len < 5) return EP_ONDATA_REJECT;
+  uint16_t rptr = 0;
+  uint16_t touch = ts_readUint16(data, &rptr);
+  uint16_t release = ts_readUint16(data, &rptr);
+  uint8_t debounce = data[rptr ++];
+  if(release > touch || debounce == 0) return EP_ONDATA_REJECT;
+  touchThreshold = touch;
+  releaseThreshold = release;
+  debounceScans = debounce;
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint padConfigEndpoint(&osap, "padConfig", onPadConfigData);
+
 void setup() {
   osap.init();
   vp_arduinoSerial.begin();
@@ -76,4 +176,5 @@ void setup() {
 
 void loop() {
   osap.loop();
+  scanLoop();
 }
\ No newline at end of file
@@ -1,43 +1,49 @@
-#include <PIDController.h>
 #include <osap.h>
 #include <vt_endpoint.h>
 #include <vp_arduinoSerial.h>
 #include <core/ts.h>
-
-#define PORTA_IN PORT->Group[PORTA].IN
-
-#define READ_FAST(pin) ((PORTA_IN.reg & (1 << pin)) > 0)
-
-#define PIN_IN1 30
-#define PIN_IN2 31
-#define PIN_BPWM 8
-#define PIN_BIN1 9
-#define PIN_BIN2 10
+#include <motionStateMachine.h>
+#include "dcControl.h"
 
 //#define STEPS_PER_TURN 384
 
-int state_now = 0b00;
-int state_prev = 0b00;
-
-//  new new old old
-int lookup_move[] = {0,1,-1,2,-1,0,-2,1,1,-2,0,-1,2,-1,1,0};
-int pos = 0;
-int pos_target = 0;
-
-PIDController pidcontroller;
-
 // message-passing memory allocation 
-#define OSAP_STACK_SIZE 10
+#define OSAP_STACK_SIZE 12
 VPacket messageStack[OSAP_STACK_SIZE];
 // type of board (firmware name)
 OSAP osap("dcencoder", messageStack, OSAP_STACK_SIZE);
 
 VPort_ArduinoSerial vp_arduinoSerial(&osap, "usbSerial", &Serial);
 
+// ---------------------------------------------- profiled setpoints 
+// the motion core's trapezoidal integrator runs here too, in encoder counts: it calls stepper_step() once per count, 
+// and while we're profiled, that walks the control loop's target along, instead of jumping it. 
+// setTarget, setVelocity and setPosition drop out of that, and the next targetState picks up from wherever we are 
+volatile boolean profiled = false;
+
+void stepper_step(boolean dir) {
+  if(profiled) control_stepTarget(dir);
+}
+
+// lines the integrator up w/ the encoder, then hands it the setpoint, this takes one command slot 
+void beginProfile(void) {
+  if(profiled) return;
+  int32_t here = control_getPosition();
+  control_setTarget(here);
+  motion_setPosition(here);
+  profiled = true;
+}
+
 // ---------------------------------------------- 1 Vertex
+// the position target, in counts: an int32, or the old uint16 if that's all that was sent 
 EP_ONDATA_RESPONSES setTarget(uint8_t* data, uint16_t len) {
-  pos_target = ts_readUint16(data, 0);
-  pidcontroller.setpoint(pos_target);
+  uint16_t pt = 0;
+  profiled = false;
+  if(len >= 4){
+    control_setTarget((int32_t)ts_readUint32(data, &pt));
+  } else {
+    control_setTarget(ts_readUint16(data, &pt));
+  }
 
   return EP_ONDATA_ACCEPT;
 }
@@ -52,82 +58,258 @@ EP_ONDATA_RESPONSES setPID(uint8_t* data, uint16_t len) {
   float i_val = ts_readFloat32(data, &pt);
   float d_val = ts_readFloat32(data, &pt);
 
-  pidcontroller.tune(p_val, i_val, d_val); // Tune the PID, arguments: kP, kI, kD
+  control_setGains(p_val, i_val, d_val); // arguments: kP, kI, kD, with I and D per-millisecond 
 
   return EP_ONDATA_ACCEPT;
 }
 
 Endpoint pidEndpoint(&osap, "setPID", setPID);
 
-void setup() {
-  osap.init();
-  vp_arduinoSerial.begin();
+// ---------------------------------------------- 3rd Vertex
+// the control loop's rate, in Hz, as a uint32 
+EP_ONDATA_RESPONSES setRate(uint8_t* data, uint16_t len) {
+  uint16_t pt = 0;
+  uint32_t rate = ts_readUint32(data, &pt);
 
-  pinMode(PIN_BPWM, OUTPUT);
-  pinMode(PIN_BIN1, OUTPUT);
-  pinMode(PIN_BIN2, OUTPUT);
+  if(!control_setRate(rate)) return EP_ONDATA_REJECT;
+
+  return EP_ONDATA_ACCEPT;
+}
 
-  state_now = READ_FAST(PIN_IN1) | (READ_FAST(PIN_IN2) << 1);
-  state_prev = state_now;
+Endpoint rateEndpoint(&osap, "setRate", setRate);
 
-  attachInterrupt(digitalPinToInterrupt(PIN_IN1), pin1_change, CHANGE);
-  attachInterrupt(digitalPinToInterrupt(PIN_IN2), pin2_change, CHANGE);
+// ---------------------------------------------- 4th Vertex
+// the cascaded loop: <posKp, velKp, velKi, maxVel> as float32s, in counts and seconds, w/ velKi per-millisecond, 
+// setting these switches position control over to the cascade, and setPID switches it back 
+EP_ONDATA_RESPONSES setCascade(uint8_t* data, uint16_t len) {
+  uint16_t pt = 0;
+  float posKp = ts_readFloat32(data, &pt);
+  float velKp = ts_readFloat32(data, &pt);
+  float velKi = ts_readFloat32(data, &pt);
+  float maxVel = ts_readFloat32(data, &pt);
 
-  pidcontroller.begin();
-  pidcontroller.tune(20, 1, 0); // Tune the PID, arguments: kP, kI, kD
-  pidcontroller.limit(-255, 255);
+  control_setCascadeGains(posKp, velKp, velKi, maxVel);
 
-  pidcontroller.setpoint(pos_target);
+  return EP_ONDATA_ACCEPT;
 }
 
+Endpoint cascadeEndpoint(&osap, "setCascade", setCascade);
+
+// ---------------------------------------------- 5th Vertex
+// a velocity target, in counts / second (float32), runs the velocity loop alone until the next setTarget 
+EP_ONDATA_RESPONSES setVelocity(uint8_t* data, uint16_t len) {
+  uint16_t pt = 0;
+  profiled = false;
+  control_setVelocityTarget(ts_readFloat32(data, &pt));
 
-void update_pos() {
-  int key = (state_now << 2) | state_prev;
-  pos += lookup_move[key];
-  state_prev = state_now;
+  return EP_ONDATA_ACCEPT;
 }
 
+Endpoint velocityEndpoint(&osap, "setVelocity", setVelocity);
 
-void pin1_change() {
-  if (READ_FAST(PIN_IN1)) {
-    state_now |= 0b01;
-  } else {
-    state_now &= 0b10;
+// ---------------------------------------------- 6th Vertex
+// as the stepper's motionTelemetry: the loop samples every n'th tick, we ship those in batches, 
+// writing a uint16 here sets n, 0 turns it off 
+EP_ONDATA_RESPONSES onTelemetryData(uint8_t* data, uint16_t len) {
+  uint16_t pt = 0;
+  control_setTelemetryDecimation(ts_readUint16(data, &pt));
+
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint telemetryEndpoint(&osap, "controlTelemetry", onTelemetryData);
+
+// frames are <sampleNum (uint32), count (uint8), count * <pos (int32), vel (float32), effort (int16)>> 
+uint8_t telemetryData[5 + CONTROL_TELEMETRY_BATCH * 10];
+controlSample_t telemetryBatch[CONTROL_TELEMETRY_BATCH];
+
+// partial batches go out after this long, so that slow sample rates still trickle in, 
+uint32_t telemetryFlushInterval = 50;
+uint32_t lastTelemetryFlush = 0;
+
+void telemetryLoop(void) {
+  uint8_t available = control_getTelemetryCount();
+  if(available == 0) return;
+  if(available < CONTROL_TELEMETRY_BATCH && lastTelemetryFlush + telemetryFlushInterval > millis()) return;
+  lastTelemetryFlush = millis();
+  uint8_t count = control_drainTelemetry(telemetryBatch, CONTROL_TELEMETRY_BATCH);
+  uint16_t wptr = 0;
+  ts_writeUint32(telemetryBatch[0].sampleNum, telemetryData, &wptr);
+  telemetryData[wptr ++] = count;
+  for(uint8_t s = 0; s < count; s ++){
+    ts_writeUint32((uint32_t)telemetryBatch[s].pos, telemetryData, &wptr);
+    ts_writeFloat32(telemetryBatch[s].vel, telemetryData, &wptr);
+    ts_writeUint16((uint16_t)telemetryBatch[s].effort, telemetryData, &wptr);
   }
-  update_pos();
+  telemetryEndpoint.write(telemetryData, wptr);
 }
 
+// ---------------------------------------------- 7th Vertex
+// queries only: <pos (int32), vel (float32), effort (int16), mode (uint8)> 
+EP_ONDATA_RESPONSES onStateData(uint8_t* data, uint16_t len) { return EP_ONDATA_REJECT; }
 
-void pin2_change() {
-  if (READ_FAST(PIN_IN2)) {
-    state_now |= 0b10;
+boolean beforeStateQuery(void);
+
+Endpoint stateEndpoint(&osap, "controlState", onStateData, beforeStateQuery);
+
+uint8_t stateData[16];
+
+boolean beforeStateQuery(void) {
+  uint16_t wptr = 0;
+  ts_writeUint32((uint32_t)control_getPosition(), stateData, &wptr);
+  ts_writeFloat32(control_getVelocity(), stateData, &wptr);
+  ts_writeUint16((uint16_t)control_getEffort(), stateData, &wptr);
+  stateData[wptr ++] = control_getMode();
+  stateEndpoint.write(stateData, wptr);
+  return true;
+}
+
+// ---------------------------------------------- 8th Vertex
+// profiled targets, in the same frame as the stepper's targetState: <mode (uint8), pos (float32), maxVel, maxAccel, (executeAt, uint32)> 
+// or <mode, vel, maxAccel, (executeAt)>, all in counts and seconds, so synchronizer.js can drive these alongside steppers 
+EP_ONDATA_RESPONSES onProfileTargetData(uint8_t* data, uint16_t len) {
+  // one slot for the target, and one more if we have to line up first 
+  if(motion_getCommandSpace() < (profiled ? 1 : 2)) return EP_ONDATA_WAIT;
+  uint16_t pt = 1;
+  uint32_t executeAt = 0;
+  if(data[0] == MOTION_MODE_POS){
+    float targ = ts_readFloat32(data, &pt);
+    float maxVel = ts_readFloat32(data, &pt);
+    float maxAccel = ts_readFloat32(data, &pt);
+    beginProfile();
+    if(pt + 4 <= len && motion_hostToDeviceTime(ts_readUint32(data, &pt), &executeAt)){
+      motion_setPositionTargetAt(targ, maxVel, maxAccel, executeAt);
+    } else {
+      motion_setPositionTarget(targ, maxVel, maxAccel);
+    }
+  } else if (data[0] == MOTION_MODE_VEL){
+    float targ = ts_readFloat32(data, &pt);
+    float maxAccel = ts_readFloat32(data, &pt);
+    beginProfile();
+    if(pt + 4 <= len && motion_hostToDeviceTime(ts_readUint32(data, &pt), &executeAt)){
+      motion_setVelocityTargetAt(targ, maxAccel, executeAt);
+    } else {
+      motion_setVelocityTarget(targ, maxAccel);
+    }
   } else {
-    state_now &= 0b01;
+    return EP_ONDATA_REJECT;
   }
-  update_pos();
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint profileTargetEndpoint(&osap, "targetState", onProfileTargetData);
+
+// ---------------------------------------------- 9th Vertex
+// as the stepper's motionState, but pos is the encoder's: vel and accel are the profile's, so zero vel means the move is done, 
+// (unless there's a command still in the ring, i.e. a timed target that hasn't started yet, that's the byte on the end) 
+EP_ONDATA_RESPONSES onMotionStateData(uint8_t* data, uint16_t len) { return EP_ONDATA_REJECT; }
+
+boolean beforeMotionStateQuery(void);
+
+Endpoint motionStateEndpoint(&osap, "motionState", onMotionStateData, beforeMotionStateQuery);
+
+uint8_t motionStateData[33];
+
+boolean beforeMotionStateQuery(void) {
+  uint8_t pending = MOTION_COMMAND_SIZE - 1 - motion_getCommandSpace();
+  motionState_t state;
+  motion_getCurrentStates(&state);
+  uint16_t wptr = 0;
+  ts_writeFloat32((float)control_getPosition(), motionStateData, &wptr);
+  ts_writeFloat32(state.vel, motionStateData, &wptr);
+  ts_writeFloat32(state.accel, motionStateData, &wptr);
+  ts_writeFloat32(state.distanceToTarget, motionStateData, &wptr);
+  ts_writeFloat32(state.maxVel, motionStateData, &wptr);
+  ts_writeFloat32(state.maxAccel, motionStateData, &wptr);
+  ts_writeFloat32(state.twoDA, motionStateData, &wptr);
+  ts_writeFloat32(state.vSquared, motionStateData, &wptr);
+  motionStateData[wptr ++] = pending;
+  motionStateEndpoint.write(motionStateData, wptr);
+  return true;
 }
 
+// ---------------------------------------------- 10th Vertex
+// re-numbers the encoder, <pos (float32)> in counts, and holds there 
+EP_ONDATA_RESPONSES onPositionSetData(uint8_t* data, uint16_t len) {
+  if(motion_getCommandSpace() == 0) return EP_ONDATA_WAIT;
+  uint16_t pt = 0;
+  int32_t pos = lroundf(ts_readFloat32(data, &pt));
+  profiled = false;
+  control_setPosition(pos);
+  motion_setPosition(pos);
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint positionSetEndpoint(&osap, "setPosition", onPositionSetData);
 
-int map_pwm(int pwm) {
-  return map(pwm, 0, 255, 32, 255);
+// ---------------------------------------------- 11th Vertex
+// as the stepper's: the host queries our clock, then writes back <hostTime, deviceTime> for its best exchange 
+EP_ONDATA_RESPONSES onTimeSyncData(uint8_t* data, uint16_t len) {
+  uint16_t pt = 0;
+  uint32_t hostTime = ts_readUint32(data, &pt);
+  uint32_t deviceTime = ts_readUint32(data, &pt);
+  motion_syncClock(hostTime, deviceTime);
+  return EP_ONDATA_ACCEPT;
 }
 
-void loop() {
-  int output = pidcontroller.compute(pos);
-
-  if (output == 0) {
-    digitalWrite(PIN_BIN1, LOW);
-    digitalWrite(PIN_BIN2, LOW);
-  } else if (output > 0) {
-    digitalWrite(PIN_BIN1, HIGH);
-    digitalWrite(PIN_BIN2, LOW);
-    analogWrite(PIN_BPWM, map_pwm(output));
-  } else {
-    digitalWrite(PIN_BIN1, LOW);
-    digitalWrite(PIN_BIN2, HIGH);
-    analogWrite(PIN_BPWM, -map_pwm(output));
+boolean beforeTimeSyncQuery(void);
+
+Endpoint timeSyncEndpoint(&osap, "timeSync", onTimeSyncData, beforeTimeSyncQuery);
+
+boolean beforeTimeSyncQuery(void) {
+  uint8_t timeData[4];
+  uint16_t wptr = 0;
+  ts_writeUint32(motion_getTime(), timeData, &wptr);
+  timeSyncEndpoint.write(timeData, wptr);
+  return true;
+}
+
+// ---------------------------------------------- 12th Vertex
+// the stepper's segment queue, <end, maxVel, maxAccel, pathLength, junctionVel> (float32s, in counts) a few per packet, for sequential motion 
+// (w/ a pathLength, it's our share of a synchronizer's line, and rates are along that, in its units) 
+#define SEGMENT_BYTES 20 
+
+EP_ONDATA_RESPONSES onSegmentData(uint8_t* data, uint16_t len) {
+  uint16_t count = len / SEGMENT_BYTES;
+  if(count >= MOTION_QUEUE_SIZE) return EP_ONDATA_REJECT;
+  // segments start from the integrator's position, so if we're lining that up, we wait 'till that's done 
+  if(!profiled){
+    if(motion_getCommandSpace() == 0) return EP_ONDATA_WAIT;
+    beginProfile();
+    return EP_ONDATA_WAIT;
   }
+  if(motion_getCommandSpace() < MOTION_COMMAND_SIZE - 1) return EP_ONDATA_WAIT;
+  if(motion_getQueueSpace() < count) return EP_ONDATA_WAIT;
+  uint16_t pt = 0;
+  for(uint16_t s = 0; s < count; s ++){
+    float end = ts_readFloat32(data, &pt);
+    float maxVel = ts_readFloat32(data, &pt);
+    float maxAccel = ts_readFloat32(data, &pt);
+    float pathLength = ts_readFloat32(data, &pt);
+    float junctionVel = ts_readFloat32(data, &pt);
+    if(pathLength > 0.0F){
+      motion_addPathSegment(end, pathLength, maxVel, maxAccel, junctionVel);
+    } else {
+      motion_addSegment(end, maxVel, maxAccel);
+    }
+  }
+  return EP_ONDATA_ACCEPT;
+}
 
-  delay(1);
+Endpoint segmentEndpoint(&osap, "segmentQueue", onSegmentData);
+
+void setup() {
+  osap.init();
+  vp_arduinoSerial.begin();
+
+  // the encoder, PID and bridge all live in dcControl.cpp, 
+  // the PID runs in a timer interrupt, at this rate, and starts with kP 20, kI 1, kD 0 
+  control_init(CONTROL_DEFAULT_RATE);
+  // the profile integrator, after control_init() (which starts GCLK4): at 10kHz, it tops out at 10k counts / sec 
+  motion_init(100);
+}
+
+void loop() {
   osap.loop();
+  telemetryLoop();
 }
@@ -0,0 +1,468 @@
+/*
+dcControl.cpp
+
+quadrature encoder, fixed-rate fixed-point PID and h-bridge output for the dc-encoder thing
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#include "dcControl.h"
+
+// ---------------------------------------------- pins, all on PORTA
+#define PORTA_IN PORT->Group[PORTA].IN
+
+#define READ_FAST(pin) ((PORTA_IN.reg & (1 << pin)) > 0)
+
+#define PIN_IN1 30
+#define PIN_IN2 31
+#define PIN_BPWM 8
+#define PIN_BIN1 9
+#define PIN_BIN2 10
+
+#define BIN1_BM (uint32_t)(1 << PIN_BIN1)
+#define BIN2_BM (uint32_t)(1 << PIN_BIN2)
+#define BPWM_BM (uint32_t)(1 << PIN_BPWM)
+
+// ---------------------------------------------- encoder
+volatile uint8_t state_now = 0b00;
+volatile uint8_t state_prev = 0b00;
+
+//  new new old old
+const int8_t lookup_move[] = {0,1,-1,2,-1,0,-2,1,1,-2,0,-1,2,-1,1,0};
+volatile int32_t pos = 0;
+
+// each edge is timestamped for the low-speed velocity estimate: the period is per-count, between edges in the same direction,
+// (or zero if we don't have one, i.e. we just turned around) the edge ISRs sit above the control loop, so it reads these
+// w/ a sequence number, and tries again if an edge lands in the middle
+volatile uint32_t edgeSeq = 0;
+volatile uint32_t edgeTime = 0;
+volatile uint32_t edgePeriod = 0;
+volatile int8_t edgeDir = 0;
+
+void update_pos() {
+  uint8_t key = (state_now << 2) | state_prev;
+  int8_t move = lookup_move[key];
+  pos += move;
+  state_prev = state_now;
+  if(move != 0){
+    uint32_t now = micros();
+    int8_t dir = (move > 0) ? 1 : -1;
+    edgeSeq = edgeSeq + 1;
+    // (a 2 is a missed edge, so that's two counts' worth of time)
+    edgePeriod = (dir == edgeDir) ? (now - edgeTime) / (uint32_t)(move * dir) : 0;
+    edgeDir = dir;
+    edgeTime = now;
+  }
+}
+
+void pin1_change() {
+  if (READ_FAST(PIN_IN1)) {
+    state_now |= 0b01;
+  } else {
+    state_now &= 0b10;
+  }
+  update_pos();
+}
+
+void pin2_change() {
+  if (READ_FAST(PIN_IN2)) {
+    state_now |= 0b10;
+  } else {
+    state_now &= 0b01;
+  }
+  update_pos();
+}
+
+// ---------------------------------------------- control
+// gains are 16.16, and errors whole counts, so products are 48.16 (see fp_mulWide),
+// velocities are counts / second in 24.8, so that's +/- 8M counts / sec
+typedef Fixed<16, 16> fpGain_t;
+typedef Fixed<32, 0> fpCount_t;
+typedef Fixed<48, 16> fpEffort_t;
+typedef Fixed<24, 8> fpVel_t;
+
+constexpr fpEffort_t effortMax = fpEffort_t::fromInt(CONTROL_EFFORT_MAX);
+
+// per-tick gains, i.e. w/ the loop's period folded in to the i's and d's, and which position loop they're for
+typedef struct controlGains_t {
+  // the PID, on position error
+  fpGain_t kp;
+  fpGain_t ki;
+  fpGain_t kd;
+  // or the cascade: a P on position makes a velocity command (up to maxVel), and a PI on velocity makes effort
+  fpGain_t posKp;
+  fpGain_t velKp;
+  fpGain_t velKi;
+  fpVel_t maxVel;
+  uint8_t posLoop;
+} controlGains_t;
+
+// the ISR owns these: the loop posts new gains into the pending slot, and the ISR picks them up at the top of a tick
+controlGains_t gains;
+controlGains_t pendingGains;
+volatile boolean gainsPending = false;
+// (the slot's writes have to land before the flag that hands it over, this keeps the compiler from moving them)
+#define CONTROL_BARRIER() __asm__ __volatile__("" ::: "memory")
+fpEffort_t integral;
+fpEffort_t velIntegral;
+int32_t lastError = 0;
+
+// the loop writes a target, then the mode that uses it,
+volatile int32_t target = 0;
+volatile int32_t velTarget = 0;   // raw fpVel_t
+volatile uint8_t mode = CONTROL_MODE_POS;
+uint32_t rate = CONTROL_DEFAULT_RATE;
+// user gains, kept so that we can re-scale them if the rate changes
+float userKp = 20.0F;
+float userKi = 1.0F;
+float userKd = 0.0F;
+float userPosKp = 0.0F;
+float userVelKp = 0.0F;
+float userVelKi = 0.0F;
+float userMaxVel = 0.0F;
+uint8_t userPosLoop = CONTROL_POS_PID;
+
+static void control_postGains(void);
+
+// ---------------------------------------------- velocity estimate
+// at speed we difference counts over a short window of ticks, but at low speed that's mostly quantization,
+// so below this many counts per window we use the time between edges instead
+#define CONTROL_VEL_WINDOW 8          // ticks, a power of two,
+#define CONTROL_VEL_WINDOW_BITS 3
+#define CONTROL_VEL_SWITCH_COUNTS 16
+// and if we haven't seen an edge in this long, we call it stopped
+#define CONTROL_VEL_TIMEOUT_US 200000
+
+int32_t velWindow[CONTROL_VEL_WINDOW];
+uint8_t velWindowHead = 0;
+// set when the encoder is re-numbered, so the window doesn't read that as a jump
+volatile boolean velWindowStale = true;
+
+// latest states, for the loop to read (each is one word)
+volatile int32_t latestVel = 0;       // raw fpVel_t
+volatile int16_t latestEffort = 0;
+
+// ---------------------------------------------- telemetry
+// as the stepper's motion telemetry: the ISR writes a sample every n'th tick, the loop drains them
+typedef struct controlTelemetrySlot_t {
+  uint32_t sampleNum;
+  int32_t pos;
+  fpVel_t vel;
+  int16_t effort;
+} controlTelemetrySlot_t;
+
+#define CONTROL_TELEMETRY_MASK (CONTROL_TELEMETRY_SIZE - 1)
+
+controlTelemetrySlot_t telemetry[CONTROL_TELEMETRY_SIZE];
+volatile uint8_t telemetryHead = 0;
+volatile uint8_t telemetryTail = 0;
+volatile uint16_t telemetryDecimation = 0;
+uint16_t telemetryCountdown = 0;
+uint32_t telemetrySampleNum = 0;
+
+// ---------------------------------------------- h-bridge
+// effort to PWM counts, w/ an offset to get past the motor's deadband, as map_pwm() was: 0-255 into 32-255
+static inline uint32_t control_effortToPWM(int32_t effort){
+  return 32 + (uint32_t)effort * 223 / 255;
+}
+
+// direct port writes: transition low first, to avoid a brake condition, then the PWM
+static inline void control_writeEffort(int32_t effort){
+  if(effort == 0){
+    PORT->Group[0].OUTCLR.reg = BIN1_BM | BIN2_BM;
+    TCC0->CCB[0].reg = 0;
+  } else if (effort > 0){
+    PORT->Group[0].OUTCLR.reg = BIN2_BM;
+    PORT->Group[0].OUTSET.reg = BIN1_BM;
+    TCC0->CCB[0].reg = control_effortToPWM(effort);
+  } else {
+    PORT->Group[0].OUTCLR.reg = BIN1_BM;
+    PORT->Group[0].OUTSET.reg = BIN2_BM;
+    TCC0->CCB[0].reg = control_effortToPWM(-effort);
+  }
+}
+
+void control_init(uint32_t rateHz){
+  // -------------------------------------------- encoder
+  state_now = READ_FAST(PIN_IN1) | (READ_FAST(PIN_IN2) << 1);
+  state_prev = state_now;
+  attachInterrupt(digitalPinToInterrupt(PIN_IN1), pin1_change, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(PIN_IN2), pin2_change, CHANGE);
+  // -------------------------------------------- bridge pins
+  PORT->Group[0].DIRSET.reg = BIN1_BM | BIN2_BM | BPWM_BM;
+  PORT->Group[0].OUTCLR.reg = BIN1_BM | BIN2_BM;
+  // -------------------------------------------- clocks
+  // a clock w/ DFLL48 src on ch4, as the stepper does, for the TCC (PWM) and TC4 (control loop),
+  // the motion core's integrator has TC5, and expects this clock to be up before motion_init()
+  PM->APBCMASK.reg |= PM_APBCMASK_TCC0 | PM_APBCMASK_TC4;
+  GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(4)|
+                      GCLK_GENCTRL_GENEN |
+                      GCLK_GENCTRL_SRC_DFLL48M |
+                      GCLK_GENCTRL_IDC;
+  while(GCLK->STATUS.bit.SYNCBUSY);
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN |
+                      GCLK_CLKCTRL_GEN_GCLK4 |
+                      GCLK_CLKCTRL_ID_TCC0_TCC1;
+  while(GCLK->STATUS.bit.SYNCBUSY);
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN |
+                      GCLK_CLKCTRL_GEN_GCLK4 |
+                      GCLK_CLKCTRL_ID_TC4_TC5;
+  while(GCLK->STATUS.bit.SYNCBUSY);
+  // -------------------------------------------- PWM, on TCC0-0 (E)
+  PORT->Group[0].PINCFG[PIN_BPWM].reg |= PORT_PINCFG_PMUXEN;
+  PORT->Group[0].PMUX[PIN_BPWM >> 1].reg = PORT_PMUX_PMUXE_E;
+  // 48MHz / 8 / 256 counts: ~ 23kHz, out of earshot
+  TCC0->CTRLA.reg |= TCC_CTRLA_PRESCALER_DIV8;
+  TCC0->WAVE.reg = TCC_WAVE_WAVEGEN_NPWM;
+  while(TCC0->SYNCBUSY.bit.WAVE);
+  TCC0->PER.reg = 255;
+  while(TCC0->SYNCBUSY.bit.PER);
+  TCC0->CCB[0].reg = 0;
+  TCC0->CTRLA.bit.ENABLE = 1;
+  // -------------------------------------------- control loop timer
+  rate = rateHz;
+  control_postGains();
+  TC4->COUNT16.CTRLA.reg |= TC_CTRLA_MODE_COUNT16 |
+                            TC_CTRLA_WAVEGEN_MFRQ |
+                            TC_CTRLA_PRESCALER_DIV8; // div/8 on 48mhz clock, so 6MHz base
+  while(TC4->COUNT16.STATUS.bit.SYNCBUSY);
+  NVIC_DisableIRQ(TC4_IRQn);
+  NVIC_ClearPendingIRQ(TC4_IRQn);
+  // below the encoder's pin interrupts, which shouldn't wait on us, and level w/ the integrator, so neither cuts into the other
+  NVIC_SetPriority(TC4_IRQn, 1);
+  NVIC_EnableIRQ(TC4_IRQn);
+  TC4->COUNT16.INTENSET.bit.MC0 = 1;
+  TC4->COUNT16.CC[0].reg = 6000000 / rate;
+  TC4->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+  while(TC4->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+boolean control_setRate(uint32_t rateHz){
+  if(rateHz < CONTROL_MIN_RATE || rateHz > CONTROL_MAX_RATE) return false;
+  rate = rateHz;
+  // i and d are per-tick, so they change w/ the rate,
+  control_postGains();
+  TC4->COUNT16.CC[0].reg = 6000000 / rate;
+  while(TC4->COUNT16.STATUS.bit.SYNCBUSY);
+  return true;
+}
+
+static fpGain_t control_toGain(float gain){
+  return fpGain_t::fromFloat(constrain(gain, -32767.0F, 32767.0F));
+}
+
+// converts the user's gains at the current rate, and hands them to the ISR
+static void control_postGains(void){
+  float msPerTick = 1000.0F / (float)rate;
+  // the ISR takes these at the top of its next tick, if the last ones haven't gone yet, we wait for 'em
+  while(gainsPending);
+  pendingGains.kp = control_toGain(userKp);
+  pendingGains.ki = control_toGain(userKi * msPerTick);
+  pendingGains.kd = control_toGain(userKd / msPerTick);
+  pendingGains.posKp = control_toGain(userPosKp);
+  pendingGains.velKp = control_toGain(userVelKp);
+  pendingGains.velKi = control_toGain(userVelKi * msPerTick);
+  pendingGains.maxVel = fpVel_t::fromFloat(constrain(userMaxVel, 0.0F, (float)CONTROL_VEL_MAX));
+  pendingGains.posLoop = userPosLoop;
+  CONTROL_BARRIER();
+  gainsPending = true;
+}
+
+void control_setGains(float kp, float ki, float kd){
+  userKp = kp;
+  userKi = ki;
+  userKd = kd;
+  userPosLoop = CONTROL_POS_PID;
+  control_postGains();
+}
+
+void control_setCascadeGains(float posKp, float velKp, float velKi, float maxVel){
+  userPosKp = posKp;
+  userVelKp = velKp;
+  userVelKi = velKi;
+  userMaxVel = maxVel;
+  userPosLoop = CONTROL_POS_CASCADE;
+  control_postGains();
+}
+
+void control_setTarget(int32_t _target){
+  target = _target;
+  CONTROL_BARRIER();
+  mode = CONTROL_MODE_POS;
+}
+
+void control_setVelocityTarget(float _vel){
+  velTarget = fpVel_t::fromFloat(constrain(_vel, -(float)CONTROL_VEL_MAX, (float)CONTROL_VEL_MAX)).raw;
+  CONTROL_BARRIER();
+  mode = CONTROL_MODE_VEL;
+}
+
+// from the integrator's ISR, which is level w/ ours, so this can't land mid-tick
+void control_stepTarget(boolean dir){
+  target = target + (dir ? 1 : -1);
+}
+
+void control_setPosition(int32_t _pos){
+  // the encoder's ISRs can move pos under us, so they wait 'till we've swapped it,
+  noInterrupts();
+  pos = _pos;
+  target = _pos;
+  edgePeriod = 0;
+  velWindowStale = true;
+  mode = CONTROL_MODE_POS;
+  interrupts();
+}
+
+int32_t control_getPosition(void){
+  return pos;
+}
+
+float control_getVelocity(void){
+  return fpVel_t::fromRaw(latestVel).toFloat();
+}
+
+int16_t control_getEffort(void){
+  return latestEffort;
+}
+
+uint8_t control_getMode(void){
+  return mode;
+}
+
+// ---------------------------------------------- the loop
+
+static fpVel_t control_estimateVelocity(int32_t _pos){
+  if(velWindowStale){
+    for(uint8_t w = 0; w < CONTROL_VEL_WINDOW; w ++) velWindow[w] = _pos;
+    velWindowStale = false;
+  }
+  // counts over the window,
+  int32_t _windowDelta = _pos - velWindow[velWindowHead];
+  velWindow[velWindowHead] = _pos;
+  velWindowHead = (velWindowHead + 1) & (CONTROL_VEL_WINDOW - 1);
+  if(_windowDelta >= CONTROL_VEL_SWITCH_COUNTS || _windowDelta <= -CONTROL_VEL_SWITCH_COUNTS){
+    // counts * ticks/sec / window, in 24.8
+    return fpVel_t::fromRaw((int32_t)(((int64_t)_windowDelta * rate) << (fpVel_t::fracBits - CONTROL_VEL_WINDOW_BITS)));
+  }
+  // or from edge times,
+  uint32_t _seq, _time, _period;
+  int8_t _dir;
+  do {
+    _seq = edgeSeq;
+    CONTROL_BARRIER();
+    _time = edgeTime;
+    _period = edgePeriod;
+    _dir = edgeDir;
+    CONTROL_BARRIER();
+  } while(_seq != edgeSeq);
+  uint32_t _since = micros() - _time;
+  if(_period == 0 || _since > CONTROL_VEL_TIMEOUT_US) return fpVel_t();
+  // if it's been longer since the last edge than the last period, we're slowing down, at least that much
+  if(_since > _period) _period = _since;
+  int32_t _raw = (int32_t)(((uint32_t)1000000 << fpVel_t::fracBits) / _period);
+  return fpVel_t::fromRaw(_dir > 0 ? _raw : -_raw);
+}
+
+static inline fpEffort_t control_clampEffort(fpEffort_t _effort){
+  if(_effort > effortMax) return effortMax;
+  if(_effort < -effortMax) return -effortMax;
+  return _effort;
+}
+
+void TC4_Handler(void){
+  TC4->COUNT16.INTFLAG.bit.MC0 = 1; // clear the interrupt
+  if(gainsPending){
+    gains = pendingGains;
+    gainsPending = false;
+  }
+  int32_t _pos = pos;
+  fpVel_t _vel = control_estimateVelocity(_pos);
+  uint8_t _mode = mode;
+  CONTROL_BARRIER();
+  int32_t _error = target - _pos;
+  fpEffort_t _effort;
+  if(_mode == CONTROL_MODE_POS && gains.posLoop == CONTROL_POS_PID){
+    _effort = fp_mulWide(gains.kp, fpCount_t::fromRaw(_error));
+    // integrate, and clamp the integral term itself to the output range (so it can't wind up past that)
+    integral = control_clampEffort(integral + fp_mulWide(gains.ki, fpCount_t::fromRaw(_error)));
+    _effort += integral;
+    _effort += fp_mulWide(gains.kd, fpCount_t::fromRaw(_error - lastError));
+  } else {
+    // the velocity loop, commanded by the position loop or straight from the velocity target
+    fpVel_t _velCmd;
+    if(_mode == CONTROL_MODE_POS){
+      fpEffort_t _wide = fp_mulWide(gains.posKp, fpCount_t::fromRaw(_error));
+      fpEffort_t _max = gains.maxVel.as<fpEffort_t>();
+      if(_wide > _max) _wide = _max;
+      if(_wide < -_max) _wide = -_max;
+      _velCmd = _wide.as<fpVel_t>();
+    } else {
+      _velCmd = fpVel_t::fromRaw(velTarget);
+    }
+    fpVel_t _velError = _velCmd - _vel;
+    _effort = fp_mulWide(gains.velKp, _velError).as<fpEffort_t>();
+    velIntegral = control_clampEffort(velIntegral + fp_mulWide(gains.velKi, _velError).as<fpEffort_t>());
+    _effort += velIntegral;
+  }
+  lastError = _error;
+  int16_t _out = (int16_t)control_clampEffort(_effort).toInt();
+  control_writeEffort(_out);
+  latestVel = _vel.raw;
+  latestEffort = _out;
+  // and sample, every so often,
+  uint16_t _decimation = telemetryDecimation;
+  if(_decimation != 0){
+    if(telemetryCountdown == 0 || telemetryCountdown > _decimation){
+      telemetryCountdown = _decimation;
+      uint8_t _head = telemetryHead;
+      uint8_t _next = (_head + 1) & CONTROL_TELEMETRY_MASK;
+      // if nobody is draining we drop samples, but still count them, so the host sees the gap
+      if(_next != telemetryTail){
+        telemetry[_head].sampleNum = telemetrySampleNum;
+        telemetry[_head].pos = _pos;
+        telemetry[_head].vel = _vel;
+        telemetry[_head].effort = _out;
+        CONTROL_BARRIER();
+        telemetryHead = _next;
+      }
+      telemetrySampleNum ++;
+    }
+    telemetryCountdown --;
+  }
+}
+
+// ---------------------------------------------- telemetry, loop side
+
+void control_setTelemetryDecimation(uint16_t ticksPerSample){
+  telemetryDecimation = ticksPerSample;
+}
+
+uint8_t control_getTelemetryCount(void){
+  return (uint8_t)(telemetryHead - telemetryTail) & CONTROL_TELEMETRY_MASK;
+}
+
+uint8_t control_drainTelemetry(controlSample_t* dest, uint8_t maxCount){
+  uint8_t _head = telemetryHead;
+  uint8_t _tail = telemetryTail;
+  uint8_t count = 0;
+  while(_tail != _head && count < maxCount){
+    controlTelemetrySlot_t* slot = &telemetry[_tail];
+    // frames are contiguous, so a gap starts the next one
+    if(count > 0 && slot->sampleNum != dest[0].sampleNum + count) break;
+    dest[count].sampleNum = slot->sampleNum;
+    dest[count].pos = slot->pos;
+    dest[count].vel = slot->vel.toFloat();
+    dest[count].effort = slot->effort;
+    count ++;
+    _tail = (_tail + 1) & CONTROL_TELEMETRY_MASK;
+  }
+  CONTROL_BARRIER();
+  telemetryTail = _tail;
+  return count;
+}
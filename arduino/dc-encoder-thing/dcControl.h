@@ -0,0 +1,78 @@
+/*
+dcControl.h
+
+quadrature encoder, fixed-rate fixed-point PID and h-bridge output for the dc-encoder thing,
+the loop runs in TC4's interrupt, so its rate doesn't depend on how busy OSAP is
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#ifndef DC_CONTROL_H_
+#define DC_CONTROL_H_
+
+#include <Arduino.h>
+#include <fixedPoint.h>
+
+// control loop rates, in Hz: the timer is a 16-bit count at 6MHz, so we can't go much slower than the min
+#define CONTROL_DEFAULT_RATE 5000
+#define CONTROL_MIN_RATE 100
+#define CONTROL_MAX_RATE 20000
+
+// effort is +/- this, as it was w/ the PIDController library
+#define CONTROL_EFFORT_MAX 255
+
+// velocities are counts / second, and bounded at this
+#define CONTROL_VEL_MAX 8000000
+
+// the loop either holds a position or a velocity,
+#define CONTROL_MODE_POS 0
+#define CONTROL_MODE_VEL 1
+
+// and it holds position w/ one PID on position error, or w/ a P on position that commands a PI on velocity,
+// whichever was tuned last
+#define CONTROL_POS_PID 0
+#define CONTROL_POS_CASCADE 1
+
+// the ISR samples every n'th tick into a ring of this many (a power of two), the loop drains them in frames of the batch
+#define CONTROL_TELEMETRY_SIZE 64
+#define CONTROL_TELEMETRY_BATCH 8
+
+typedef struct controlSample_t {
+  uint32_t sampleNum;
+  int32_t pos;
+  float vel;
+  int16_t effort;
+} controlSample_t;
+
+void control_init(uint32_t rateHz);
+// returns false (and leaves it alone) if the rate is out of bounds,
+boolean control_setRate(uint32_t rateHz);
+// gains are per-millisecond (for i and d), as they were w/ PIDController, so tunes carry over at any rate
+void control_setGains(float kp, float ki, float kd);
+// the cascade: posKp is counts/sec per count of error, velKp is effort per count/sec, and velKi per ms, maxVel in counts/sec
+void control_setCascadeGains(float posKp, float velKp, float velKi, float maxVel);
+// each of these also sets the mode,
+void control_setTarget(int32_t target);
+void control_setVelocityTarget(float countsPerSecond);
+// one count along, for a profiled setpoint: the motion core's integrator calls this (thru stepper_step) once per count
+void control_stepTarget(boolean dir);
+// re-numbers the encoder (and the target w/ it) to here, and holds there
+void control_setPosition(int32_t pos);
+int32_t control_getPosition(void);
+// counts / second, from count differences at speed, or from the time between edges when slow
+float control_getVelocity(void);
+int16_t control_getEffort(void);
+uint8_t control_getMode(void);
+// zero turns telemetry off,
+void control_setTelemetryDecimation(uint16_t ticksPerSample);
+uint8_t control_getTelemetryCount(void);
+// copies up to maxCount contiguous samples out of the ring, returns how many
+uint8_t control_drainTelemetry(controlSample_t* dest, uint8_t maxCount);
+
+#endif
@@ -1,6 +1,8 @@
 #include <osap.h>
 #include <vt_endpoint.h>
 #include <vp_arduinoSerial.h>
+#include <core/ts.h>
+#include "pulseTrain.h"
 
 // ---------------------------------------------- Pins
 #define PIN_GATE 14
@@ -16,23 +18,74 @@ OSAP osap("mosfet", messageStack, OSAP_STACK_SIZE);
 VPort_ArduinoSerial vp_arduinoSerial(&osap, "usbSerial", &Serial);
 
 // ---------------------------------------------- 1th Vertex: RGB Inputs Endpoint 
+// the pulse timer calls this from its interrupt, and we call it here, 
+void gate_write(uint8_t level){
+  analogWrite(PIN_GATE, level);
+  digitalWrite(PIN_LED, level > 0 ? HIGH: LOW);
+}
+
 EP_ONDATA_RESPONSES onGateData(uint8_t* data, uint16_t len){
   // we did the float -> int conversion in js 
   uint8_t value = data[0];
-  analogWrite(PIN_GATE, value);
-  digitalWrite(PIN_LED, value > 0 ? HIGH: LOW);
+  // setting the gate directly drops any queued pulses 
+  pulse_cancel();
+  gate_write(value);
 
   return EP_ONDATA_ACCEPT;
 }
 
 Endpoint gateEndpoint(&osap, "gateValue", onGateData);
 
+// ---------------------------------------------- 2nd Vertex: Pulse Queue 
+// <count (uint8), count * <delay (uint32, us), on-time (uint32, us), level (uint8)>>, 
+// each pulse starts delay after the one before it (or after it arrives, if nothing else is waiting), 
+// holds level for its on-time and then turns the gate off, and a pulse that starts while another is on takes over, 
+// if the count's top bit is set, this continues the last phrase: the first delay is from the last pulse's start, even if the queue ran dry 
+#define PULSE_BYTES 9
+#define PULSE_CONTINUES 0x80
+
+EP_ONDATA_RESPONSES onPulseData(uint8_t* data, uint16_t len){
+  if(len < 1) return EP_ONDATA_REJECT;
+  boolean continues = data[0] & PULSE_CONTINUES;
+  uint8_t count = data[0] & ~PULSE_CONTINUES;
+  if(count == 0 || count > PULSE_QUEUE_SIZE - 1 || len != 1 + count * PULSE_BYTES) return EP_ONDATA_REJECT;
+  // the whole phrase goes in at once, so we hold the packet 'till there's room for it 
+  if(pulse_getSpace() < count) return EP_ONDATA_WAIT;
+  uint16_t rptr = 1;
+  for(uint8_t p = 0; p < count; p ++){
+    uint32_t delayUs = ts_readUint32(data, &rptr);
+    uint32_t onUs = ts_readUint32(data, &rptr);
+    uint8_t level = data[rptr ++];
+    pulse_queue(delayUs, onUs, level, continues && p == 0);
+  }
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint pulseEndpoint(&osap, "pulseQueue", onPulseData);
+
+// ---------------------------------------------- 3rd Vertex: Pulse State 
+// <space (uint8), busy (uint8)> 
+boolean beforePulseStateQuery(void);
+
+Endpoint pulseStateEndpoint(&osap, "pulseState", beforePulseStateQuery);
+
+boolean beforePulseStateQuery(void){
+  uint8_t buf[2];
+  buf[0] = pulse_getSpace();
+  buf[1] = pulse_isBusy() ? 1 : 0;
+  pulseStateEndpoint.write(buf, 2);
+  return true;
+}
+
 void setup() {
   osap.init();
   vp_arduinoSerial.begin();
   analogWriteResolution(8);
   pinMode(PIN_LED, OUTPUT);
   pinMode(PIN_GATE, OUTPUT);
+  // sets the gate's PWM up now, so that the first write from the timer's interrupt is a quick one 
+  gate_write(0);
+  pulse_init();
 }
 
 void loop() {
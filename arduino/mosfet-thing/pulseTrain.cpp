@@ -0,0 +1,214 @@
+/*
+pulseTrain.cpp
+
+queued, timed gate pulses for the mosfet thing
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#include "pulseTrain.h"
+
+// TC4 counts at 3MHz (48MHz / 16), and we run it one period at a time: each period lasts 'till the next event
+// (a pulse starting or ending), or the longest a 16-bit count goes, and the match resets the count in hardware,
+// so ISR latency doesn't add up over a long train
+#define PULSE_TICKS_PER_US 3
+#define PULSE_PERIOD_MAX 65535
+// and we don't go shorter than this, so the count can't get past a new match before we write it
+#define PULSE_PERIOD_MIN 30
+#define PULSE_NONE 0xFFFFFFFF
+
+#define PULSE_BARRIER() __asm__ volatile("" ::: "memory")
+
+typedef struct pulse_t {
+  uint32_t delay;   // ticks, from the last pulse's start
+  uint32_t on;      // ticks
+  uint8_t level;
+} pulse_t;
+
+pulse_t pulses[PULSE_QUEUE_SIZE];
+// we write the head, the ISR reads from the tail
+volatile uint8_t pulseHead = 0;
+volatile uint8_t pulseTail = 0;
+
+// ticks 'till the next pulse starts, and 'till the one that's on ends,
+volatile uint32_t onRemaining = PULSE_NONE;
+volatile uint32_t offRemaining = PULSE_NONE;
+volatile uint16_t period = 0;
+volatile boolean running = false;
+// ticks since the last pulse started, counted by the ISR while the timer runs, and by micros() after it stops,
+// PULSE_NONE if nothing's started since the last cancel, (and it stops counting at PULSE_SINCE_MAX, well past any delay)
+#define PULSE_SINCE_MAX 0xF0000000
+volatile uint32_t sinceStart = PULSE_NONE;
+volatile uint32_t stoppedAtUs = 0;
+
+static inline void pulse_sync(void){
+  while(TC4->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+void pulse_init(void){
+  // a clock w/ DFLL48 src on ch4, as the other SAMD things do, for TC4
+  PM->APBCMASK.reg |= PM_APBCMASK_TC4;
+  GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(4)|
+                      GCLK_GENCTRL_GENEN |
+                      GCLK_GENCTRL_SRC_DFLL48M |
+                      GCLK_GENCTRL_IDC;
+  while(GCLK->STATUS.bit.SYNCBUSY);
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN |
+                      GCLK_CLKCTRL_GEN_GCLK4 |
+                      GCLK_CLKCTRL_ID_TC4_TC5;
+  while(GCLK->STATUS.bit.SYNCBUSY);
+  TC4->COUNT16.CTRLA.reg |= TC_CTRLA_MODE_COUNT16 |
+                            TC_CTRLA_WAVEGEN_MFRQ |
+                            TC_CTRLA_PRESCALER_DIV16; // div/16 on 48mhz clock, so 3MHz base
+  pulse_sync();
+  NVIC_DisableIRQ(TC4_IRQn);
+  NVIC_ClearPendingIRQ(TC4_IRQn);
+  // pulse edges are the only timing that matters on this board,
+  NVIC_SetPriority(TC4_IRQn, 0);
+  NVIC_EnableIRQ(TC4_IRQn);
+  TC4->COUNT16.INTENSET.bit.MC0 = 1;
+}
+
+static inline uint8_t pulse_count(void){
+  return (pulseHead - pulseTail) & (PULSE_QUEUE_SIZE - 1);
+}
+
+uint8_t pulse_getSpace(void){
+  return PULSE_QUEUE_SIZE - 1 - pulse_count();
+}
+
+boolean pulse_isBusy(void){
+  return running;
+}
+
+// ticks into the current period,
+static uint16_t pulse_readCount(void){
+  TC4->COUNT16.READREQ.reg = TC_READREQ_RREQ | TC_READREQ_ADDR(0x10);
+  pulse_sync();
+  return TC4->COUNT16.COUNT.reg;
+}
+
+static void pulse_setPeriod(uint16_t ticks){
+  period = ticks;
+  TC4->COUNT16.CC[0].reg = ticks;
+  pulse_sync();
+}
+
+static inline uint16_t pulse_nextPeriod(void){
+  uint32_t next = min((uint32_t)onRemaining, (uint32_t)offRemaining);
+  if(next > PULSE_PERIOD_MAX) next = PULSE_PERIOD_MAX;
+  if(next < PULSE_PERIOD_MIN) next = PULSE_PERIOD_MIN;
+  return next;
+}
+
+static inline uint32_t pulse_addSince(uint32_t since, uint32_t ticks){
+  return (since >= PULSE_SINCE_MAX - ticks) ? PULSE_SINCE_MAX : since + ticks;
+}
+
+boolean pulse_queue(uint32_t delayUs, uint32_t onUs, uint8_t level, boolean continues){
+  if(pulse_getSpace() == 0) return false;
+  pulse_t* pulse = &pulses[pulseHead];
+  pulse->delay = min(delayUs, (uint32_t)PULSE_MAX_US) * PULSE_TICKS_PER_US;
+  pulse->on = max(min(onUs, (uint32_t)PULSE_MAX_US) * PULSE_TICKS_PER_US, (uint32_t)1);
+  pulse->level = level;
+  noInterrupts();
+  PULSE_BARRIER();
+  pulseHead = (pulseHead + 1) & (PULSE_QUEUE_SIZE - 1);
+  if(onRemaining == PULSE_NONE){
+    // nothing else is waiting to start, so this one times from now, and it's next,
+    // (or from the last start, if it continues a phrase, so we take off what's gone by since then)
+    uint32_t _delay = pulse->delay;
+    if(continues && sinceStart != PULSE_NONE){
+      uint32_t since = sinceStart;
+      if(!running){
+        since = pulse_addSince(since, min((uint32_t)(micros() - stoppedAtUs), (uint32_t)(PULSE_SINCE_MAX / PULSE_TICKS_PER_US)) * PULSE_TICKS_PER_US);
+      } else {
+        uint32_t inPeriod = pulse_readCount();
+        if(TC4->COUNT16.INTFLAG.bit.MC0) inPeriod += period;
+        since = pulse_addSince(since, inPeriod);
+      }
+      _delay = (_delay > since) ? _delay - since : 0;
+    }
+    if(!running){
+      onRemaining = _delay;
+      offRemaining = PULSE_NONE;
+      TC4->COUNT16.COUNT.reg = 0;
+      pulse_sync();
+      pulse_setPeriod(pulse_nextPeriod());
+      TC4->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+      pulse_sync();
+      running = true;
+    } else {
+      // the ISR takes a whole period off when it fires, so we add what's gone by already,
+      // (and if the match is already pending, that period is over, and it's all of it)
+      uint32_t elapsed = pulse_readCount();
+      if(TC4->COUNT16.INTFLAG.bit.MC0) elapsed += period;
+      onRemaining = _delay + elapsed;
+      // and if it starts before the current period ends, we cut that short
+      if(onRemaining < period){
+        pulse_setPeriod(max((uint32_t)onRemaining, elapsed + PULSE_PERIOD_MIN));
+      }
+    }
+  }
+  interrupts();
+  return true;
+}
+
+void pulse_cancel(void){
+  noInterrupts();
+  TC4->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+  pulse_sync();
+  NVIC_ClearPendingIRQ(TC4_IRQn);
+  TC4->COUNT16.INTFLAG.bit.MC0 = 1;
+  pulseTail = pulseHead;
+  onRemaining = PULSE_NONE;
+  offRemaining = PULSE_NONE;
+  sinceStart = PULSE_NONE;
+  running = false;
+  interrupts();
+}
+
+void TC4_Handler(void){
+  TC4->COUNT16.INTFLAG.bit.MC0 = 1; // clear the interrupt
+  uint32_t elapsed = period;
+  uint32_t _off = offRemaining;
+  uint32_t _on = onRemaining;
+  uint32_t _since = sinceStart;
+  if(_since != PULSE_NONE) _since = pulse_addSince(_since, elapsed);
+  // a pulse ending, then (so that back-to-back pulses stay on) the next one starting,
+  if(_off != PULSE_NONE){
+    _off = (_off > elapsed) ? _off - elapsed : 0;
+    if(_off == 0){
+      gate_write(0);
+      _off = PULSE_NONE;
+    }
+  }
+  if(_on != PULSE_NONE){
+    _on = (_on > elapsed) ? _on - elapsed : 0;
+    if(_on == 0){
+      pulse_t* pulse = &pulses[pulseTail];
+      gate_write(pulse->level);
+      _off = pulse->on;
+      _since = 0;
+      PULSE_BARRIER();
+      pulseTail = (pulseTail + 1) & (PULSE_QUEUE_SIZE - 1);
+      _on = (pulse_count() > 0) ? pulses[pulseTail].delay : PULSE_NONE;
+    }
+  }
+  offRemaining = _off;
+  onRemaining = _on;
+  sinceStart = _since;
+  if(_on == PULSE_NONE && _off == PULSE_NONE){
+    TC4->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    stoppedAtUs = micros();
+    running = false;
+    return;
+  }
+  pulse_setPeriod(pulse_nextPeriod());
+}
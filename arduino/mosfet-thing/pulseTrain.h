@@ -0,0 +1,40 @@
+/*
+pulseTrain.h
+
+queued, timed gate pulses for the mosfet thing: each one waits some delay after the last one started,
+then holds a PWM level for its on-time, and TC4's interrupt does the timing, so USB jitter doesn't get into it
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#ifndef PULSE_TRAIN_H_
+#define PULSE_TRAIN_H_
+
+#include <Arduino.h>
+
+// a power of two, (one slot stays empty)
+#define PULSE_QUEUE_SIZE 32
+// delays and on-times are microseconds, up to a minute,
+#define PULSE_MAX_US 60000000
+
+// the sketch provides this, and the timer calls it (from its interrupt) at the start and end of each pulse
+void gate_write(uint8_t level);
+
+void pulse_init(void);
+// delay counts from the previous pulse's start if that one is still queued, or from now, if not,
+// unless continues is set: then it's from the previous pulse's start regardless (so a long phrase can come in pieces),
+// and if that's already gone by, the pulse starts right away, returns false (and queues nothing) if there's no room
+boolean pulse_queue(uint32_t delayUs, uint32_t onUs, uint8_t level, boolean continues);
+uint8_t pulse_getSpace(void);
+// true while any pulse is queued, waiting, or on
+boolean pulse_isBusy(void);
+// drops everything queued, and stops the timer, (but leaves the gate wherever it was)
+void pulse_cancel(void);
+
+#endif
@@ -0,0 +1,130 @@
+/*
+fixedPoint.h
+
+compile-time Q-format fixed point numbers: Fixed<IntBits, FracBits> is a signed integer
+w/ FracBits behind the point, stored in 32 or 64 bits (IntBits includes the sign),
+conversions are constexpr, so formats and ranges can be checked w/ static_assert
+
+written to C++11, which is what the SAMD21 core compiles with
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#ifndef FIXED_POINT_H_
+#define FIXED_POINT_H_
+
+#include <stdint.h>
+
+// ---------------------------------------------- storage & shifting helpers
+template <int Bits> struct fp_storage;
+template <> struct fp_storage<32> { typedef int32_t type; };
+template <> struct fp_storage<64> { typedef int64_t type; };
+
+// shift by a signed amount, without ever shifting by a negative count:
+// (and w/ multiplies for left shifts, since << on a -ve number is UB in C++11, the compiler makes it a shift anyways)
+template <bool Left> struct fp_shift;
+template <> struct fp_shift<true> {
+  template <typename T> static constexpr T apply(T raw, int n){ return raw * ((T)1 << n); }
+};
+template <> struct fp_shift<false> {
+  template <typename T> static constexpr T apply(T raw, int n){ return raw >> n; }
+};
+
+// how many bits does it take to hold this (positive) value ?
+constexpr int fp_bitsFor(uint64_t x){ return x == 0 ? 0 : 1 + fp_bitsFor(x >> 1); }
+
+template <int IntBits, int FracBits>
+class Fixed {
+public:
+  static_assert(IntBits + FracBits == 32 || IntBits + FracBits == 64, "Fixed<> formats are 32 or 64 bits wide");
+  static_assert(IntBits >= 1 && FracBits >= 0, "Fixed<> needs at least a sign bit");
+
+  typedef typename fp_storage<IntBits + FracBits>::type raw_t;
+  static constexpr int intBits = IntBits;
+  static constexpr int fracBits = FracBits;
+
+  raw_t raw;
+
+  // ------------------------------------ construction
+  constexpr Fixed() : raw(0) {}
+  constexpr Fixed(const Fixed& other) : raw(other.raw) {}
+  // we keep these in volatiles that the ISR shares, so they need to copy out of (and into) those,
+  Fixed(const volatile Fixed& other) : raw(other.raw) {}
+  Fixed& operator=(const Fixed& other){ raw = other.raw; return *this; }
+  Fixed& operator=(const volatile Fixed& other){ raw = other.raw; return *this; }
+  void operator=(const Fixed& other) volatile { raw = other.raw; }
+
+  static constexpr Fixed fromRaw(raw_t r){ return Fixed(r, 0); }
+  static constexpr Fixed fromInt(int32_t i){ return Fixed((raw_t)i * one(), 0); }
+  static constexpr Fixed fromFloat(float f){ return Fixed((raw_t)(f * (float)one()), 0); }
+  static constexpr Fixed max(void){ return Fixed(rawMax(), 0); }
+
+  // ------------------------------------ conversion
+  constexpr float toFloat(void) const { return (float)raw / (float)one(); }
+  // floors, as an arithmetic right shift does,
+  constexpr int32_t toInt(void) const { return (int32_t)(raw >> FracBits); }
+  // to another format, truncating any fractional bits we lose (overflow is the caller's problem, or static_assert's)
+  template <typename To> constexpr To as(void) const {
+    return To::fromRaw((typename To::raw_t)fp_shift<(To::fracBits >= FracBits)>::apply(
+      (int64_t)raw, (To::fracBits >= FracBits) ? (To::fracBits - FracBits) : (FracBits - To::fracBits)));
+  }
+
+  // ------------------------------------ arithmetic, in-format,
+  constexpr Fixed operator+(const Fixed& b) const { return Fixed(raw + b.raw, 0); }
+  constexpr Fixed operator-(const Fixed& b) const { return Fixed(raw - b.raw, 0); }
+  constexpr Fixed operator-(void) const { return Fixed(-raw, 0); }
+  constexpr Fixed operator<<(int n) const { return Fixed(fp_shift<true>::apply(raw, n), 0); }
+  constexpr Fixed operator>>(int n) const { return Fixed(raw >> n, 0); }
+  Fixed& operator+=(const Fixed& b){ raw += b.raw; return *this; }
+  Fixed& operator-=(const Fixed& b){ raw -= b.raw; return *this; }
+
+  constexpr bool operator==(const Fixed& b) const { return raw == b.raw; }
+  constexpr bool operator!=(const Fixed& b) const { return raw != b.raw; }
+  constexpr bool operator<(const Fixed& b) const { return raw < b.raw; }
+  constexpr bool operator>(const Fixed& b) const { return raw > b.raw; }
+  constexpr bool operator<=(const Fixed& b) const { return raw <= b.raw; }
+  constexpr bool operator>=(const Fixed& b) const { return raw >= b.raw; }
+
+  // (not abs(), the arduino cores #define that)
+  constexpr Fixed magnitude(void) const { return raw < 0 ? Fixed(-raw, 0) : *this; }
+  constexpr bool isZero(void) const { return raw == 0; }
+  constexpr bool isPositive(void) const { return raw > 0; }
+  constexpr bool isNegative(void) const { return raw < 0; }
+
+  // multiplying in-format, w/ a 64-bit intermediate (the old fp_mult32x32), saturating
+  // at the format's limits rather than wrapping,
+  constexpr Fixed mulSat(const Fixed& b) const {
+    return satFromWide(((int64_t)raw * (int64_t)b.raw) >> FracBits);
+  }
+
+  static constexpr raw_t one(void){ return (raw_t)1 << FracBits; }
+  static constexpr raw_t rawMax(void){ return (raw_t)(((uint64_t)1 << (IntBits + FracBits - 1)) - 1); }
+
+private:
+  constexpr Fixed(raw_t r, int) : raw(r) {}
+  static constexpr Fixed satFromWide(int64_t w){
+    return w > (int64_t)rawMax() ? Fixed(rawMax(), 0) : (w < -(int64_t)rawMax() ? Fixed(-rawMax(), 0) : Fixed((raw_t)w, 0));
+  }
+};
+
+// ---------------------------------------------- widening multiply
+// the product of Q(a).(fa) and Q(b).(fb) has (fa + fb) fractional bits: we keep all of them in 64 bits,
+// whether that overflows or not depends on the values in play, so pair this w/ fp_productFits() in a static_assert
+template <int I1, int F1, int I2, int F2>
+constexpr Fixed<64 - F1 - F2, F1 + F2> fp_mulWide(const Fixed<I1, F1>& a, const Fixed<I2, F2>& b){
+  return Fixed<64 - F1 - F2, F1 + F2>::fromRaw((int64_t)a.raw * (int64_t)b.raw);
+}
+
+// true if |a| * |b| can't overflow a signed 64-bit product,
+template <typename A, typename B>
+constexpr bool fp_productFits(const A& a, const B& b){
+  return b.raw == 0 || (uint64_t)a.magnitude().raw <= (uint64_t)INT64_MAX / (uint64_t)b.magnitude().raw;
+}
+
+#endif
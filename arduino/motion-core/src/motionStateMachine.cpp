@@ -0,0 +1,1458 @@
+/*
+motionStateMachine.cpp
+
+fixed-point trapezoidal motion integrator, shared by the SAMD21 and RP2040 stepper firmwares, 
+only the timer interrupt setup is per-architecture 
+
+Jake Read & Quentin Bolsee at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#include "motionStateMachine.h"
+
+#if defined(ARDUINO_ARCH_SAMD)
+// shouldn't be here: just using to debug interval time, 
+// it's the stepper board's limit pin as well, so it's off unless you're scoping the ISR 
+// #define PIN_TICK 22 
+// set when we've stretched (or squished) a tick to land on a timed command, so the next one puts it back 
+volatile boolean tickRetimed = false;
+#elif defined(ARDUINO_ARCH_RP2040)
+#include "pico/stdlib.h"
+#include <hardware/timer.h>
+#include <hardware/irq.h>
+#include <hardware/structs/systick.h>
+// likewise, toggled on each interrupt, to debug interval time 
+#define PIN_DEBUG_CLK 26
+#define ALARM_DT_NUM 1
+#define ALARM_DT_IRQ TIMER_IRQ_1
+#else
+#error "the motion core has timer setups for ARDUINO_ARCH_SAMD and ARDUINO_ARCH_RP2040 only"
+#endif
+
+// the tick period, in microseconds: the RP2040's alarm is re-armed w/ this on every tick, 
+uint32_t delT_us = 100;
+
+// NOTE: we need to do some maths here to set an absolute-maximum velocities... based on integrator width 
+// and... could this be simpler? like, we have two or three "maximum" accelerations ?? operative and max ? 
+
+// fp tests would be... writing to int, reading back floats, checking consistency 
+// can probably use osap::debug ? 
+
+// ---------------------------------------------- stateful stuff 
+// ok, we store delT as a *float* - but we don't use it much in the 
+// integrator... or at all; rather, it's used to convert our rates 
+// (accel, vel) (which are in units-per-integration-step), 
+// to/from normal-person rates (which are in units-per-second):
+// additionally, this is re-calculated at startup, when we are told 
+// how many microseconds happen in each integration, 
+float delT = 0.001F; 
+// (microstepping belongs to the stepper driver, each stepper_step() is one microstep, whatever size that is) 
+// states (units are steps, 1=1 ?) 
+// these all belong to the integrator (it's the only one that writes them), see the handoffs below 
+uint8_t mode = MOTION_MODE_POS;            // operative mode 
+fpPos_t pos;                               // current position (64-wide!) 
+fpRate_t vel;                              // current velocity 
+fpRate_t accel;                            // current acceleration 
+// and settings... 
+fpRate_t maxAccel;                         // absolute maximum acceleration (steps / sec) (not recalculated, but given w/ user instructions)
+fpRate_t maxVel;                           // absolute maximum velocity (units / sec) (also recalculated on init)
+// and targets, 
+fpPos_t posTarget;
+fpRate_t velTarget;
+// ---------------------------------------------- limit switch & homing 
+// the pin ISR counts edges, and the integrator counts what it's seen, so that each only has one writer 
+volatile uint32_t limitEdges = 0;
+uint32_t limitEdgesSeen = 0;
+fpPos_t limitPos;                          // where we were at the last one, 
+volatile boolean limitStop = false;
+// bumped (by the integrator) each time a limit stops us, so that the loop knows its queue was dropped 
+volatile uint32_t limitStops = 0;
+uint8_t homePhase = MOTION_HOME_IDLE;
+fpRate_t homeSeekVel;                      // signed, toward the switch, 
+fpRate_t homeLatchVel;
+fpPos_t homeBackoff;                       // signed, away from it, 
+fpPos_t homeMaxTravel;
+fpPos_t homePhaseStart;                    // where the seek (or approach) started, to check travel against 
+// ---------------------------------------------- integrator-internal stuff 
+// init-once values we'll use in the integrator 
+fpRate_t stepModulo;
+fpPos_t distanceToTarget;
+
+// ---------------------------------------------- when-to-decelerate 
+// we decelerate when (2 * a * d) <= (v^2), for distance-to-target d, and compare both sides in `24.40`: 
+// velocity is reduced to `12.20` before we square it, accel to `4.28` and distance to `52.12` before they meet, 
+// this used to be a hand-tuned FP_STOPCALC_REDUCE shift, now the static_asserts below check the ranges, 
+// (distance keeps enough bits to see ~ one tick of travel at crawl speeds, or we dither about the target) 
+typedef Fixed<12, 20> fpStopVel_t;
+typedef Fixed<4, 28> fpStopAccel_t;
+typedef Fixed<52, 12> fpStopDist_t;
+typedef Fixed<24, 40> fpStopCalc_t;
+
+fpStopCalc_t twoDA;
+fpStopCalc_t vSquared;
+
+// rates are never more than one-unit-per-integration-step (or we would miss steps), 
+// and accels are kept above a minimum, so that the longest stop we ever need to see coming 
+// (from max rate, at min accel) is less than this far off... past that, we can clamp distances in the calc, 
+constexpr fpRate_t absMaxRate = fpRate_t::fromInt(1);
+constexpr fpRate_t minAccel = fpRate_t::fromRaw(1 << 9);                  // 2^-21, ~ 0.05 steps/sec^2 at 10kHz
+constexpr fpStopDist_t stopCalcMaxDist = fpStopDist_t::fromInt(1 << 21);  // ~ 2M steps 
+constexpr fpPos_t stopCalcDistRound = fpPos_t::fromRaw(((int64_t)1 << (fpPos_t::fracBits - fpStopDist_t::fracBits)) - 1);
+
+static_assert(fpStopDist_t::fracBits + fpStopAccel_t::fracBits == fpStopCalc_t::fracBits, "2 * d * a lands in the stop-calc format");
+static_assert(2 * fpStopVel_t::fracBits == fpStopCalc_t::fracBits, "v^2 lands in the stop-calc format");
+// the clamp is safe: at the clamped distance and min accel, we're still further off than we'd need to stop from max rate, 
+static_assert(fp_mulWide(stopCalcMaxDist << 1, minAccel.as<fpStopAccel_t>()) > fp_mulWide(absMaxRate.as<fpStopVel_t>(), absMaxRate.as<fpStopVel_t>()), "stop-calc distance clamp is shorter than the longest stop");
+// and neither side can overflow, given the clamp and the max accel, 
+static_assert(fp_productFits(stopCalcMaxDist << 1, absMaxRate.as<fpStopAccel_t>()), "2 * d * a can overflow the stop-calc");
+static_assert(fp_productFits(absMaxRate.as<fpStopVel_t>(), absMaxRate.as<fpStopVel_t>()), "v^2 can overflow the stop-calc");
+
+// the comparison itself, returns the accel we should use, 
+// (for a regular position target, exitVSquared is zero: we want to arrive at rest) 
+static inline fpRate_t motion_when2Decel(fpPos_t _dist, fpRate_t _vel, fpRate_t _maxAccel, fpStopCalc_t _exitVSquared){
+  // rounding distance up, so that we only see "zero distance" when we're there, 
+  fpStopDist_t _absDist = (_dist.magnitude() + stopCalcDistRound).as<fpStopDist_t>();
+  if(_absDist > stopCalcMaxDist) _absDist = stopCalcMaxDist;
+  // (x << 1) == (x * 2), that's gorgus, 
+  fpStopCalc_t _twoDA = fp_mulWide(_absDist << 1, _maxAccel.as<fpStopAccel_t>());
+  fpStopVel_t _v = _vel.as<fpStopVel_t>();
+  fpStopCalc_t _vSquared = fp_mulWide(_v, _v) - _exitVSquared;
+  twoDA = _twoDA;
+  vSquared = _vSquared;
+  // we can use that to compare when-2-stop, 
+  if(_twoDA <= _vSquared){                      // if we're going to overshoot, deccel:
+    return _vel.isPositive() ? -_maxAccel : _maxAccel;
+  } else {                                      // if we're not going to overshoot, accel towards, 
+    return _dist.isPositive() ? _maxAccel : -_maxAccel;
+  }
+}
+
+// rates arrive in units-per-sec and units-per-sec^2, we elevate them to units-per-integration-step, 
+// and keep them inside of the ranges that the stop-calc is checked for, 
+fpRate_t motion_velFromUser(float _vel){
+  fpRate_t _cand = fpRate_t::fromFloat(_vel * delT);
+  if(_cand > absMaxRate) _cand = absMaxRate;
+  if(_cand < -absMaxRate) _cand = -absMaxRate;
+  return _cand;
+}
+
+fpRate_t motion_accelFromUser(float _accel){
+  // I think that we might need to scale accel by delT^2, since 2nd derivative (?) or sth ?
+  fpRate_t _cand = fpRate_t::fromFloat(_accel * delT * delT);
+  if(_cand > absMaxRate) _cand = absMaxRate;
+  if(_cand < minAccel) _cand = minAccel;
+  return _cand;
+}
+
+// ---------------------------------------------- s-curves 
+// w/ a jerk limit J, accel ramps at J toward +/- maxAccel (A), and we track it as a fraction of A (alpha), 
+// so that jerk is a fraction-per-tick too, and the ramp's whole velocity change (A^2 / J, "rampVel") is one number: 
+// then the stopping distance (times A) from v & alpha is a few multiplies, with no division or sqrt, see motion_scurveMustBrake() 
+// all of that is in `6.26`, we clamp d * A to 8 (we can always stop in less than that), and A is at least 2^-18, 
+// so that the stop-calc's distance clamp is still "far", and rampVel is at most 2 (past that, A would never be reached anyways) 
+typedef Fixed<6, 26> fpJerkCalc_t;
+
+constexpr fpRate_t jerkMinAccel = fpRate_t::fromRaw(1 << 12);                 // 2^-18, ~ 0.26 steps/sec^2 at 10kHz 
+constexpr fpRate_t jerkMinNorm = fpRate_t::fromRaw(1 << 14);                  // 2^-16, ramps are at most 65536 ticks 
+constexpr fpJerkCalc_t jerkCalcMaxDA = fpJerkCalc_t::fromInt(8);
+constexpr fpJerkCalc_t jerkMaxRampVel = fpJerkCalc_t::fromInt(2);
+
+// v + alpha^2 * rampVel / 2 is at most 2, so the widest products are (8 * 8) and (2^2 * 2 * 2), 
+static_assert(fp_mulWide(stopCalcMaxDist, jerkMinAccel.as<fpStopAccel_t>()) >= jerkCalcMaxDA.as<fpStopCalc_t>(), "jerk stop-calc distance clamp is shorter than the longest stop");
+static_assert(fp_productFits(jerkCalcMaxDA, jerkCalcMaxDA), "(d * A)^2 can overflow the jerk stop-calc");
+static_assert(fp_productFits(fpJerkCalc_t::fromInt(4), fpJerkCalc_t::fromInt(4)), "v^3 * rampVel can overflow the jerk stop-calc");
+
+static inline fpJerkCalc_t motion_jerkMul(fpJerkCalc_t _a, fpJerkCalc_t _b){
+  return fp_mulWide(_a, _b).as<fpJerkCalc_t>();
+}
+
+// and the integrator's s-curve state, 
+fpRate_t accelNorm;                        // accel, as a fraction of maxAccel, signed 
+fpRate_t jerkNorm;                         // and how much that changes per tick, 
+fpJerkCalc_t rampVel;                      // A^2 / J 
+fpJerkCalc_t rampVelSqThird;               // (A^2 / J)^2 / 3 
+boolean scurveBraking = false;             // we've started the stop, 
+boolean scurveForwards = false;            // toward the target, last tick 
+
+// ---------------------------------------------- sequential motion 
+// each segment is a move to some end position, at some rates, which we leave 
+// at a planned (junction) velocity rather than stopping, if the next one lets us 
+// the integrator runs them along a path: it integrates speed & distance along the segment, and moves the axis by 
+// its share of that (the ratio), so that axes which are handed the same line (by a synchronizer) run the same numbers, 
+// and stay on it thru the corners, even those that sit still for a segment... 
+// a lone axis' segments are the same thing, w/ a ratio of +/- 1 and lengths in steps 
+// ratios are in steps-per-path-unit, so a synchronizer's units can be ~ 32k steps long, at most 
+typedef Fixed<16, 16> fpRatio_t;
+
+typedef struct motionSegment_t {
+  fpPos_t start;                  // where it starts, (the last one's end, or where we were) 
+  fpPos_t end;                    // where it ends, 
+  fpPos_t length;                 // along the path, in path units (steps, for a lone axis) 
+  fpRatio_t ratio;                // how far we move (signed) per path unit, 
+  fpRate_t maxVel;                // path rates, in units-per-integration-step (as above) 
+  fpRate_t maxAccel;
+  fpRate_t axisMaxVel;            // and our share of those, for state queries, 
+  fpRate_t axisMaxAccel;
+  fpStopCalc_t exitVSquared[2];   // planned junction (path) velocity, squared as vSquared is, in two slots: 
+  volatile uint8_t exitSlot;      // the planner writes the one the integrator isn't reading, then flips this 
+  float junctionMax;              // for the planner, the fastest we can take the junction *into* this one, per-tick 
+  boolean lone;                   // or is this one line of a synchronizer's path ? 
+} motionSegment_t;
+
+// (only the integrator calls this, so the loop never lands in the middle of it) 
+static inline fpStopCalc_t motion_exitVSquared(motionSegment_t* seg){
+  return seg->exitVSquared[seg->exitSlot];
+}
+
+#define MOTION_QUEUE_MASK (MOTION_QUEUE_SIZE - 1)
+
+motionSegment_t queue[MOTION_QUEUE_SIZE];
+volatile uint8_t queueHead = 0;   // next slot to write into, 
+volatile uint8_t queueTail = 0;   // the segment we are on, 
+// how far along that we are, and how fast we're going along it (these belong to the integrator) 
+fpPos_t pathPos;
+fpRate_t pathVel;
+
+// a tick's travel is never more than one unit, so its share fits in the products' format, 
+static_assert(fp_productFits(fpRatio_t::max(), absMaxRate), "a ratio times a tick's travel can overflow");
+
+// ---------------------------------------------- telemetry 
+// the integrator writes raw samples here, and motion_drainTelemetry() converts them to floats, 
+// it's single-producer single-consumer, so the head (ISR) and tail (loop) each only have one writer 
+typedef struct motionTelemetrySlot_t {
+  uint32_t sampleNum;
+  fpPos_t pos;
+  fpRate_t vel;
+  fpRate_t accel;
+} motionTelemetrySlot_t;
+
+#define MOTION_TELEMETRY_MASK (MOTION_TELEMETRY_SIZE - 1)
+
+motionTelemetrySlot_t telemetry[MOTION_TELEMETRY_SIZE];
+volatile uint8_t telemetryHead = 0;       // next slot to write into, 
+volatile uint8_t telemetryTail = 0;       // next slot to read from, 
+volatile uint16_t telemetryDecimation = 0;
+uint16_t telemetryCountdown = 0;
+uint32_t telemetrySampleNum = 0;
+
+// ---------------------------------------------- events 
+// the same single-producer single-consumer ring as telemetry, the integrator writes, motion_getEvent() reads, 
+typedef struct motionEventSlot_t {
+  uint32_t eventNum;
+  uint8_t type;
+  uint8_t code;
+  fpPos_t pos;
+  fpRate_t vel;
+} motionEventSlot_t;
+
+#define MOTION_EVENT_MASK (MOTION_EVENT_SIZE - 1)
+
+motionEventSlot_t events[MOTION_EVENT_SIZE];
+volatile uint8_t eventHead = 0;
+volatile uint8_t eventTail = 0;
+volatile uint32_t eventNum = 0;
+// set when a target comes in, and cleared when we report that we got there, 
+boolean arrivalPending = false;
+
+// ---------------------------------------------- tick timing 
+// the ISR times itself w/ the cpu's SysTick, a 24-bit down-counter at the cpu clock: the arduino core runs it 
+// w/ a 1ms period on the D21, and on the RP2040 we start it (free-running) if nobody else has, 
+// tick intervals are only measured right while they're shorter than one SysTick period... which they had better be 
+#define MOTION_CYCLES_PER_US (F_CPU / 1000000)
+
+typedef struct motionTimingStat_t {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t hist[MOTION_TIMING_BINS];
+} motionTimingStat_t;
+
+// these belong to the ISR, which publishes them w/ a seqlock, as the snapshot (below) 
+motionTimingStat_t timingCost;
+motionTimingStat_t timingInterval;
+volatile uint32_t timingSeq = 0;
+uint32_t timingLastEntry = 0;
+boolean timingHaveLast = false;         // there's no interval to measure on the first tick, or after a re-timed one, 
+boolean timingSkipInterval = false;
+volatile boolean timingResetRequested = true;
+
+// ---------------------------------------------- handoffs, w/o critical sections 
+// the integrator owns all of the states above: the loop never writes them, and never turns interrupts off to read them, 
+// instead, setters post commands into this ring, which the integrator applies (in order) at the top of each tick, 
+// (MOTION_COMMAND_SIZE is in the header) 
+#define MOTION_COMMAND_MASK (MOTION_COMMAND_SIZE - 1)
+
+#define MOTION_COMMAND_POS_TARGET 0
+#define MOTION_COMMAND_VEL_TARGET 1
+#define MOTION_COMMAND_QUEUE 2
+#define MOTION_COMMAND_SET_POSITION 3
+#define MOTION_COMMAND_HOME 4
+#define MOTION_COMMAND_SCURVE_TARGET 5
+
+typedef struct motionCommand_t {
+  uint8_t type;
+  fpPos_t pos;            // target, or new position, 
+  fpRate_t vel;           // velocity target, 
+  fpRate_t maxVel;
+  fpRate_t maxAccel;
+  fpRate_t latchVel;      // homing, seek is in vel, backoff in pos, 
+  fpPos_t maxTravel;
+  fpRate_t jerkNorm;      // s-curves, see above 
+  fpJerkCalc_t rampVel;
+  fpJerkCalc_t rampVelSqThird;
+  uint8_t flushTo;        // targets drop the segments queued before them, i.e. up to here 
+  boolean timed;          // if set, the integrator holds this (and everything behind it) 'till executeAt, 
+  uint32_t executeAt;     // in device time, see motion_getTime() 
+} motionCommand_t;
+
+motionCommand_t commands[MOTION_COMMAND_SIZE];
+volatile uint8_t commandHead = 0;   // loop writes, 
+volatile uint8_t commandTail = 0;   // integrator reads, 
+
+// and the integrator publishes a snapshot of its states at the end of each tick, w/ a sequence number (a seqlock): 
+// it's odd while the snapshot is being written, so readers retry if they see that, or if it changes under them 
+typedef struct motionSnapshot_t {
+  fpPos_t pos;
+  fpRate_t vel;
+  fpRate_t accel;
+  fpPos_t distanceToTarget;
+  fpRate_t maxVel;
+  fpRate_t maxAccel;
+  fpStopCalc_t twoDA;
+  fpStopCalc_t vSquared;
+  uint8_t homePhase;
+  uint32_t limitCount;
+  fpPos_t limitPos;
+} motionSnapshot_t;
+
+volatile uint32_t snapshotSeq = 0;
+motionSnapshot_t snapshot;
+
+// the loop's writes to a slot (or the snapshot) must land before the index that hands it over, 
+// interrupts are on the same core, so we only need the compiler to keep them in order, 
+#define MOTION_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// the loop keeps track of where the last segment it queued ends, so that it doesn't have to ask the integrator, 
+boolean segmentEndKnown = false;
+fpPos_t segmentEnd;
+uint32_t segmentLimitStops = 0;
+
+// ---------------------------------------------- clock sync 
+// the host tells us what time it was (on its clock) when we read some time on ours, every so often, 
+// we keep the latest pair as a reference, and the rate between the two clocks, to map host times onto ours 
+// (this is all loop-side, the integrator only ever sees device times) 
+boolean clockSynced = false;
+uint32_t syncHostRef = 0;
+uint32_t syncDeviceRef = 0;
+float syncRate = 1.0F;
+boolean syncRateKnown = false;
+// we only update the rate over intervals at least this long, so that jitter in the exchange doesn't swamp it, 
+#define MOTION_SYNC_RATE_MIN_INTERVAL 1000000
+// and timed commands can't be scheduled further out than this (past it, we go right away), 
+// since they hold up everything behind them 
+#define MOTION_SCHEDULE_MAX_US 100000
+// nor closer in than this, when we're re-timing a tick to land on them: the ISR has to have left first 
+#define MOTION_RETIME_MIN_US 20
+
+// s/o to http://academy.cba.mit.edu/classes/output_devices/servo/hello.servo-registers.D11C.ino 
+// s/o also to https://gist.github.com/nonsintetic/ad13e70f164801325f5f552f84306d6f 
+void motion_init(int32_t microsecondsPerIntegration){
+  delT_us = microsecondsPerIntegration;
+  // -------------------------------------------- Maximums, given delta-tee,
+  // before we get into hardware, let's consider our absolute-maximums;
+  // here's our delta-tee, in real seconds:
+  delT = (float)(microsecondsPerIntegration) / 1000000.0F;
+  // that's ~ a base also for conversion as we swap around our internal units 
+  // (which use units-per-integration-step), and the outside world (units-per-second)
+  // first we want an absolute-max velocity: this is one-unit-per-integration-step, 
+  // so actually it's just this, nice:
+  // (that's absMaxRate, above) 
+  // init our maxVel to this absMax: 
+  maxVel = absMaxRate;
+  // and let's pick a startup accel that's ~ a tenth of this, idk:
+  maxAccel = absMaxRate.mulSat(fpRate_t::fromFloat(0.1F));
+  // -------------------------------------------- Hardware Setup 
+  // that's it - we can get on with the hardware configs 
+#if defined(ARDUINO_ARCH_SAMD)
+#ifdef PIN_TICK
+  PORT->Group[0].DIRSET.reg = (uint32_t)(1 << PIN_TICK);
+#endif
+  // states are all initialized already, but we do want to get set-up on a timer interrupt, 
+  // here we're using GCLK4, which I am assuming is set-up already / generated, in the 
+  // stepper module, which uses it for PWM outputs ! 
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | 
+                      GCLK_CLKCTRL_GEN_GCLK4 |
+                      GCLK_CLKCTRL_ID_TC4_TC5;
+  while(GCLK->STATUS.bit.SYNCBUSY);
+  // now we want to unmask the TC5, 
+  PM->APBCMASK.reg |= PM_APBCMASK_TC5;
+  // set timer modes / etc, 
+  TC5->COUNT16.CTRLA.reg |= TC_CTRLA_MODE_COUNT16 |
+                            TC_CTRLA_WAVEGEN_MFRQ |
+                            TC_CTRLA_PRESCALER_DIV8; // div/8 on 48mhz clock, so 6MHz base, 6-ticks-per-microsecond, 
+  while(TC5->COUNT16.STATUS.bit.SYNCBUSY);
+  // enable the interrupt,
+  NVIC_DisableIRQ(TC5_IRQn);
+  NVIC_ClearPendingIRQ(TC5_IRQn);
+  NVIC_SetPriority(TC5_IRQn, 1); // hmmm 
+  NVIC_EnableIRQ(TC5_IRQn);
+  TC5->COUNT16.INTENSET.bit.MC0 = 1;
+  // set la freqweenseh
+  TC5->COUNT16.CC[0].reg = 6 * microsecondsPerIntegration;
+  // and enable it, 
+  TC5->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+  while(TC5->COUNT16.STATUS.bit.SYNCBUSY);
+#elif defined(ARDUINO_ARCH_RP2040)
+  // on the RP2040 we use one of the timer's alarms, re-armed on each tick 
+  pinMode(PIN_DEBUG_CLK, OUTPUT);
+  hw_set_bits(&timer_hw->inte, 1u << ALARM_DT_NUM);
+  irq_set_exclusive_handler(ALARM_DT_IRQ, alarm_dt_Handler);
+  irq_set_enabled(ALARM_DT_IRQ, true);
+  // and SysTick, for timing, if it's not running already: processor clock, no interrupt, full 24 bits 
+  if(!(systick_hw->csr & 1)){
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;
+  }
+  timer_hw->alarm[ALARM_DT_NUM] = (uint32_t) (timer_hw->timerawl + delT_us);
+#endif
+}
+
+// the ISRs time themselves, see motion_recordTiming() 
+static inline uint32_t motion_cycleCount(void);
+static void motion_recordTiming(uint32_t _entry);
+
+#if defined(ARDUINO_ARCH_SAMD)
+void TC5_Handler(void){
+  uint32_t _entry = motion_cycleCount();
+#ifdef PIN_TICK
+  PORT->Group[0].OUTSET.reg = (uint32_t)(1 << PIN_TICK);  // marks interrupt entry, to debug 
+#endif
+  TC5->COUNT16.INTFLAG.bit.MC0 = 1; // clear the interrupt
+  // if we squished the last tick, put the period back, 
+  if(tickRetimed){
+    TC5->COUNT16.CC[0].reg = 6 * delT_us;
+    while(TC5->COUNT16.STATUS.bit.SYNCBUSY);
+    tickRetimed = false;
+  }
+  motion_integrate(); // do the motion system integration, 
+#ifdef PIN_TICK
+  PORT->Group[0].OUTCLR.reg = (uint32_t)(1 << PIN_TICK);  // marks exit 
+#endif
+  motion_recordTiming(_entry);
+}
+#elif defined(ARDUINO_ARCH_RP2040)
+void alarm_dt_Handler(void){
+  uint32_t _entry = motion_cycleCount();
+  // setup next call right away
+  hw_clear_bits(&timer_hw->intr, 1u << ALARM_DT_NUM);
+  timer_hw->alarm[ALARM_DT_NUM] = (uint32_t) (timer_hw->timerawl + delT_us);
+  sio_hw->gpio_set = (uint32_t)(1 << PIN_DEBUG_CLK);  // marks interrupt entry, to debug 
+  motion_integrate(); // do the motion system integration, 
+  sio_hw->gpio_clr = (uint32_t)(1 << PIN_DEBUG_CLK);  // marks exit 
+  motion_recordTiming(_entry);
+}
+#endif
+
+uint32_t motion_getTime(void){
+#if defined(ARDUINO_ARCH_SAMD)
+  return micros();
+#elif defined(ARDUINO_ARCH_RP2040)
+  return timer_hw->timerawl;
+#endif
+}
+
+static inline uint32_t motion_cycleCount(void){
+#if defined(ARDUINO_ARCH_SAMD)
+  return SysTick->VAL;
+#elif defined(ARDUINO_ARCH_RP2040)
+  return systick_hw->cvr;
+#endif
+}
+
+// cycles from one SysTick reading to a later one, it counts down, and wraps at the reload, 
+static inline uint32_t motion_cyclesBetween(uint32_t _earlier, uint32_t _later){
+#if defined(ARDUINO_ARCH_SAMD)
+  uint32_t _period = SysTick->LOAD + 1;
+#elif defined(ARDUINO_ARCH_RP2040)
+  uint32_t _period = systick_hw->rvr + 1;
+#endif
+  return (_earlier >= _later) ? (_earlier - _later) : (_earlier + _period - _later);
+}
+
+static inline void motion_addTiming(motionTimingStat_t* stat, uint32_t _cycles, int32_t _bin){
+  if(_bin < 0) _bin = 0;
+  if(_bin >= MOTION_TIMING_BINS) _bin = MOTION_TIMING_BINS - 1;
+  if(stat->count == 0 || _cycles < stat->min) stat->min = _cycles;
+  if(_cycles > stat->max) stat->max = _cycles;
+  stat->sum += _cycles;
+  stat->count ++;
+  stat->hist[_bin] ++;
+}
+
+// the tail end of each ISR: cost runs from entry up to here (so this bit isn't counted), 
+// and the interval is from the last entry to this one 
+static void motion_recordTiming(uint32_t _entry){
+  uint32_t _cost = motion_cyclesBetween(_entry, motion_cycleCount());
+  uint32_t _tick = delT_us * MOTION_CYCLES_PER_US;
+  timingSeq = timingSeq + 1;
+  MOTION_BARRIER();
+  if(timingResetRequested){
+    memset(&timingCost, 0, sizeof(timingCost));
+    memset(&timingInterval, 0, sizeof(timingInterval));
+    timingResetRequested = false;
+  }
+  motion_addTiming(&timingCost, _cost, (int32_t)(_cost * MOTION_TIMING_BINS / _tick));
+  if(timingHaveLast){
+    uint32_t _interval = motion_cyclesBetween(timingLastEntry, _entry);
+    int32_t _late = (int32_t)_interval - (int32_t)_tick;
+    // floored, so that (say) half a microsecond early is in the bin below center, 
+    int32_t _lateUs = (_late >= 0) ? (_late / MOTION_CYCLES_PER_US) : -((-_late + MOTION_CYCLES_PER_US - 1) / MOTION_CYCLES_PER_US);
+    motion_addTiming(&timingInterval, _interval, MOTION_TIMING_BINS / 2 + _lateUs);
+  }
+  MOTION_BARRIER();
+  timingSeq = timingSeq + 1;
+  timingLastEntry = _entry;
+  timingHaveLast = !timingSkipInterval;
+  timingSkipInterval = false;
+}
+
+// brings the next tick in, so that it lands on this (device) time, which is less than one period away: 
+// boards that are sync'd to the same host clock then start timed moves together, not just in the same tick 
+static inline void motion_retimeNextTick(uint32_t _wait, uint32_t _at){
+#if defined(ARDUINO_ARCH_SAMD)
+  // the counter is just past wrapping, so this is ~ _wait from now, and the next ISR puts it back 
+  TC5->COUNT16.CC[0].reg = 6 * _wait;
+  while(TC5->COUNT16.STATUS.bit.SYNCBUSY);
+  tickRetimed = true;
+#elif defined(ARDUINO_ARCH_RP2040)
+  // the alarm re-arms itself from wherever this one fires, so that's all there is to it 
+  timer_hw->alarm[ALARM_DT_NUM] = _at;
+#endif
+  // that's on purpose, so it's not jitter 
+  timingSkipInterval = true;
+}
+
+// segments start where the loop thought we'd be, which is where we are unless it read a snapshot from a little while ago, 
+// (we were still moving, or the position was set since), in which case we set off from here instead, 
+// that's a division, but only when we start a segment from somewhere else 
+static void motion_rebaseSegment(motionSegment_t* seg, fpPos_t _pos){
+  float _ratio = (seg->end - _pos).toFloat() / seg->length.toFloat();
+  if(fabsf(_ratio) < fpRatio_t::max().toFloat()) seg->ratio = fpRatio_t::fromFloat(_ratio);
+  seg->start = _pos;
+}
+
+// when we switch into the queue, we pick up our speed along the first segment, 
+static void motion_startQueue(void){
+  motionSegment_t* seg = &queue[queueTail];
+  pathPos = fpPos_t();
+  pathVel = fpRate_t();
+  if(queueTail == queueHead) return;
+  if(seg->start != pos) motion_rebaseSegment(seg, pos);
+  if(!vel.isZero() && !seg->ratio.isZero()){
+    float _pathVel = vel.toFloat() / seg->ratio.toFloat();
+    if(_pathVel > seg->maxVel.toFloat()) _pathVel = seg->maxVel.toFloat();
+    if(_pathVel < -seg->maxVel.toFloat()) _pathVel = -seg->maxVel.toFloat();
+    pathVel = fpRate_t::fromFloat(_pathVel);
+  }
+}
+
+// applies whatever the loop has posted since the last tick, 
+static inline void motion_applyCommands(uint32_t _now){
+  uint8_t _tail = commandTail;
+  uint8_t _head = commandHead;
+  MOTION_BARRIER();
+  while(_tail != _head){
+    motionCommand_t* cmd = &commands[_tail];
+    if(cmd->timed){
+      uint32_t _wait = cmd->executeAt - _now;
+      if((int32_t)_wait >= MOTION_RETIME_MIN_US){
+        // not yet, but if it's before the next tick, we can land on it exactly, 
+        if(_wait < delT_us) motion_retimeNextTick(_wait, cmd->executeAt);
+        break;
+      }
+    }
+    // any target takes over from homing, and we'll say when we get there, 
+    if(cmd->type != MOTION_COMMAND_SET_POSITION){
+      if(mode == MOTION_MODE_HOME) homePhase = MOTION_HOME_IDLE;
+      arrivalPending = true;
+    }
+    switch(cmd->type){
+      case MOTION_COMMAND_POS_TARGET:
+        maxVel = cmd->maxVel;
+        maxAccel = cmd->maxAccel;
+        posTarget = cmd->pos;
+        mode = MOTION_MODE_POS;
+        queueTail = cmd->flushTo;
+        break;
+      case MOTION_COMMAND_SCURVE_TARGET:
+        maxVel = cmd->maxVel;
+        maxAccel = cmd->maxAccel;
+        posTarget = cmd->pos;
+        jerkNorm = cmd->jerkNorm;
+        rampVel = cmd->rampVel;
+        rampVelSqThird = cmd->rampVelSqThird;
+        // we carry on from an s-curve's accel, but another mode's bang-bang accel would be a step anyways 
+        if(mode != MOTION_MODE_SCURVE) accelNorm = fpRate_t();
+        scurveBraking = false;
+        mode = MOTION_MODE_SCURVE;
+        queueTail = cmd->flushTo;
+        break;
+      case MOTION_COMMAND_VEL_TARGET:
+        maxAccel = cmd->maxAccel;
+        velTarget = cmd->vel;
+        mode = MOTION_MODE_VEL;
+        queueTail = cmd->flushTo;
+        break;
+      case MOTION_COMMAND_QUEUE:
+        if(mode != MOTION_MODE_QUEUE) motion_startQueue();
+        mode = MOTION_MODE_QUEUE;
+        break;
+      case MOTION_COMMAND_SET_POSITION:
+        pos = cmd->pos;
+        break;
+      case MOTION_COMMAND_HOME:
+        maxVel = cmd->vel.magnitude();
+        maxAccel = cmd->maxAccel;
+        homeSeekVel = cmd->vel;
+        homeLatchVel = cmd->latchVel;
+        homeBackoff = cmd->pos;
+        homeMaxTravel = cmd->maxTravel;
+        homePhaseStart = pos;
+        homePhase = MOTION_HOME_SEEK;
+        mode = MOTION_MODE_HOME;
+        queueTail = cmd->flushTo;
+        break;
+    }
+    _tail = (_tail + 1) & MOTION_COMMAND_MASK;
+  }
+  commandTail = _tail;
+}
+
+// stopping distance, from v (toward the target) and alpha, vs. the distance to go, all times A: 
+// if we ramp accel down from here, it passes thru zero at v* = v + alpha^2 * rampVel / 2, after (v * alpha * rampVel + alpha^3 * rampVel^2 / 3), 
+// and from v* at zero accel, it's (v*^2 + v* * rampVel) / 2 if we reach -A, and v* * sqrt(v* * rampVel) if we don't (so we compare squares) 
+// if we're already ramping down, we were at zero accel (at v*) a little while ago, and take off the (v* * |alpha| * rampVel - |alpha|^3 * rampVel^2 / 6) since, 
+// so this is checked every tick of the stop, as when2Decel is, and we ease off if we'd stop short 
+static inline boolean motion_scurveMustBrake(fpPos_t _dist, fpRate_t _v, fpRate_t _alpha, fpRate_t _maxAccel){
+  fpJerkCalc_t _vr = rampVel;
+  fpJerkCalc_t _vs = _v.as<fpJerkCalc_t>();
+  fpJerkCalc_t _a = _alpha.magnitude().as<fpJerkCalc_t>();
+  fpJerkCalc_t _a2 = motion_jerkMul(_a, _a);
+  fpJerkCalc_t _a3 = motion_jerkMul(_a2, _a);
+  fpJerkCalc_t _ramp;
+  if(_alpha.isPositive()){
+    _ramp = motion_jerkMul(motion_jerkMul(_vs, _a), _vr) + motion_jerkMul(_a3, rampVelSqThird);
+    _vs += motion_jerkMul(_a2, _vr) >> 1;
+  } else if(_alpha.isNegative()){
+    _vs += motion_jerkMul(_a2, _vr) >> 1;
+    _ramp = motion_jerkMul(_a3, rampVelSqThird >> 1) - motion_jerkMul(motion_jerkMul(_vs, _a), _vr);
+  }
+  // (we integrate velocity before position, so each tick moves at the end-of-tick rate, and the stop comes up half a tick's travel short of the above) 
+  fpStopDist_t _absDist = (_dist.magnitude() + (_v >> 1).as<fpPos_t>() + stopCalcDistRound).as<fpStopDist_t>();
+  if(_absDist > stopCalcMaxDist) _absDist = stopCalcMaxDist;
+  fpStopCalc_t _da = fp_mulWide(_absDist, _maxAccel.as<fpStopAccel_t>());
+  fpJerkCalc_t _x = (_da > jerkCalcMaxDA.as<fpStopCalc_t>()) ? jerkCalcMaxDA : _da.as<fpJerkCalc_t>();
+  _x -= _ramp;
+  if(!_x.isPositive()) return true;
+  if(_vs >= _vr) return (_x << 1) <= motion_jerkMul(_vs, _vs + _vr);
+  return fp_mulWide(_x, _x) <= fp_mulWide(motion_jerkMul(_vs, _vs), motion_jerkMul(_vs, _vr));
+}
+
+// picks this tick's accel: up toward +A, down toward -A to stop, or back to zero as we reach maxVel (or rest), 
+// alpha moves by one jerkNorm per tick at most 
+static inline fpRate_t motion_scurveAccel(fpPos_t _dist, fpRate_t _vel, fpRate_t _maxVel, fpRate_t _maxAccel){
+  // we work in the target's frame, +ve is toward it, 
+  boolean _fwd = _dist.isPositive();
+  if(_fwd != scurveForwards) scurveBraking = false;
+  scurveForwards = _fwd;
+  fpRate_t _v = _fwd ? _vel : -_vel;
+  fpRate_t _alpha = _fwd ? accelNorm : -accelNorm;
+  fpRate_t _j = jerkNorm;
+  fpRate_t _floor = -absMaxRate;
+  fpRate_t _ceil = absMaxRate;
+  if(_v.isNegative()){
+    // headed away, turn around 
+    scurveBraking = false;
+    _alpha += _j;
+  } else if(scurveBraking && _alpha.isNegative() && (_v.as<fpJerkCalc_t>() << 1) <= motion_jerkMul(motion_jerkMul(_alpha.as<fpJerkCalc_t>(), _alpha.as<fpJerkCalc_t>()), rampVel)){
+    // let go when ramping accel back to zero takes off what's left of our velocity, i.e. 2 * v <= alpha^2 * rampVel 
+    _alpha += _j;
+    _ceil = fpRate_t();
+  } else if(motion_scurveMustBrake(_dist, _v, _alpha, _maxAccel)){
+    scurveBraking = true;
+    _alpha -= _j;
+  } else {
+    // we'd coast to v* if we ramped accel to zero from here, so we start that as v* reaches maxVel 
+    fpJerkCalc_t _a = _alpha.as<fpJerkCalc_t>();
+    fpJerkCalc_t _vs = _v.as<fpJerkCalc_t>();
+    if(_alpha.isPositive()) _vs += motion_jerkMul(motion_jerkMul(_a, _a), rampVel) >> 1;
+    if(_vs >= _maxVel.as<fpJerkCalc_t>()){
+      _alpha -= _j;
+      // (and if we're over it, say a lower maxVel came in, we slow down) 
+      if(_v <= _maxVel) _floor = fpRate_t();
+    } else {
+      _alpha += _j;
+    }
+  }
+  if(_alpha > _ceil) _alpha = _ceil;
+  if(_alpha < _floor) _alpha = _floor;
+  accelNorm = _fwd ? _alpha : -_alpha;
+  fpRate_t _accel = fp_mulWide(_alpha, _maxAccel).as<fpRate_t>();
+  return _fwd ? _accel : -_accel;
+}
+
+// the integrator's half of the event ring, 
+static void motion_pushEvent(uint8_t _type, uint8_t _code, fpPos_t _pos, fpRate_t _vel){
+  uint8_t _head = eventHead;
+  uint8_t _next = (_head + 1) & MOTION_EVENT_MASK;
+  if(_next != eventTail){
+    events[_head].eventNum = eventNum;
+    events[_head].type = _type;
+    events[_head].code = _code;
+    events[_head].pos = _pos;
+    events[_head].vel = _vel;
+    MOTION_BARRIER();
+    eventHead = _next;
+  }
+  eventNum ++;
+}
+
+// homing runs as a little sequence of velocity and position moves, this picks which, and moves the phase along, 
+// returns the mode that the integrator should run this tick 
+static inline uint8_t motion_homeStep(fpPos_t& _pos, boolean _limit){
+  switch(homePhase){
+    case MOTION_HOME_SEEK:
+      if(_limit){
+        // slow down, and back off from where it tripped, 
+        posTarget = limitPos + homeBackoff;
+        homePhase = MOTION_HOME_BACKOFF;
+        return MOTION_MODE_POS;
+      }
+      break;
+    case MOTION_HOME_BACKOFF:
+      // (the switch bounces as it lets go, so we ignore it here) 
+      if(_pos != posTarget) return MOTION_MODE_POS;
+      maxVel = homeLatchVel.magnitude();
+      homePhaseStart = _pos;
+      homePhase = MOTION_HOME_APPROACH;
+      break;
+    case MOTION_HOME_APPROACH:
+      if(_limit){
+        // that's zero, and we park where we backed off to, 
+        _pos = fpPos_t();
+        limitPos = fpPos_t();
+        posTarget = homeBackoff;
+        maxVel = homeSeekVel.magnitude();
+        homePhase = MOTION_HOME_DONE;
+        mode = MOTION_MODE_POS;
+        return MOTION_MODE_POS;
+      }
+      break;
+  }
+  // we're seeking or approaching, at some slow rate, but not forever: 
+  if((_pos - homePhaseStart).magnitude() > homeMaxTravel){
+    motion_pushEvent(MOTION_EVENT_FAULT, MOTION_FAULT_HOME_FAILED, _pos, vel);
+    velTarget = fpRate_t();
+    homePhase = MOTION_HOME_FAILED;
+    mode = MOTION_MODE_VEL;
+    return MOTION_MODE_VEL;
+  }
+  velTarget = (homePhase == MOTION_HOME_SEEK) ? homeSeekVel : homeLatchVel;
+  return MOTION_MODE_VEL;
+}
+
+// one tick along the queue: the same when-to-decel as the position mode, on the distance left along this segment, 
+// but we only need to slow to the junction velocity, and we carry on into the next one w/ whatever travel is left over, 
+// returns the axis' delta for this tick, and sets our (axis) rates from the path's 
+static inline fpPos_t motion_queueStep(fpPos_t _pos, fpRate_t& _vel, fpRate_t& _accel, fpPos_t& _dist, fpRate_t& _maxVel, fpRate_t& _maxAccel){
+  uint8_t _tail = queueTail;
+  uint8_t _head = queueHead;
+  fpPos_t _delta;
+  // out of segments, we are dead-reckoned onto the last one's end: 
+  if(_tail == _head){
+    pathVel = fpRate_t();
+    _vel = fpRate_t();
+    _accel = fpRate_t();
+    _dist = fpPos_t();
+    return _delta;
+  }
+  motionSegment_t* seg = &queue[_tail];
+  fpPos_t _pathPos = pathPos;
+  fpRate_t _pathVel = pathVel;
+  if(_pathPos.isZero() && _pathVel.isZero() && seg->start != _pos) motion_rebaseSegment(seg, _pos);
+  fpRate_t _pathAccel = motion_when2Decel(seg->length - _pathPos, _pathVel, seg->maxAccel, motion_exitVSquared(seg));
+  _pathVel += _pathAccel;
+  if(_pathVel >= seg->maxVel){
+    _pathAccel = fpRate_t();
+    _pathVel = seg->maxVel;
+  } else if(_pathVel <= -seg->maxVel){
+    _pathAccel = fpRate_t();
+    _pathVel = -seg->maxVel;
+  }
+  fpPos_t _travel = _pathVel.as<fpPos_t>();
+  while(true){
+    fpPos_t _left = seg->length - _pathPos;
+    if(_travel < _left){
+      _pathPos += _travel;
+      _delta += fp_mulWide(seg->ratio, _travel.as<fpRate_t>()).as<fpPos_t>();
+      break;
+    }
+    // we get to this one's end: land on it exactly, that's only off by rounding in the ratio, 
+    // unless the position was set under us, in which case we only move as far as the path does 
+    fpPos_t _share = fp_mulWide(seg->ratio, _left.as<fpRate_t>()).as<fpPos_t>();
+    fpPos_t _toEnd = seg->end - _pos;
+    _delta = ((_toEnd - _delta - _share).magnitude() < fpPos_t::fromInt(1)) ? _toEnd : _delta + _share;
+    _travel -= _left;
+    _pathPos = fpPos_t();
+    _tail = (_tail + 1) & MOTION_QUEUE_MASK;
+    // and stop there, if that's the plan, or there's nothing after it, 
+    if(motion_exitVSquared(seg).isZero() || _tail == _head){
+      _pathVel = fpRate_t();
+      _pathAccel = fpRate_t();
+      if(_tail != _head) seg = &queue[_tail];
+      break;
+    }
+    seg = &queue[_tail];
+  }
+  queueTail = _tail;
+  pathPos = _pathPos;
+  pathVel = _pathVel;
+  if(_tail == _head){
+    _vel = fpRate_t();
+    _accel = fpRate_t();
+    _dist = fpPos_t();
+    return _delta;
+  }
+  // our share of the path's rates, which (at corners) steps from one segment's to the next, 
+  _vel = fp_mulWide(seg->ratio, _pathVel).as<fpRate_t>();
+  _accel = fp_mulWide(seg->ratio, _pathAccel).as<fpRate_t>();
+  _dist = seg->end - (_pos + _delta);
+  _maxVel = seg->axisMaxVel;
+  _maxAccel = seg->axisMaxAccel;
+  maxVel = _maxVel;
+  maxAccel = _maxAccel;
+  posTarget = seg->end;
+  return _delta;
+}
+
+void motion_integrate(void){
+  motion_applyCommands(motion_getTime());
+  // the limit switch: its edges arrive between ticks, when our position is what it was at the end of the last one, 
+  boolean _limit = false;
+  uint32_t _edges = limitEdges;
+  if(_edges != limitEdgesSeen){
+    limitEdgesSeen = _edges;
+    limitPos = pos;
+    _limit = true;
+  }
+  uint8_t _mode = mode;
+  if(_mode == MOTION_MODE_HOME){
+    if(_limit) motion_pushEvent(MOTION_EVENT_LIMIT, 0, limitPos, vel);
+    fpPos_t _homePos = pos;
+    _mode = motion_homeStep(_homePos, _limit);
+    pos = _homePos;
+  } else if(_limit && limitStop){
+    // stop dead, and drop whatever we were doing, 
+    motion_pushEvent(MOTION_EVENT_LIMIT, 1, limitPos, vel);
+    vel = fpRate_t();
+    velTarget = fpRate_t();
+    mode = _mode = MOTION_MODE_VEL;
+    queueTail = queueHead;
+    limitStops = limitStops + 1;
+    arrivalPending = true;
+  } else if(_limit){
+    motion_pushEvent(MOTION_EVENT_LIMIT, 0, limitPos, vel);
+  }
+  // we work on local copies of the state, and write them back at the end: 
+  // each touch of a volatile is a load or a store, 
+  fpPos_t _pos = pos;
+  fpRate_t _vel = vel;
+  fpRate_t _accel = accel;
+  fpRate_t _maxVel = maxVel;
+  fpRate_t _maxAccel = maxAccel;
+  fpPos_t _dist;
+  // do we dead-reckon onto the target at the end of this tick ?
+  boolean _clip = false;
+  // or has the queue done it all already ? 
+  boolean _pathed = false;
+  fpPos_t _delta;
+  // set our accel based on modal requests, 
+  switch(_mode){
+    case MOTION_MODE_POS:
+      // how far to go ? 
+      _dist = fpPos_t(posTarget) - _pos;
+      // since we dead-reckon targets at the end, we should have this case:
+      if(_dist.isZero()){
+        _vel = fpRate_t();
+        _accel = fpRate_t();
+        break;
+      }
+      _accel = motion_when2Decel(_dist, _vel, _maxAccel, fpStopCalc_t());
+      _clip = true;
+      break;
+    case MOTION_MODE_QUEUE:
+      // (this one integrates itself, see above) 
+      _delta = motion_queueStep(_pos, _vel, _accel, _dist, _maxVel, _maxAccel);
+      _pathed = true;
+      break;
+    case MOTION_MODE_SCURVE:
+      _dist = fpPos_t(posTarget) - _pos;
+      if(_dist.isZero()){
+        _vel = fpRate_t();
+        _accel = fpRate_t();
+        accelNorm = fpRate_t();
+        scurveBraking = false;
+        break;
+      }
+      _accel = motion_scurveAccel(_dist, _vel, _maxVel, _maxAccel);
+      _clip = true;
+      break;
+    case MOTION_MODE_VEL:
+      // within one tick's worth of accel, land exactly on the target rate, 
+      // otherwise we dither +/- maxAccel around it forever 
+      fpRate_t _velTarget = velTarget;
+      if(_vel < _velTarget - _maxAccel){
+        _accel = _maxAccel; 
+      } else if (_vel > _velTarget + _maxAccel){
+        _accel = -_maxAccel;
+      } else {
+        _accel = fpRate_t();
+        _vel = _velTarget;
+      }
+      break;
+  } // end mode-switch / accel settings, 
+  if(!_pathed){
+    // using our chosen accel, integrate velocity from previous: 
+    // given that our rates are expressed in units-per-integration step, 
+    // there's no multiply here, just += ... 
+    _vel += _accel;
+    // cap our vel based on maximum rates: 
+    if(_vel >= _maxVel){
+      _accel = fpRate_t();
+      _vel = _maxVel;
+      if(_mode == MOTION_MODE_SCURVE && accelNorm.isPositive()) accelNorm = fpRate_t();
+    } else if(_vel <= -_maxVel){
+      _accel = fpRate_t();
+      _vel = -_maxVel;
+      if(_mode == MOTION_MODE_SCURVE && accelNorm.isNegative()) accelNorm = fpRate_t();
+    }
+    // what's a position delta ? 
+    _delta = _vel.as<fpPos_t>(); 
+    // if the next step is going to hit the targ, make exactly that delta... 
+    if(_clip){
+      if(_delta > _dist && _dist.isPositive()){
+        _delta = _dist;
+      } else if (_delta < _dist && _dist.isNegative()){
+        _delta = _dist;
+      }
+    }
+  }
+  // I think we can smash these together (?) 
+  pos = _pos + _delta;
+  vel = _vel;
+  accel = _accel;
+  distanceToTarget = _dist;
+  // and check the step modulo as well: 
+  // (the delta is never more than one step, so it fits in a rate) 
+  fpRate_t _stepModulo = stepModulo;
+  _stepModulo += _delta.as<fpRate_t>();
+  if(_stepModulo >= fpRate_t::fromInt(1)){
+    stepper_step(true);
+    _stepModulo -= fpRate_t::fromInt(1);
+  } else if (_stepModulo <= fpRate_t::fromInt(-1)){
+    stepper_step(false);
+    _stepModulo += fpRate_t::fromInt(1);
+  }
+  stepModulo = _stepModulo;
+  // did we get there ? (homing's own moves don't count, only where it leaves us) 
+  if(arrivalPending && mode != MOTION_MODE_HOME && _accel.isZero()){
+    if(_mode == MOTION_MODE_VEL){
+      // (that's on the target, or capped at maxVel short of it) 
+      motion_pushEvent(MOTION_EVENT_VELOCITY_REACHED, 0, _pos + _delta, _vel);
+      arrivalPending = false;
+    } else if(_vel.isZero() && _dist.isZero() && (_mode != MOTION_MODE_QUEUE || queueTail == queueHead)){
+      // (in the queue, an axis that sits still for a segment is waiting its turn, not there yet) 
+      motion_pushEvent(MOTION_EVENT_TARGET_REACHED, 0, _pos + _delta, _vel);
+      arrivalPending = false;
+    }
+  }
+  // publish, for motion_getCurrentStates(), 
+  snapshotSeq = snapshotSeq + 1;
+  MOTION_BARRIER();
+  snapshot.pos = _pos + _delta;
+  snapshot.vel = _vel;
+  snapshot.accel = _accel;
+  snapshot.distanceToTarget = _dist;
+  snapshot.maxVel = _maxVel;
+  snapshot.maxAccel = _maxAccel;
+  snapshot.twoDA = twoDA;
+  snapshot.vSquared = vSquared;
+  snapshot.homePhase = homePhase;
+  snapshot.limitCount = limitEdgesSeen;
+  snapshot.limitPos = limitPos;
+  MOTION_BARRIER();
+  snapshotSeq = snapshotSeq + 1;
+  // and sample, every so often, 
+  uint16_t _decimation = telemetryDecimation;
+  if(_decimation != 0){
+    // (if the decimation just came down, don't wait out the old one) 
+    if(telemetryCountdown == 0 || telemetryCountdown > _decimation){
+      telemetryCountdown = _decimation;
+      uint8_t _head = telemetryHead;
+      uint8_t _next = (_head + 1) & MOTION_TELEMETRY_MASK;
+      // if nobody is draining, we drop samples, but still count them, 
+      if(_next != telemetryTail){
+        telemetry[_head].sampleNum = telemetrySampleNum;
+        telemetry[_head].pos = _pos + _delta;
+        telemetry[_head].vel = _vel;
+        telemetry[_head].accel = _accel;
+        MOTION_BARRIER();
+        telemetryHead = _next;
+      }
+      telemetrySampleNum ++;
+    }
+    telemetryCountdown --;
+  }
+} // end integrator 
+
+// claims the next command slot, or NULL if the ring is full: a timed command can sit at the tail for up to 100ms, 
+// so we don't wait on it here, callers hand that back up (endpoints as EP_ONDATA_WAIT) 
+static motionCommand_t* motion_claimCommand(void){
+  if(((commandHead + 1) & MOTION_COMMAND_MASK) == commandTail) return NULL;
+  return &commands[commandHead];
+}
+
+static void motion_postCommand(void){
+  MOTION_BARRIER();
+  commandHead = (commandHead + 1) & MOTION_COMMAND_MASK;
+}
+
+uint8_t motion_getCommandSpace(void){
+  return (uint8_t)(commandTail - commandHead - 1) & MOTION_COMMAND_MASK;
+}
+
+// a command's "execute at" time, w/ far-off (or past) times going out right away, 
+static void motion_setCommandTime(motionCommand_t* cmd, boolean _timed, uint32_t _executeAt){
+  cmd->timed = false;
+  if(!_timed) return;
+  uint32_t _wait = _executeAt - motion_getTime();
+  if((int32_t)_wait > 0 && _wait <= MOTION_SCHEDULE_MAX_US){
+    cmd->timed = true;
+    cmd->executeAt = _executeAt;
+  }
+}
+
+static boolean motion_postPositionTarget(float _targ, float _maxVel, float _maxAccel, boolean _timed, uint32_t _executeAt){
+  // first, elevate from units-per-sec to units-per-integration-step, and convert, 
+  motionCommand_t* cmd = motion_claimCommand();
+  if(cmd == NULL) return false;
+  cmd->type = MOTION_COMMAND_POS_TARGET;
+  cmd->maxVel = motion_velFromUser(_maxVel);
+  cmd->maxAccel = motion_accelFromUser(_maxAccel);
+  cmd->pos = fpPos_t::fromFloat(_targ);
+  // this drops any queued segments, 
+  cmd->flushTo = queueHead;
+  motion_setCommandTime(cmd, _timed, _executeAt);
+  segmentEndKnown = false;
+  motion_postCommand();
+  return true;
+}
+
+static boolean motion_postVelocityTarget(float _targ, float _maxAccel, boolean _timed, uint32_t _executeAt){
+  motionCommand_t* cmd = motion_claimCommand();
+  if(cmd == NULL) return false;
+  cmd->type = MOTION_COMMAND_VEL_TARGET;
+  cmd->maxAccel = motion_accelFromUser(_maxAccel);
+  cmd->vel = motion_velFromUser(_targ);
+  cmd->flushTo = queueHead;
+  motion_setCommandTime(cmd, _timed, _executeAt);
+  segmentEndKnown = false;
+  motion_postCommand();
+  return true;
+}
+
+static boolean motion_postSCurveTarget(float _targ, float _maxVel, float _maxAccel, float _maxJerk, boolean _timed, uint32_t _executeAt){
+  // no jerk limit is a plain trapezoid, (so that group frames can mix the two) 
+  if(!(_maxJerk > 0.0F)){
+    return motion_postPositionTarget(_targ, _maxVel, _maxAccel, _timed, _executeAt);
+  }
+  // the limits, all in units-per-integration-step, 
+  float _a = motion_accelFromUser(_maxAccel).toFloat();
+  if(_a < jerkMinAccel.toFloat()) _a = jerkMinAccel.toFloat();
+  float _jerk = fabsf(_maxJerk) * delT * delT * delT;
+  float _norm = _jerk / _a;
+  if(_norm < jerkMinNorm.toFloat()) _norm = jerkMinNorm.toFloat();
+  if(_norm > 1.0F) _norm = 1.0F;
+  _jerk = _norm * _a;
+  // a ramp's velocity change is A^2 / J, and if that's more than we can ever change by, we'd never reach A: 
+  // so we bring A down to where we would (the profiles are the same) 
+  float _rampVel = _a / _norm;
+  if(_rampVel > jerkMaxRampVel.toFloat()){
+    _a = sqrtf(jerkMaxRampVel.toFloat() * _jerk);
+    _norm = _jerk / _a;
+    _rampVel = jerkMaxRampVel.toFloat();
+  }
+  motionCommand_t* cmd = motion_claimCommand();
+  if(cmd == NULL) return false;
+  cmd->type = MOTION_COMMAND_SCURVE_TARGET;
+  cmd->maxVel = motion_velFromUser(_maxVel);
+  cmd->maxAccel = fpRate_t::fromFloat(_a);
+  cmd->jerkNorm = fpRate_t::fromFloat(_norm);
+  cmd->rampVel = fpJerkCalc_t::fromFloat(_rampVel);
+  cmd->rampVelSqThird = fpJerkCalc_t::fromFloat(_rampVel * _rampVel / 3.0F);
+  cmd->pos = fpPos_t::fromFloat(_targ);
+  cmd->flushTo = queueHead;
+  motion_setCommandTime(cmd, _timed, _executeAt);
+  segmentEndKnown = false;
+  motion_postCommand();
+  return true;
+}
+
+boolean motion_setPositionTarget(float _targ, float _maxVel, float _maxAccel){
+  return motion_postPositionTarget(_targ, _maxVel, _maxAccel, false, 0);
+}
+
+boolean motion_setVelocityTarget(float _targ, float _maxAccel){
+  return motion_postVelocityTarget(_targ, _maxAccel, false, 0);
+}
+
+boolean motion_setPositionTargetAt(float _targ, float _maxVel, float _maxAccel, uint32_t _executeAt){
+  return motion_postPositionTarget(_targ, _maxVel, _maxAccel, true, _executeAt);
+}
+
+boolean motion_setVelocityTargetAt(float _targ, float _maxAccel, uint32_t _executeAt){
+  return motion_postVelocityTarget(_targ, _maxAccel, true, _executeAt);
+}
+
+boolean motion_setPositionTargetJerk(float _targ, float _maxVel, float _maxAccel, float _maxJerk){
+  return motion_postSCurveTarget(_targ, _maxVel, _maxAccel, _maxJerk, false, 0);
+}
+
+boolean motion_setPositionTargetJerkAt(float _targ, float _maxVel, float _maxAccel, float _maxJerk, uint32_t _executeAt){
+  return motion_postSCurveTarget(_targ, _maxVel, _maxAccel, _maxJerk, true, _executeAt);
+}
+
+// copies the integrator's latest snapshot, retrying if a tick lands while we're at it, 
+static void motion_readSnapshot(motionSnapshot_t* dest){
+  uint32_t seq;
+  do {
+    seq = snapshotSeq;
+    MOTION_BARRIER();
+    *dest = snapshot;
+    MOTION_BARRIER();
+  } while((seq & 1) || seq != snapshotSeq);
+}
+
+// backwards pass over the queue: each junction is as fast as both segments allow, and as the junction itself allows 
+// (zero if a lone axis reverses, or whatever the host planned for a path's corner), 
+// but no faster than we could still slow from, in time for the junctions after it... 
+// the last segment in the queue always ends at rest, since we don't know what comes next 
+// this is float maths, but it runs when segments arrive, not in the integrator 
+// it's all in path units, so that every axis on the same path comes up w/ the same plan 
+void motion_planQueue(void){
+  // (these are single bytes, so we can read them without a critical section) 
+  uint8_t tail = queueTail;
+  uint8_t head = queueHead;
+  if(tail == head) return;
+  fpStopCalc_t exitVSquareds[MOTION_QUEUE_SIZE];
+  uint8_t i = (head - 1) & MOTION_QUEUE_MASK;
+  float exitVel = 0.0F;
+  exitVSquareds[i] = fpStopCalc_t();
+  while(i != tail){
+    uint8_t prev = (i - 1) & MOTION_QUEUE_MASK;
+    float junctionVel = min(min(queue[prev].maxVel.toFloat(), queue[i].maxVel.toFloat()), queue[i].junctionMax);
+    // v_entry^2 = v_exit^2 + 2 * a * d 
+    float reachable = sqrtf(exitVel * exitVel + 2.0F * queue[i].maxAccel.toFloat() * queue[i].length.toFloat());
+    if(reachable < junctionVel) junctionVel = reachable;
+    // squared in the same format as the integrator's vSquared, so that they compare like-for-like, 
+    fpStopVel_t junctionFixed = fpRate_t::fromFloat(junctionVel).as<fpStopVel_t>();
+    exitVSquareds[prev] = fp_mulWide(junctionFixed, junctionFixed);
+    exitVel = junctionVel;
+    i = prev;
+  }
+  // the integrator reads these as it goes, and they're 64 bits wide, so we can't just write over them: 
+  // we fill the spare slot, and hand it over w/ a single byte, the same as the rings do w/ their heads, 
+  // and only where the plan has changed: that's mostly just the one junction at the end 
+  for(i = tail; i != head; i = (i + 1) & MOTION_QUEUE_MASK){
+    motionSegment_t* seg = &queue[i];
+    uint8_t _slot = seg->exitSlot;
+    if(seg->exitVSquared[_slot] == exitVSquareds[i]) continue;
+    seg->exitVSquared[_slot ^ 1] = exitVSquareds[i];
+    MOTION_BARRIER();
+    seg->exitSlot = _slot ^ 1;
+  }
+}
+
+// lone segments (w/ no path length) are this axis' own moves, 
+// the rest are our share of a path that a few axes run together, see motion_addPathSegment() 
+static boolean motion_queueSegment(float _end, float _length, float _maxVel, float _maxAccel, float _junctionVel){
+  if(motion_getQueueSpace() == 0) return false;
+  // same conversions as a position target, 
+  fpRate_t _mvCand = motion_velFromUser(_maxVel);
+  fpRate_t _maCand = motion_accelFromUser(_maxAccel);
+  fpPos_t _endFixed = fpPos_t::fromFloat(_end);
+  // segments start where the last one ends (the integrator lands exactly there, even if it's done already), 
+  // or from wherever we are now, 
+  fpPos_t _start;
+  // if a limit stopped us, the integrator dropped the queue, and left queue mode, 
+  uint32_t _stops = limitStops;
+  if(_stops != segmentLimitStops){
+    segmentLimitStops = _stops;
+    segmentEndKnown = false;
+  }
+  // the first one also needs a command slot, to swap the integrator into the queue, 
+  if(!segmentEndKnown && motion_getCommandSpace() == 0) return false;
+  if(segmentEndKnown){
+    _start = segmentEnd;
+  } else {
+    motionSnapshot_t _snap;
+    motion_readSnapshot(&_snap);
+    _start = _snap.pos;
+  }
+  fpPos_t _travel = _endFixed - _start;
+  float _ratio = 0.0F;
+  boolean _lone = !(_length > 0.0F);
+  if(!_lone){
+    _ratio = _travel.toFloat() / _length;
+    // (past the ratio's range, we can't keep up w/ the path anyways, so we make our own way there) 
+    if(fabsf(_ratio) >= fpRatio_t::max().toFloat()) _lone = true;
+  }
+  // a lone axis' zero-length segments would only be popped straight away, 
+  // but on a path, we sit still for the segment, so that we start the next one w/ the others 
+  if(_lone && _travel.isZero()) return true;
+  motionSegment_t* seg = &queue[queueHead];
+  // (if the queue is empty, this one is stale, but then the junction is never planned) 
+  motionSegment_t* prev = &queue[(queueHead - 1) & MOTION_QUEUE_MASK];
+  seg->start = _start;
+  seg->end = _endFixed;
+  seg->lone = _lone;
+  if(_lone){
+    seg->length = _travel.magnitude();
+    seg->ratio = _travel.isPositive() ? fpRatio_t::fromInt(1) : fpRatio_t::fromInt(-1);
+    // we carry on thru junctions in the same direction, and stop to reverse, 
+    seg->junctionMax = (prev->lone && prev->ratio.isPositive() == seg->ratio.isPositive()) ? _mvCand.toFloat() : 0.0F;
+  } else {
+    seg->length = fpPos_t::fromFloat(_length);
+    seg->ratio = fpRatio_t::fromFloat(_ratio);
+    // our share of the path's rate has to be one we can step at, 
+    if(_mvCand.toFloat() * fabsf(_ratio) > absMaxRate.toFloat()) _mvCand = fpRate_t::fromFloat(absMaxRate.toFloat() / fabsf(_ratio));
+    // and paths' units aren't ours, so we can't carry speed between those and our own moves 
+    seg->junctionMax = prev->lone ? 0.0F : motion_velFromUser(_junctionVel).toFloat();
+  }
+  seg->maxVel = _mvCand;
+  seg->maxAccel = _maCand;
+  // and our share of its rates, for state queries (a lone axis' are its own) 
+  float _share = fabsf(seg->ratio.toFloat());
+  seg->axisMaxVel = _lone ? _mvCand : fpRate_t::fromFloat(min(_share * _mvCand.toFloat(), absMaxRate.toFloat()));
+  seg->axisMaxAccel = _lone ? _maCand : fpRate_t::fromFloat(min(_share * _maCand.toFloat(), absMaxRate.toFloat()));
+  seg->exitVSquared[0] = fpStopCalc_t();
+  seg->exitSlot = 0;
+  MOTION_BARRIER();
+  queueHead = (queueHead + 1) & MOTION_QUEUE_MASK;
+  // and swap modes, if we're not already in the queue (or on our way there), 
+  if(!segmentEndKnown){
+    motionCommand_t* cmd = motion_claimCommand();
+    cmd->type = MOTION_COMMAND_QUEUE;
+    cmd->timed = false;
+    motion_postCommand();
+  }
+  segmentEnd = _endFixed;
+  segmentEndKnown = true;
+  motion_planQueue();
+  return true;
+}
+
+boolean motion_addSegment(float _end, float _maxVel, float _maxAccel){
+  return motion_queueSegment(_end, 0.0F, _maxVel, _maxAccel, 0.0F);
+}
+
+boolean motion_addPathSegment(float _end, float _length, float _maxVel, float _maxAccel, float _junctionVel){
+  return motion_queueSegment(_end, _length, _maxVel, _maxAccel, _junctionVel);
+}
+
+uint8_t motion_getQueueSpace(void){
+  // one slot is always empty, so that head == tail means "empty" 
+  return (uint8_t)(queueTail - queueHead - 1) & MOTION_QUEUE_MASK;
+}
+
+boolean motion_setPosition(float _pos){
+  // not too introspective here,
+  motionCommand_t* cmd = motion_claimCommand();
+  if(cmd == NULL) return false;
+  cmd->type = MOTION_COMMAND_SET_POSITION;
+  cmd->pos = fpPos_t::fromFloat(_pos);
+  cmd->timed = false;
+  segmentEndKnown = false;
+  motion_postCommand();
+  return true;
+}
+
+void motion_limitTrigger(void){
+  limitEdges = limitEdges + 1;
+}
+
+void motion_setLimitStop(boolean _stop){
+  limitStop = _stop;
+}
+
+boolean motion_home(float _seekVel, float _latchVel, float _maxAccel, float _backoff, float _maxTravel){
+  motionCommand_t* cmd = motion_claimCommand();
+  if(cmd == NULL) return false;
+  cmd->type = MOTION_COMMAND_HOME;
+  cmd->vel = motion_velFromUser(_seekVel);
+  // the approach goes the same way as the seek, and the backoff the other, 
+  cmd->latchVel = motion_velFromUser(fabsf(_latchVel));
+  cmd->pos = fpPos_t::fromFloat(fabsf(_backoff));
+  if(cmd->vel.isPositive()){
+    cmd->pos = -cmd->pos;
+  } else {
+    cmd->latchVel = -cmd->latchVel;
+  }
+  cmd->maxAccel = motion_accelFromUser(_maxAccel);
+  cmd->maxTravel = fpPos_t::fromFloat(fabsf(_maxTravel));
+  cmd->flushTo = queueHead;
+  cmd->timed = false;
+  segmentEndKnown = false;
+  motion_postCommand();
+  return true;
+}
+
+void motion_getLimitState(motionLimitState_t* dest){
+  motionSnapshot_t _snap;
+  motion_readSnapshot(&_snap);
+  dest->homePhase = _snap.homePhase;
+  dest->limitCount = _snap.limitCount;
+  dest->limitPos = _snap.limitPos.toFloat();
+}
+
+void motion_getCurrentStates(motionState_t* statePtr){
+  motionSnapshot_t _snap;
+  motion_readSnapshot(&_snap);
+  // back to units-per-second, and units-per-second^2, all outside of any critical section 
+  statePtr->pos = _snap.pos.toFloat();
+  statePtr->vel = _snap.vel.toFloat() / delT;
+  statePtr->accel = _snap.accel.toFloat() / (delT * delT);
+  statePtr->distanceToTarget = _snap.distanceToTarget.toFloat();
+  statePtr->maxVel = _snap.maxVel.toFloat() / delT;
+  statePtr->maxAccel = _snap.maxAccel.toFloat() / (delT * delT);
+  statePtr->twoDA = _snap.twoDA.toFloat();
+  statePtr->vSquared = _snap.vSquared.toFloat();
+}
+
+void motion_syncClock(uint32_t _hostTime, uint32_t _deviceTime){
+  if(clockSynced){
+    int32_t _dHost = (int32_t)(_hostTime - syncHostRef);
+    int32_t _dDevice = (int32_t)(_deviceTime - syncDeviceRef);
+    // out of order, or too close to the last one to say much about rates, so we only move the offset, 
+    if(_dHost < MOTION_SYNC_RATE_MIN_INTERVAL){
+      if(_dHost <= 0) return;
+    } else {
+      float _rate = (float)_dDevice / (float)_dHost;
+      // crystals and the USB-recovered DFLL are good to well under a percent, past that it's a bad sample 
+      if(_rate > 0.99F && _rate < 1.01F){
+        syncRate = syncRateKnown ? 0.5F * syncRate + 0.5F * _rate : _rate;
+        syncRateKnown = true;
+      }
+    }
+  }
+  syncHostRef = _hostTime;
+  syncDeviceRef = _deviceTime;
+  clockSynced = true;
+}
+
+boolean motion_hostToDeviceTime(uint32_t _hostTime, uint32_t* _deviceTime){
+  if(!clockSynced) return false;
+  int32_t _dHost = (int32_t)(_hostTime - syncHostRef);
+  *_deviceTime = syncDeviceRef + (int32_t)((float)_dHost * syncRate);
+  return true;
+}
+
+void motion_getTiming(motionTiming_t* dest){
+  motionTimingStat_t _cost;
+  motionTimingStat_t _interval;
+  uint32_t seq;
+  do {
+    seq = timingSeq;
+    MOTION_BARRIER();
+    _cost = timingCost;
+    _interval = timingInterval;
+    MOTION_BARRIER();
+  } while((seq & 1) || seq != timingSeq);
+  dest->cpuHz = F_CPU;
+  dest->tickCycles = delT_us * MOTION_CYCLES_PER_US;
+  dest->count = _cost.count;
+  dest->costMin = _cost.min;
+  dest->costMax = _cost.max;
+  dest->costMean = _cost.count ? (float)_cost.sum / (float)_cost.count : 0.0F;
+  dest->intervalMin = _interval.min;
+  dest->intervalMax = _interval.max;
+  dest->intervalMean = _interval.count ? (float)_interval.sum / (float)_interval.count : 0.0F;
+  for(uint8_t b = 0; b < MOTION_TIMING_BINS; b ++){
+    dest->costHist[b] = _cost.hist[b];
+    dest->intervalHist[b] = _interval.hist[b];
+  }
+}
+
+void motion_resetTiming(void){
+  timingResetRequested = true;
+}
+
+void motion_printDebug(void){
+  // we should check if these worked, 
+}
+
+void motion_setTelemetryDecimation(uint16_t ticksPerSample){
+  // one write, the integrator sorts out its countdown, 
+  telemetryDecimation = ticksPerSample;
+}
+
+uint8_t motion_getTelemetryCount(void){
+  return (uint8_t)(telemetryHead - telemetryTail) & MOTION_TELEMETRY_MASK;
+}
+
+boolean motion_getEvent(motionEvent_t* dest){
+  uint8_t _tail = eventTail;
+  if(_tail == eventHead) return false;
+  motionEventSlot_t* slot = &events[_tail];
+  dest->eventNum = slot->eventNum;
+  dest->type = slot->type;
+  dest->code = slot->code;
+  dest->pos = slot->pos.toFloat();
+  dest->vel = slot->vel.toFloat() / delT;
+  MOTION_BARRIER();
+  eventTail = (_tail + 1) & MOTION_EVENT_MASK;
+  return true;
+}
+
+uint32_t motion_getEventCount(void){
+  return eventNum;
+}
+
+uint8_t motion_drainTelemetry(motionSample_t* dest, uint8_t maxCount){
+  // the ISR only ever moves the head, so what's behind it is ours to read, 
+  uint8_t _head = telemetryHead;
+  uint8_t _tail = telemetryTail;
+  uint8_t count = 0;
+  while(_tail != _head && count < maxCount){
+    motionTelemetrySlot_t* slot = &telemetry[_tail];
+    // frames are contiguous, so a gap starts the next one, 
+    if(count > 0 && slot->sampleNum != dest[0].sampleNum + count) break;
+    dest[count].sampleNum = slot->sampleNum;
+    dest[count].pos = slot->pos.toFloat();
+    dest[count].vel = slot->vel.toFloat() / delT;
+    dest[count].accel = slot->accel.toFloat() / (delT * delT);
+    count ++;
+    _tail = (_tail + 1) & MOTION_TELEMETRY_MASK;
+  }
+  // our reads of those slots must be done before we hand them back, 
+  MOTION_BARRIER();
+  telemetryTail = _tail;
+  return count;
+}
@@ -0,0 +1,177 @@
+// ---------------------------------------------- Application State 
+#ifndef MOTION_STATE_MACHINE_H_
+#define MOTION_STATE_MACHINE_H_
+
+#include <Arduino.h>
+#include "fixedPoint.h"
+
+#define MOTION_MODE_POS 0
+#define MOTION_MODE_VEL 1 
+#define MOTION_MODE_QUEUE 2
+#define MOTION_MODE_HOME 3
+#define MOTION_MODE_SCURVE 4
+
+// how many segments we can hold for sequential motion, must be a power of two 
+#define MOTION_QUEUE_SIZE 32
+
+// we're going to use `2.30` *and* `34.30` fixed points, 
+// rates (units-per-integration-step) are the short ones, positions the long ones 
+typedef Fixed<2, 30> fpRate_t;
+typedef Fixed<34, 30> fpPos_t;
+
+// telemetry samples are taken in the integrator, and drained from the loop, 
+// the ring must be a power of two, and we send a few samples per packet 
+#define MOTION_TELEMETRY_SIZE 64
+#define MOTION_TELEMETRY_BATCH 6
+
+typedef struct motionSample_t {
+  uint32_t sampleNum;   // counts every sample taken, so gaps (dropped samples) are visible 
+  float pos;
+  float vel;
+  float accel;
+} motionSample_t;
+
+// the ISR times itself, in cpu cycles: how long each tick takes (entry to exit), and how long between ticks, 
+// histogram bins for cost are eighths of the tick period (the last one includes overruns), 
+// and for intervals they're 1us wide, centered on the nominal period: bin 4 is [0, +1us) late, bin 0 is 3us+ early, bin 7 3us+ late 
+#define MOTION_TIMING_BINS 8
+
+typedef struct motionTiming_t {
+  uint32_t cpuHz;           // cycles per second, to convert the below, 
+  uint32_t tickCycles;      // the nominal tick period, i.e. our budget 
+  uint32_t count;           // ticks since the last reset, 
+  uint32_t costMin;
+  uint32_t costMax;
+  float costMean;
+  uint32_t costHist[MOTION_TIMING_BINS];
+  uint32_t intervalMin;
+  uint32_t intervalMax;
+  float intervalMean;
+  uint32_t intervalHist[MOTION_TIMING_BINS];
+} motionTiming_t;
+
+// struct for a handoff, 
+typedef struct motionState_t {
+  float pos;
+  float vel;
+  float accel;
+  float distanceToTarget;
+  float maxVel;
+  float maxAccel;
+  float twoDA;
+  float vSquared;
+} motionState_t;
+
+void motion_init(int32_t microsecondsPerIntegration);
+
+void motion_integrate(void);
+#if defined(ARDUINO_ARCH_RP2040)
+void alarm_dt_Handler(void);
+#endif
+
+// the integrator calls this once per whole step (in position units, i.e. one microstep), it's provided by each board's stepper driver 
+void stepper_step(boolean dir);
+
+boolean motion_setPositionTarget(float _targ, float _maxVel, float _maxAccel);
+boolean motion_setVelocityTarget(float _targ, float _maxAccel);
+boolean motion_setPosition(float _pos);
+
+// device time, in microseconds, the clock that timed commands are scheduled against, 
+uint32_t motion_getTime(void);
+// the same as the above, but they wait (in the integrator) 'till this device time, 
+// so that boards w/ sync'd clocks can start together, times more than 100ms out (or past) go right away 
+boolean motion_setPositionTargetAt(float _targ, float _maxVel, float _maxAccel, uint32_t _executeAt);
+boolean motion_setVelocityTargetAt(float _targ, float _maxAccel, uint32_t _executeAt);
+// position targets w/ a jerk limit (units / sec^3), so accel ramps rather than steps: an s-curve, 
+// accels under ~ 0.26 units / sec^2 (at 10kHz) are raised to that, and ramps are never longer than 2^16 ticks, 
+// a jerk of zero (or less) is the plain trapezoid 
+boolean motion_setPositionTargetJerk(float _targ, float _maxVel, float _maxAccel, float _maxJerk);
+boolean motion_setPositionTargetJerkAt(float _targ, float _maxVel, float _maxAccel, float _maxJerk, uint32_t _executeAt);
+// targets (and the rest of the setters) are handed to the integrator thru a small queue (a power of two, w/ one slot always empty), 
+// this is how much room is left, so it's MOTION_COMMAND_SIZE - 1 when the integrator has applied everything: 
+// the setters take one slot each, and return false (w/o doing anything) if there isn't one, they never wait for it, 
+// so endpoints should check this first, and hand back EP_ONDATA_WAIT 
+#define MOTION_COMMAND_SIZE 4
+uint8_t motion_getCommandSpace(void);
+
+// the host tells us what time it was on its clock when ours read _deviceTime, 
+void motion_syncClock(uint32_t _hostTime, uint32_t _deviceTime);
+// returns false if we've never been sync'd, 
+boolean motion_hostToDeviceTime(uint32_t _hostTime, uint32_t* _deviceTime);
+
+// queues a move to _end, which we leave at speed if the next one lets us (same direction), returns false if the queue is full 
+// (or if it's the first one, and there's no command slot to swap into the queue w/) 
+boolean motion_addSegment(float _end, float _maxVel, float _maxAccel);
+// or our share of one line of a path, that a few axes run together: _length is the line's (in the path's units, whatever those are), 
+// and rates (and the fastest we can take the corner into it) are along that line, so every axis is handed the same numbers, 
+// and runs the same profile along it, moving (end - start) / _length for each unit of path... an axis that doesn't move on this line still waits it out 
+boolean motion_addPathSegment(float _end, float _length, float _maxVel, float _maxAccel, float _junctionVel);
+uint8_t motion_getQueueSpace(void);
+
+void motion_getCurrentStates(motionState_t* statePtr);
+
+// ---------------------------------------------- limit switch & homing 
+// the sketch calls this from its limit pin's interrupt (on the press edge), it only counts the edge, 
+// and the integrator latches its position on the next tick: steps only happen in ticks, so that's where we were 
+void motion_limitTrigger(void);
+// if set, a limit hit while we're not homing stops us dead (and drops any queued segments), it's off at startup 
+void motion_setLimitStop(boolean _stop);
+
+// seek toward the switch at seekVel (+ve or -ve, that's the direction), back off by backoff, 
+// and re-approach at latchVel: where the switch trips that time is our new zero, and we park backoff away from it, 
+// seek and approach each give up after maxTravel (then we stop, and the phase is FAILED) 
+// if the switch is already down, the sketch should call motion_limitTrigger() just after this 
+boolean motion_home(float _seekVel, float _latchVel, float _maxAccel, float _backoff, float _maxTravel);
+
+#define MOTION_HOME_IDLE 0        // never homed, or a target came in while we were at it, 
+#define MOTION_HOME_SEEK 1
+#define MOTION_HOME_BACKOFF 2
+#define MOTION_HOME_APPROACH 3
+#define MOTION_HOME_DONE 4
+#define MOTION_HOME_FAILED 5
+
+typedef struct motionLimitState_t {
+  uint8_t homePhase;
+  uint32_t limitCount;    // every press the integrator has seen, 
+  float limitPos;         // and where we were at the last one (in the coordinates of the time) 
+} motionLimitState_t;
+
+void motion_getLimitState(motionLimitState_t* dest);
+
+// sample every n'th integrator tick, 0 to turn it off, 
+void motion_setTelemetryDecimation(uint16_t ticksPerSample);
+uint8_t motion_getTelemetryCount(void);
+// copies up to maxCount samples out of the ring, stopping at any gap, returns how many, 
+uint8_t motion_drainTelemetry(motionSample_t* dest, uint8_t maxCount);
+
+// ---------------------------------------------- events 
+// the integrator notes when it gets where it was sent, (or hits something) so that nobody has to poll for it, 
+// they sit in a little ring 'till the loop ships them, and if nobody does, new ones are dropped (but still counted) 
+#define MOTION_EVENT_SIZE 8
+#define MOTION_EVENT_TARGET_REACHED 0   // at rest on a position target, or the end of the queue, 
+#define MOTION_EVENT_VELOCITY_REACHED 1 // on a velocity target (which may be zero), 
+#define MOTION_EVENT_LIMIT 2            // a limit switch press, code is 1 if it stopped us, 
+#define MOTION_EVENT_FAULT 3            // code is one of the below, 
+#define MOTION_FAULT_HOME_FAILED 0
+
+typedef struct motionEvent_t {
+  uint32_t eventNum;    // counts every event, so gaps (dropped events) are visible 
+  uint8_t type;
+  uint8_t code;
+  float pos;
+  float vel;
+} motionEvent_t;
+
+// pops the oldest, returns false if there isn't one, 
+boolean motion_getEvent(motionEvent_t* dest);
+// how many events there have been so far, i.e. the next one's eventNum: 
+// read after a target is applied, anything numbered from here on is about that target, not the one before 
+uint32_t motion_getEventCount(void);
+
+// copies out the ISR's timing stats, and starts them over (the ISR does that on its next tick) 
+void motion_getTiming(motionTiming_t* dest);
+void motion_resetTiming(void);
+
+void motion_printDebug(void);
+
+#endif 
\ No newline at end of file
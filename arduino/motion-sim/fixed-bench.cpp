@@ -0,0 +1,202 @@
+/*
+fixed-bench.cpp
+
+host micro-benchmark: the old fp_* helpers (copied here, from before fixedPoint.h) vs. the Fixed<> types,
+on the conversions, the multiply, and the when-to-decelerate check that the integrator runs each tick,
+errors are measured against double precision, and overflows are counted w/ 128-bit products
+
+this runs natively (x86-64 or whatever the host is), which is not a cortex-m0: ns/op are relative only,
+to approximate a 32-bit target, `make bench BENCH_ARCH=-m32` if the toolchain has multilib
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "fixedPoint.h"
+
+// ---------------------------------------------- the old helpers, verbatim-ish
+const int32_t fp_scale = 30;
+typedef int32_t fpint32_t;
+typedef int64_t fpint64_t;
+
+float fp_fixed32ToFloat(fpint32_t fixed){
+  return ((float)fixed / (float)(1 << fp_scale));
+}
+
+fpint32_t fp_floatToFixed32(float flt){
+  return (flt * (float)(1 << fp_scale));
+}
+
+fpint64_t fp_floatToFixed64(float flt){
+  return (flt * (float)(1 << fp_scale));
+}
+
+fpint32_t fp_mult32x32(fpint32_t a, fpint32_t b){
+  return ((int64_t)(a) * (int64_t)(b)) >> fp_scale;
+}
+
+#define FP_STOPCALC_REDUCE 4
+
+// the old ISR's comparison, true if we should decelerate
+bool old_when2Decel(fpint64_t dist, fpint32_t vel, fpint32_t maxAccel){
+  int64_t twoDA = ((abs(dist) << 1) >> FP_STOPCALC_REDUCE) * ((int64_t)(maxAccel) >> FP_STOPCALC_REDUCE);
+  int64_t vSquared = ((int64_t)(vel >> FP_STOPCALC_REDUCE) * (int64_t)(vel >> FP_STOPCALC_REDUCE));
+  return twoDA <= vSquared;
+}
+
+// ---------------------------------------------- and the new ones, as in motionStateMachine.cpp
+typedef Fixed<2, 30> fpRate_t;
+typedef Fixed<34, 30> fpPos_t;
+// (keep these in step w/ the integrator)
+typedef Fixed<12, 20> fpStopVel_t;
+typedef Fixed<4, 28> fpStopAccel_t;
+typedef Fixed<52, 12> fpStopDist_t;
+typedef Fixed<24, 40> fpStopCalc_t;
+
+constexpr fpStopDist_t stopCalcMaxDist = fpStopDist_t::fromInt(1 << 21);
+constexpr fpPos_t stopCalcDistRound = fpPos_t::fromRaw(((int64_t)1 << (fpPos_t::fracBits - fpStopDist_t::fracBits)) - 1);
+
+bool new_when2Decel(fpPos_t dist, fpRate_t vel, fpRate_t maxAccel){
+  fpStopDist_t absDist = (dist.magnitude() + stopCalcDistRound).as<fpStopDist_t>();
+  if(absDist > stopCalcMaxDist) absDist = stopCalcMaxDist;
+  fpStopCalc_t twoDA = fp_mulWide(absDist << 1, maxAccel.as<fpStopAccel_t>());
+  fpStopVel_t v = vel.as<fpStopVel_t>();
+  return twoDA <= fp_mulWide(v, v);
+}
+
+// ---------------------------------------------- inputs
+uint32_t lcgState = 1;
+float lcgRandom(void){
+  lcgState = lcgState * 1664525 + 1013904223;
+  return (float)(lcgState >> 8) / (float)(1 << 24);
+}
+
+#define BENCH_N 4096
+#define BENCH_REPS 2000
+
+// per-tick units, as the integrator sees them: rates in (-1, 1), accels in (0, 0.1], distances out to ~ 1M steps
+struct benchInput_t {
+  float rate;
+  float accel;
+  float dist;
+};
+
+std::vector<benchInput_t> inputs;
+
+// something for results to land in, so that the compiler can't skip the work
+volatile int64_t sink = 0;
+
+template <typename F>
+double timeIt(F fn){
+  auto start = std::chrono::steady_clock::now();
+  for(int r = 0; r < BENCH_REPS; r ++){
+    for(int i = 0; i < BENCH_N; i ++){
+      fn(inputs[i]);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / ((double)BENCH_N * BENCH_REPS);
+}
+
+void printRow(const char* name, double oldNs, double newNs, double oldErr, double newErr, uint32_t oldBad, uint32_t newBad){
+  printf("%-18s %10.2f %10.2f %12.3g %12.3g %10u %10u\n", name, oldNs, newNs, oldErr, newErr, oldBad, newBad);
+}
+
+int main(void){
+  for(int i = 0; i < BENCH_N; i ++){
+    benchInput_t in;
+    in.rate = (lcgRandom() - 0.5F) * 1.99F;
+    // log-distributed, so that small numbers get a look-in
+    in.accel = 0.1F * powf(2.0F, -20.0F * lcgRandom());
+    in.dist = (lcgRandom() - 0.5F) * 2.0F * powf(2.0F, 20.0F * lcgRandom());
+    inputs.push_back(in);
+  }
+
+  printf("%d inputs x %d reps, host-native timing\n", BENCH_N, BENCH_REPS);
+  printf("%-18s %10s %10s %12s %12s %10s %10s\n", "op", "old ns", "new ns", "old max err", "new max err", "old bad", "new bad");
+
+  // ------------------------------------ float -> fixed, rates
+  {
+    double oldNs = timeIt([](benchInput_t& in){ sink += fp_floatToFixed32(in.rate); });
+    double newNs = timeIt([](benchInput_t& in){ sink += fpRate_t::fromFloat(in.rate).raw; });
+    double oldErr = 0, newErr = 0;
+    for(auto& in : inputs){
+      oldErr = fmax(oldErr, fabs((double)fp_floatToFixed32(in.rate) / (double)(1 << 30) - in.rate));
+      newErr = fmax(newErr, fabs((double)fpRate_t::fromFloat(in.rate).raw / (double)(1 << 30) - in.rate));
+    }
+    printRow("floatToRate", oldNs, newNs, oldErr, newErr, 0, 0);
+  }
+
+  // ------------------------------------ float -> fixed, positions
+  // the old one goes thru a float * int product, which is fine in range: we check that it's equivalent
+  {
+    double oldNs = timeIt([](benchInput_t& in){ sink += fp_floatToFixed64(in.dist); });
+    double newNs = timeIt([](benchInput_t& in){ sink += fpPos_t::fromFloat(in.dist).raw; });
+    double oldErr = 0, newErr = 0;
+    for(auto& in : inputs){
+      oldErr = fmax(oldErr, fabs((double)fp_floatToFixed64(in.dist) / (double)(1 << 30) - in.dist));
+      newErr = fmax(newErr, fabs((double)fpPos_t::fromFloat(in.dist).raw / (double)(1 << 30) - in.dist));
+    }
+    printRow("floatToPos", oldNs, newNs, oldErr, newErr, 0, 0);
+  }
+
+  // ------------------------------------ fixed -> float
+  {
+    double oldNs = timeIt([](benchInput_t& in){ sink += (int64_t)(fp_fixed32ToFloat((fpint32_t)(in.rate * 1073741824.0F)) * 1e6F); });
+    double newNs = timeIt([](benchInput_t& in){ sink += (int64_t)(fpRate_t::fromRaw((int32_t)(in.rate * 1073741824.0F)).toFloat() * 1e6F); });
+    printRow("rateToFloat", oldNs, newNs, 0, 0, 0, 0);
+  }
+
+  // ------------------------------------ multiply, rate x rate
+  {
+    double oldNs = timeIt([](benchInput_t& in){ sink += fp_mult32x32(fp_floatToFixed32(in.rate), fp_floatToFixed32(in.accel)); });
+    double newNs = timeIt([](benchInput_t& in){ sink += fpRate_t::fromFloat(in.rate).mulSat(fpRate_t::fromFloat(in.accel)).raw; });
+    double oldErr = 0, newErr = 0;
+    for(auto& in : inputs){
+      double ref = (double)in.rate * (double)in.accel;
+      oldErr = fmax(oldErr, fabs((double)fp_mult32x32(fp_floatToFixed32(in.rate), fp_floatToFixed32(in.accel)) / (double)(1 << 30) - ref));
+      newErr = fmax(newErr, fabs((double)fpRate_t::fromFloat(in.rate).mulSat(fpRate_t::fromFloat(in.accel)).raw / (double)(1 << 30) - ref));
+    }
+    printRow("mult", oldNs, newNs, oldErr, newErr, 0, 0);
+  }
+
+  // ------------------------------------ the when-to-decelerate check
+  // "bad" is a decision that disagrees w/ double precision, when the two sides are more than one part in 1e3 apart,
+  // (closer than that, either answer is fine: it's the tick-to-tick dither about the switching point)
+  // overflows are products that don't fit in 64 bits, the old scheme's long-distance failure
+  {
+    double oldNs = timeIt([](benchInput_t& in){
+      sink += old_when2Decel(fp_floatToFixed64(in.dist), fp_floatToFixed32(in.rate), fp_floatToFixed32(in.accel));
+    });
+    double newNs = timeIt([](benchInput_t& in){
+      sink += new_when2Decel(fpPos_t::fromFloat(in.dist), fpRate_t::fromFloat(in.rate), fpRate_t::fromFloat(in.accel));
+    });
+    uint32_t oldBad = 0, newBad = 0, oldOverflows = 0;
+    for(auto& in : inputs){
+      double twoDA = 2.0 * fabs((double)in.dist) * (double)in.accel;
+      double vSquared = (double)in.rate * (double)in.rate;
+      if(fabs(twoDA - vSquared) < 1e-3 * fmax(twoDA, vSquared)) continue;
+      bool ref = twoDA <= vSquared;
+      fpint64_t oldDist = fp_floatToFixed64(in.dist);
+      __int128 oldProduct = (__int128)((abs(oldDist) << 1) >> FP_STOPCALC_REDUCE) * (__int128)(fp_floatToFixed32(in.accel) >> FP_STOPCALC_REDUCE);
+      if(oldProduct > INT64_MAX) oldOverflows ++;
+      if(old_when2Decel(oldDist, fp_floatToFixed32(in.rate), fp_floatToFixed32(in.accel)) != ref) oldBad ++;
+      if(new_when2Decel(fpPos_t::fromFloat(in.dist), fpRate_t::fromFloat(in.rate), fpRate_t::fromFloat(in.accel)) != ref) newBad ++;
+    }
+    printRow("when2Decel", oldNs, newNs, 0, 0, oldBad, newBad);
+    printf("old when2Decel overflowed on %u of %d inputs\n", oldOverflows, BENCH_N);
+  }
+
+  return 0;
+}
@@ -0,0 +1,820 @@
+/*
+motion-sim.cpp
+
+host-side simulation & benchmark for the motion state machine,
+compiles motion-core/src/motionStateMachine.cpp for either board's architecture
+against the stubs/ directory (in place of the arduino core and the stepper driver),
+then runs scripted target sequences through the integrator's ISR and reports
+ns-per-tick, steps emitted, final position error and overshoot
+
+build & run both boards with `make run`, see the Makefile
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "Arduino.h"
+#include "pico/stdlib.h"
+#include "hardware/structs/systick.h"
+#include "motionStateMachine.h"
+
+// the makefile tells us which board we are, and how to call its ISR:
+#ifndef SIM_BOARD
+#error "pls define SIM_BOARD, SIM_ISR and SIM_TICK_US, see the Makefile"
+#endif
+
+void SIM_ISR(void);
+
+// ---------------------------------------------- hardware stub instances
+uint32_t sim_criticalSections = 0;
+uint32_t sim_micros = 0;
+sim_port_t sim_PORT;
+sim_gclk_t sim_GCLK;
+sim_pm_t sim_PM;
+sim_tc_t sim_TC5;
+sim_timer_hw_t sim_timer_hw;
+sim_sio_hw_t sim_sio_hw;
+// the samd core runs SysTick at 1ms, the rp2040's is left off, for the motion core to start 
+sim_systick_t sim_SysTick = { 0, F_CPU / 1000 - 1, {} };
+sim_systick_hw_t sim_systick_hw = { 0, 0, {} };
+
+// ---------------------------------------------- the stepper driver, replaced
+// we only count steps here: one call is one whole step in position-units
+int64_t stepsForward = 0;
+int64_t stepsBackward = 0;
+
+void stepper_step(boolean dir){
+  if(dir){
+    stepsForward ++;
+  } else {
+    stepsBackward ++;
+  }
+}
+
+void stepper_init(void){}
+void stepper_setCScale(float scale){}
+
+// ---------------------------------------------- scripting
+// each command is held for some number of ticks, or until the integrator comes to rest
+#define CMD_POS 0
+#define CMD_VEL 1
+#define CMD_SEGMENT 2
+#define CMD_SCURVE 3
+#define HOLD_UNTIL_SETTLED 0
+#define HOLD_NONE 0xFFFFFFFF
+
+typedef struct simCommand_t {
+  uint8_t type;
+  float targ;
+  float maxVel;
+  float maxAccel;
+  uint32_t holdTicks;
+  float maxJerk;      // s-curves only, 
+} simCommand_t;
+
+// how long we'll wait for things to settle before calling it a failure, in seconds
+#define SETTLE_TIMEOUT 30.0F
+// how far off we'll allow final positions (and step counts) to be, in steps
+#define POS_TOLERANCE 0.5F
+
+// we want repeatable "random" sequences, so roll our own
+uint32_t lcgState = 1;
+float lcgRandom(void){
+  lcgState = lcgState * 1664525UL + 1013904223UL;
+  return (float)(lcgState >> 8) / (float)(1UL << 24);
+}
+
+void simTick(void){
+  sim_micros += SIM_TICK_US;
+  sim_timer_hw.timerawl += SIM_TICK_US;
+  SIM_ISR();
+}
+
+// segments that don't fit in the queue are re-tried every tick, as the endpoint does w/ EP_ONDATA_WAIT 
+uint32_t issueCommand(simCommand_t& cmd){
+  uint32_t waited = 0;
+  switch(cmd.type){
+    case CMD_POS:
+      motion_setPositionTarget(cmd.targ, cmd.maxVel, cmd.maxAccel);
+      break;
+    case CMD_VEL:
+      motion_setVelocityTarget(cmd.targ, cmd.maxAccel);
+      break;
+#ifdef MOTION_MODE_SCURVE
+    case CMD_SCURVE:
+      motion_setPositionTargetJerk(cmd.targ, cmd.maxVel, cmd.maxAccel, cmd.maxJerk);
+      break;
+#endif
+#ifdef MOTION_MODE_QUEUE
+    case CMD_SEGMENT:
+      while(!motion_addSegment(cmd.targ, cmd.maxVel, cmd.maxAccel)){
+        simTick();
+        waited ++;
+      }
+      break;
+#endif
+  }
+  return waited;
+}
+
+typedef struct simResult_t {
+  uint64_t ticks;
+  float worstOvershoot;
+  float finalTarget;
+  float finalPos;
+  float finalVel;
+  int64_t netSteps;
+  uint64_t totalSteps;
+  boolean timedOut;
+} simResult_t;
+
+// runs the script, observing states each tick, and records how long each command was held:
+simResult_t runObserved(std::vector<simCommand_t>& script, std::vector<uint32_t>& heldTicks){
+  simResult_t res = {};
+  int64_t fwdStart = stepsForward;
+  int64_t bwdStart = stepsBackward;
+  uint32_t timeoutTicks = (uint32_t)(SETTLE_TIMEOUT * 1000000.0F / SIM_TICK_US);
+  motionState_t state;
+  heldTicks.clear();
+  for(size_t c = 0; c < script.size(); c ++){
+    simCommand_t& cmd = script[c];
+    motion_getCurrentStates(&state);
+    // segments start where the last one ends, not where we are now 
+    float startPos = (cmd.type == CMD_SEGMENT && c > 0) ? script[c - 1].targ : state.pos;
+    uint32_t t = issueCommand(cmd);
+    if(cmd.type != CMD_VEL) res.finalTarget = cmd.targ;
+    // overshoot is the distance we travel past the target, in the direction we were headed,
+    float dir = (cmd.targ >= startPos) ? 1.0F : -1.0F;
+    uint32_t restTicks = 0;
+    while(cmd.holdTicks != HOLD_NONE){
+      simTick();
+      t ++;
+      motion_getCurrentStates(&state);
+      if(cmd.type != CMD_VEL && cmd.holdTicks == HOLD_UNTIL_SETTLED){
+        float over = (state.pos - cmd.targ) * dir;
+        if(over > res.worstOvershoot) res.worstOvershoot = over;
+      }
+      if(cmd.holdTicks == HOLD_UNTIL_SETTLED){
+        // at rest for a few ticks in a row, call it done,
+        if(state.vel == 0.0F && state.accel == 0.0F){
+          restTicks ++;
+        } else {
+          restTicks = 0;
+        }
+        if(restTicks > 4) break;
+        if(t > timeoutTicks){
+          res.timedOut = true;
+          break;
+        }
+      } else if (t >= cmd.holdTicks){
+        break;
+      }
+    }
+    heldTicks.push_back(t);
+    res.ticks += t;
+  }
+  res.finalPos = state.pos;
+  res.finalVel = state.vel;
+  res.netSteps = (stepsForward - fwdStart) - (stepsBackward - bwdStart);
+  res.totalSteps = (stepsForward - fwdStart) + (stepsBackward - bwdStart);
+  return res;
+}
+
+// replays the same script w/ the same hold times, without looking at states, so we can time the ISR alone
+double runTimed(std::vector<simCommand_t>& script, std::vector<uint32_t>& heldTicks){
+  uint64_t ticks = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(size_t c = 0; c < script.size(); c ++){
+    uint32_t t = issueCommand(script[c]);
+    for(; t < heldTicks[c]; t ++){
+      simTick();
+    }
+    ticks += heldTicks[c];
+  }
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  return ticks ? ns / (double)ticks : 0.0;
+}
+
+// ---------------------------------------------- scenarios
+// rates are in steps / sec and steps / sec^2, as they arrive from the targetState endpoint,
+// max velocity is just below one-step-per-tick
+const float simMaxVel = 0.8F * 1000000.0F / SIM_TICK_US;
+const float simMaxAccel = 40000.0F;
+
+uint32_t msToTicks(float ms){
+  return (uint32_t)(ms * 1000.0F / SIM_TICK_US);
+}
+
+void scriptLongMoves(std::vector<simCommand_t>& s){
+  s.push_back({CMD_POS, 2000.0F, simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED});
+  // -ve deltas, the old bug,
+  s.push_back({CMD_POS, -1500.0F, simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED});
+  s.push_back({CMD_POS, -1499.0F, simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED});
+  s.push_back({CMD_POS, 0.0F, simMaxVel * 0.1F, simMaxAccel * 0.1F, HOLD_UNTIL_SETTLED});
+}
+
+void scriptShortMoves(std::vector<simCommand_t>& s){
+  float targs[] = { 1.0F, 3.0F, -2.0F, 10.0F, 9.0F, -25.0F, 0.0F };
+  for(float targ : targs){
+    s.push_back({CMD_POS, targ, simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED});
+  }
+}
+
+// ~ the random .target() loop from log/2022-12_jakes-fixed-point-log.md
+void scriptRandomTargets(std::vector<simCommand_t>& s){
+  lcgState = 1;
+  for(uint8_t v = 0; v < 100; v ++){
+    float targ = (lcgRandom() - 0.5F) * 2000.0F;
+    s.push_back({CMD_POS, targ, simMaxVel, simMaxAccel, msToTicks(100)});
+  }
+  s.push_back({CMD_POS, 0.0F, simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED});
+}
+
+void scriptRandomVelocities(std::vector<simCommand_t>& s){
+  lcgState = 7;
+  for(uint8_t v = 0; v < 50; v ++){
+    float targ = (lcgRandom() - 0.5F) * 2.0F * simMaxVel;
+    s.push_back({CMD_VEL, targ, 0.0F, simMaxAccel, msToTicks(50)});
+  }
+  s.push_back({CMD_VEL, 0.0F, 0.0F, simMaxAccel, HOLD_UNTIL_SETTLED});
+  s.push_back({CMD_POS, 0.0F, simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED});
+}
+
+// a zig-zag w/ some long same-direction runs, once as stop-and-go moves and once thru the queue, 
+// ticks taken is the thing to compare 
+const float pathPoints[] = { 200.0F, 400.0F, 600.0F, 620.0F, 640.0F, 1200.0F, 1000.0F, 800.0F, 900.0F, 1500.0F, 1510.0F, 0.0F };
+const float pathVels[] = { 1.0F, 1.0F, 0.5F, 0.2F, 0.2F, 1.0F, 0.7F, 0.7F, 0.3F, 1.0F, 0.1F, 1.0F };
+
+void scriptPathStopAndGo(std::vector<simCommand_t>& s){
+  for(size_t p = 0; p < sizeof(pathPoints) / sizeof(float); p ++){
+    s.push_back({CMD_POS, pathPoints[p], pathVels[p] * simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED});
+  }
+}
+
+void scriptPathQueued(std::vector<simCommand_t>& s){
+  size_t count = sizeof(pathPoints) / sizeof(float);
+  for(size_t p = 0; p < count; p ++){
+    s.push_back({CMD_SEGMENT, pathPoints[p], pathVels[p] * simMaxVel, simMaxAccel, (p == count - 1) ? HOLD_UNTIL_SETTLED : HOLD_NONE});
+  }
+}
+
+// lots of short segments, as from a plotter's polyline, which also overfills the queue 
+void scriptManySegments(std::vector<simCommand_t>& s){
+  for(uint16_t p = 1; p <= 300; p ++){
+    s.push_back({CMD_SEGMENT, p * 3.0F, simMaxVel, simMaxAccel, HOLD_NONE});
+  }
+  for(uint16_t p = 1; p <= 300; p ++){
+    s.push_back({CMD_SEGMENT, 900.0F - p * 3.0F, simMaxVel * 0.5F, simMaxAccel, (p == 300) ? HOLD_UNTIL_SETTLED : HOLD_NONE});
+  }
+}
+
+// the same long & short moves, and random targets, as s-curves: at this jerk, ramps to max accel take 20ms 
+const float simMaxJerk = simMaxAccel / 0.02F;
+
+void scriptSCurveMoves(std::vector<simCommand_t>& s){
+  float targs[] = { 2000.0F, -1500.0F, -1499.0F, 1.0F, 3.0F, -2.0F, 10.0F, 9.0F, -25.0F, 0.0F };
+  for(float targ : targs){
+    s.push_back({CMD_SCURVE, targ, simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED, simMaxJerk});
+  }
+  // and a slow one, that never reaches max accel, 
+  s.push_back({CMD_SCURVE, 500.0F, simMaxVel * 0.1F, simMaxAccel, HOLD_UNTIL_SETTLED, simMaxJerk * 0.01F});
+  s.push_back({CMD_SCURVE, 0.0F, simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED, simMaxJerk});
+}
+
+void scriptSCurveRandom(std::vector<simCommand_t>& s){
+  lcgState = 1;
+  for(uint8_t v = 0; v < 100; v ++){
+    float targ = (lcgRandom() - 0.5F) * 2000.0F;
+    s.push_back({CMD_SCURVE, targ, simMaxVel, simMaxAccel, msToTicks(100), simMaxJerk});
+  }
+  s.push_back({CMD_SCURVE, 0.0F, simMaxVel, simMaxAccel, HOLD_UNTIL_SETTLED, simMaxJerk});
+}
+
+typedef struct simScenario_t {
+  const char* name;
+  void (*build)(std::vector<simCommand_t>& s);
+} simScenario_t;
+
+simScenario_t scenarios[] = {
+  { "long-moves", scriptLongMoves },
+  { "short-moves", scriptShortMoves },
+  { "random-targets", scriptRandomTargets },
+  { "random-velocities", scriptRandomVelocities },
+  { "path-stop-and-go", scriptPathStopAndGo },
+#ifdef MOTION_MODE_QUEUE
+  { "path-queued", scriptPathQueued },
+  { "many-segments", scriptManySegments },
+#endif
+#ifdef MOTION_MODE_SCURVE
+  { "scurve-moves", scriptSCurveMoves },
+  { "scurve-random", scriptSCurveRandom },
+#endif
+};
+
+// ---------------------------------------------- telemetry
+// samples a long move while draining as the loop would, then once w/o draining (so the ring overflows):
+// sample numbers should run w/o gaps in the first case, and skip (not repeat) in the second
+#define TELEMETRY_DECIMATION 10
+
+boolean checkTelemetry(void){
+  motion_setPosition(0.0F);
+  motion_setTelemetryDecimation(TELEMETRY_DECIMATION);
+  motion_setPositionTarget(2000.0F, simMaxVel, simMaxAccel);
+  motionSample_t batch[MOTION_TELEMETRY_BATCH];
+  uint32_t samples = 0;
+  uint32_t gaps = 0;
+  uint32_t nextNum = 0;
+  boolean first = true;
+  float worstPosError = 0.0F;
+  float lastPos = 0.0F;
+  motionState_t state;
+  for(uint32_t t = 0; t < 50000; t ++){
+    simTick();
+    // the loop is much slower than the ISR, but we want a batch (or more) to land between drains 
+    if(t % (TELEMETRY_DECIMATION * MOTION_TELEMETRY_BATCH) != 0) continue;
+    motion_getCurrentStates(&state);
+    uint8_t count;
+    while((count = motion_drainTelemetry(batch, MOTION_TELEMETRY_BATCH)) > 0){
+      for(uint8_t s = 0; s < count; s ++){
+        if(!first && batch[s].sampleNum != nextNum) gaps ++;
+        first = false;
+        nextNum = batch[s].sampleNum + 1;
+        samples ++;
+        lastPos = batch[s].pos;
+      }
+    }
+    // the latest sample was taken no more than one decimation interval ago, 
+    float posError = fabsf(lastPos - state.pos);
+    if(posError > worstPosError) worstPosError = posError;
+  }
+  // now we stop draining, the ring fills, and we should see one gap when we come back 
+  motion_setPositionTarget(0.0F, simMaxVel, simMaxAccel);
+  for(uint32_t t = 0; t < MOTION_TELEMETRY_SIZE * 4 * TELEMETRY_DECIMATION; t ++){
+    simTick();
+  }
+  // (the ring holds the oldest samples, so the gap shows up after those, when fresh ones arrive) 
+  uint32_t overflowGaps = 0;
+  for(uint8_t pass = 0; pass < 2; pass ++){
+    uint8_t count;
+    while((count = motion_drainTelemetry(batch, MOTION_TELEMETRY_BATCH)) > 0){
+      for(uint8_t s = 0; s < count; s ++){
+        if(batch[s].sampleNum != nextNum) overflowGaps ++;
+        nextNum = batch[s].sampleNum + 1;
+      }
+    }
+    for(uint32_t t = 0; t < MOTION_TELEMETRY_BATCH * TELEMETRY_DECIMATION; t ++){
+      simTick();
+    }
+  }
+  motion_setTelemetryDecimation(0);
+  // the max travel in one decimation interval, at max rate, 
+  float posTolerance = simMaxVel * (float)(TELEMETRY_DECIMATION * SIM_TICK_US) / 1000000.0F;
+  boolean ok = samples > 0 && gaps == 0 && overflowGaps == 1 && lastPos == 2000.0F && worstPosError <= posTolerance;
+  printf("telemetry: %u samples, %u gaps, %u after overflow, worst lag %.4f steps, %s\n",
+    samples, gaps, overflowGaps, worstPosError, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// ---------------------------------------------- timed starts
+// a host clock that's offset from ours, and a little fast, gets sync'd every so often, 
+// then a target scheduled (in host time) should start on the first tick at-or-after that time, and not before 
+// (the sim ticks on a fixed grid, so it doesn't see the re-timed tick that lands right on it, on hardware) 
+boolean checkTimedStart(void){
+  const uint32_t hostOffset = 123456789;
+  const double hostRate = 1.0002;   // 200 ppm fast 
+  uint32_t deviceStart = micros();
+  auto hostNow = [&](void){ return (uint32_t)(hostOffset + (uint32_t)((double)(micros() - deviceStart) * hostRate)); };
+  // sync a few times, a couple seconds apart, as the host would, 
+  motion_setPosition(0.0F);
+  for(uint8_t s = 0; s < 4; s ++){
+    motion_syncClock(hostNow(), micros());
+    for(uint32_t t = 0; t < 20000; t ++) simTick();
+  }
+  // how well do we map host times now ?
+  uint32_t deviceTime = 0;
+  motion_hostToDeviceTime(hostNow(), &deviceTime);
+  int32_t mapError = (int32_t)(deviceTime - micros());
+  // schedule a move 5.05ms out, in host time, 
+  uint32_t hostAt = hostNow() + 5050;
+  uint32_t deviceAt = 0;
+  motion_hostToDeviceTime(hostAt, &deviceAt);
+  motion_setPositionTargetAt(100.0F, simMaxVel, simMaxAccel, deviceAt);
+  motionState_t state;
+  uint32_t startedAt = 0;
+  boolean early = false;
+  for(uint32_t t = 0; t < 200; t ++){
+    simTick();
+    motion_getCurrentStates(&state);
+    if(state.pos != 0.0F){
+      if((int32_t)(micros() - deviceAt) < 0) early = true;
+      startedAt = micros();
+      break;
+    }
+  }
+  int32_t lateBy = (int32_t)(startedAt - deviceAt);
+  // and go home, 
+  motion_setPositionTarget(0.0F, simMaxVel, simMaxAccel);
+  for(uint32_t t = 0; t < 20000; t ++) simTick();
+  boolean ok = abs(mapError) <= 2 && startedAt != 0 && !early && lateBy < SIM_TICK_US;
+  printf("timed start: clock map error %d us, started %d us after schedule, %s\n", mapError, lateBy, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// ---------------------------------------------- full command ring 
+// a timed command holds the ring 'till it goes, so w/ that and a couple behind it, the next setter should 
+// hand back false straight away (rather than spin, as it did: that was the endpoint stuck for up to 100ms), 
+// and go thru once the integrator has caught up 
+boolean checkCommandRing(void){
+  uint32_t executeAt = micros() + 50000;
+  boolean filled = true;
+  for(uint8_t c = 0; c < MOTION_COMMAND_SIZE - 1; c ++){
+    if(!motion_setPositionTargetAt(10.0F * (c + 1), simMaxVel, simMaxAccel, executeAt)) filled = false;
+  }
+  boolean refused = motion_getCommandSpace() == 0 && !motion_setPositionTarget(0.0F, simMaxVel, simMaxAccel);
+  uint32_t waited = 0;
+  while(motion_getCommandSpace() == 0 && waited < 1000){
+    simTick();
+    waited ++;
+  }
+  boolean accepted = motion_setPositionTarget(0.0F, simMaxVel, simMaxAccel);
+  for(uint32_t t = 0; t < 20000; t ++) simTick();
+  motionState_t state;
+  motion_getCurrentStates(&state);
+  boolean ok = filled && refused && accepted && state.pos == 0.0F;
+  printf("command ring: full ring refused, space again after %u ticks, %s\n", waited, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// ---------------------------------------------- tick timing 
+// the sim's SysTick runs on sim time, so ISRs cost nothing and every interval is exactly one tick: 
+// this checks the bookkeeping (counts, bins, the reset), not the numbers you'd see on a board 
+#define TIMING_TICKS 5000
+
+boolean checkTiming(void){
+  motion_resetTiming();
+  for(uint32_t t = 0; t < TIMING_TICKS; t ++) simTick();
+  motionTiming_t timing;
+  motion_getTiming(&timing);
+  uint32_t costBinned = 0;
+  uint32_t intervalBinned = 0;
+  for(uint8_t b = 0; b < MOTION_TIMING_BINS; b ++){
+    costBinned += timing.costHist[b];
+    intervalBinned += timing.intervalHist[b];
+  }
+  boolean ok = timing.count == TIMING_TICKS && costBinned == TIMING_TICKS && timing.costMax == 0
+    && timing.tickCycles == SIM_TICK_US * (F_CPU / 1000000)
+    && timing.intervalMin == timing.tickCycles && timing.intervalMax == timing.tickCycles
+    && intervalBinned == TIMING_TICKS && timing.intervalHist[MOTION_TIMING_BINS / 2] == TIMING_TICKS;
+  printf("tick timing: %u ticks, interval min / mean / max %u / %.1f / %u cycles (of %u), %s\n",
+    timing.count, timing.intervalMin, timing.intervalMean, timing.intervalMax, timing.tickCycles, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// ---------------------------------------------- limit switch & homing 
+// a switch at some spot along the axis, in steps from where we started (stepper_step() is where the axis really is), 
+// that calls motion_limitTrigger() on the press edge, as the pin interrupt would 
+int64_t switchOrigin = 0;
+boolean switchDown = false;
+
+void simSwitchTick(int64_t switchAt, boolean below){
+  simTick();
+  int64_t axis = (stepsForward - stepsBackward) - switchOrigin;
+  boolean down = below ? (axis <= switchAt) : (axis >= switchAt);
+  if(down && !switchDown) motion_limitTrigger();
+  switchDown = down;
+}
+
+// home onto a switch 737 steps behind us, from two starting points: 
+// afterwards, the switch should be at zero (to the step) and we should be parked at the backoff 
+#define HOME_SWITCH_AT -737
+#define HOME_BACKOFF 50.0F
+
+boolean checkHoming(void){
+  float worstZeroError = 0.0F;
+  boolean ok = true;
+  motionLimitState_t limit;
+  motionState_t state;
+  const float starts[] = { 0.0F, -600.0F };
+  switchOrigin = stepsForward - stepsBackward;
+  for(float start : starts){
+    motion_setPosition(0.0F);
+    motion_setPositionTarget(start, simMaxVel, simMaxAccel);
+    for(uint32_t t = 0; t < 20000; t ++) simSwitchTick(HOME_SWITCH_AT, true);
+    // where the axis is, now, that we're about to lose track of, 
+    int64_t axisBefore = (stepsForward - stepsBackward) - switchOrigin;
+    motion_home(-simMaxVel * 0.25F, -simMaxVel * 0.01F, simMaxAccel, HOME_BACKOFF, 5000.0F);
+    uint32_t t = 0;
+    for(; t < 200000; t ++){
+      simSwitchTick(HOME_SWITCH_AT, true);
+      motion_getLimitState(&limit);
+      motion_getCurrentStates(&state);
+      if(limit.homePhase == MOTION_HOME_FAILED) break;
+      if(limit.homePhase == MOTION_HOME_DONE && state.vel == 0.0F && state.accel == 0.0F) break;
+    }
+    // the axis' zero is where we are, less the backoff, 
+    float axisZero = (float)((stepsForward - stepsBackward) - switchOrigin) - state.pos;
+    float zeroError = fabsf(axisZero - (float)HOME_SWITCH_AT);
+    if(zeroError > worstZeroError) worstZeroError = zeroError;
+    if(limit.homePhase != MOTION_HOME_DONE || state.pos != HOME_BACKOFF || zeroError > 1.0F) ok = false;
+    // and go back where we were, in the new coordinates, 
+    motion_setPositionTarget((float)(axisBefore - HOME_SWITCH_AT), simMaxVel, simMaxAccel);
+    for(uint32_t t = 0; t < 20000; t ++) simSwitchTick(HOME_SWITCH_AT, true);
+  }
+  // a switch we're already on: the sketch triggers it by hand, and we back off of it first, 
+  motion_home(-simMaxVel * 0.25F, -simMaxVel * 0.01F, simMaxAccel, HOME_BACKOFF, 5000.0F);
+  // (the switch is our zero now) 
+  motion_setPositionTarget(-10.0F, simMaxVel, simMaxAccel);
+  for(uint32_t t = 0; t < 20000; t ++) simSwitchTick(HOME_SWITCH_AT, true);
+  motion_getLimitState(&limit);
+  boolean cancelled = (limit.homePhase == MOTION_HOME_IDLE);
+  motion_home(-simMaxVel * 0.25F, -simMaxVel * 0.01F, simMaxAccel, HOME_BACKOFF, 5000.0F);
+  motion_limitTrigger();
+  for(uint32_t t = 0; t < 200000; t ++) simSwitchTick(HOME_SWITCH_AT, true);
+  motion_getLimitState(&limit);
+  motion_getCurrentStates(&state);
+  boolean pressedOk = limit.homePhase == MOTION_HOME_DONE && state.pos == HOME_BACKOFF;
+  // and one that never finds the switch, 
+  motion_home(simMaxVel * 0.25F, simMaxVel * 0.01F, simMaxAccel, HOME_BACKOFF, 500.0F);
+  for(uint32_t t = 0; t < 20000; t ++) simSwitchTick(HOME_SWITCH_AT, true);
+  motion_getLimitState(&limit);
+  motion_getCurrentStates(&state);
+  boolean failedOk = limit.homePhase == MOTION_HOME_FAILED && state.vel == 0.0F && state.pos > HOME_BACKOFF + 500.0F;
+  ok = ok && cancelled && pressedOk && failedOk;
+  printf("homing: worst zero error %.4f steps, cancel %s, on-the-switch %s, no-switch %s, %s\n", worstZeroError,
+    cancelled ? "ok" : "FAIL", pressedOk ? "ok" : "FAIL", failedOk ? "ok" : "FAIL", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// w/ limit stops on, a queued move into the switch stops dead where it trips, and the queue works again after 
+#define STOP_SWITCH_AT 500
+
+boolean checkLimitStop(void){
+  motion_setPosition(0.0F);
+  for(uint32_t t = 0; t < 10; t ++) simTick();
+  switchOrigin = stepsForward - stepsBackward;
+  switchDown = false;
+  motion_setLimitStop(true);
+  motion_addSegment(2000.0F, simMaxVel * 0.5F, simMaxAccel);
+  motionState_t state;
+  float stoppedAt = 0.0F;
+  uint32_t t = 0;
+  for(; t < 50000; t ++){
+    simSwitchTick(STOP_SWITCH_AT, false);
+    if(switchDown){
+      // the tick after the edge, 
+      simSwitchTick(STOP_SWITCH_AT, false);
+      motion_getCurrentStates(&state);
+      stoppedAt = state.pos;
+      break;
+    }
+  }
+  boolean stopped = (state.vel == 0.0F && fabsf(stoppedAt - STOP_SWITCH_AT) <= 1.0F);
+  for(uint32_t t = 0; t < 1000; t ++) simSwitchTick(STOP_SWITCH_AT, false);
+  motion_getCurrentStates(&state);
+  stopped = stopped && state.pos == stoppedAt;
+  // and we can carry on, 
+  motion_addSegment(0.0F, simMaxVel, simMaxAccel);
+  for(uint32_t t = 0; t < 20000; t ++) simSwitchTick(STOP_SWITCH_AT, false);
+  motion_getCurrentStates(&state);
+  boolean resumed = (state.pos == 0.0F);
+  motion_setLimitStop(false);
+  boolean ok = stopped && resumed;
+  printf("limit stop: stopped at %.4f (switch at %d), queue after %s, %s\n", stoppedAt, STOP_SWITCH_AT,
+    resumed ? "ok" : "FAIL", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// ---------------------------------------------- events 
+// a position move, a velocity ramp & stop, and a few queued segments should each report (once) when they get there, 
+// and moves that are replaced before they finish shouldn't report at all 
+boolean checkEvents(void){
+  motionEvent_t evt;
+  while(motion_getEvent(&evt));
+  uint32_t firstNum = 0;
+  boolean first = true;
+  uint32_t count = 0;
+  boolean ok = true;
+  auto expect = [&](uint8_t type, float pos, float vel, uint32_t ticks){
+    uint32_t got = 0;
+    for(uint32_t t = 0; t < ticks; t ++){
+      simTick();
+      while(motion_getEvent(&evt)){
+        if(first) firstNum = evt.eventNum;
+        if(evt.eventNum != firstNum + count) ok = false;
+        first = false;
+        count ++;
+        got ++;
+        // (we don't know where a velocity ramp ends, so that one's NAN) 
+        if(evt.type != type || (!isnan(pos) && evt.pos != pos) || fabsf(evt.vel - vel) > 0.01F) ok = false;
+      }
+    }
+    if(got != 1) ok = false;
+  };
+  motion_setPosition(0.0F);
+  motion_setPositionTarget(1000.0F, simMaxVel, simMaxAccel);
+  expect(MOTION_EVENT_TARGET_REACHED, 1000.0F, 0.0F, 20000);
+  // the count is the next one's number, which is what the JS waits from 
+  if(motion_getEventCount() != firstNum + count) ok = false;
+  // this one's replaced half way, so only the second says anything, 
+  motion_setPositionTarget(3000.0F, simMaxVel, simMaxAccel);
+  for(uint32_t t = 0; t < 1000; t ++) simTick();
+  motion_setPositionTarget(0.0F, simMaxVel, simMaxAccel);
+  expect(MOTION_EVENT_TARGET_REACHED, 0.0F, 0.0F, 20000);
+  motion_setVelocityTarget(4000.0F, simMaxAccel);
+  expect(MOTION_EVENT_VELOCITY_REACHED, NAN, 4000.0F, 2000);
+  motion_setVelocityTarget(0.0F, simMaxAccel);
+  for(uint32_t t = 0; t < 2000; t ++) simTick();
+  boolean stopped = motion_getEvent(&evt) && evt.type == MOTION_EVENT_VELOCITY_REACHED && evt.vel == 0.0F;
+  count ++;
+  motion_setPosition(0.0F);
+  for(uint16_t p = 1; p <= 10; p ++) motion_addSegment(p * 100.0F, simMaxVel, simMaxAccel);
+  expect(MOTION_EVENT_TARGET_REACHED, 1000.0F, 0.0F, 20000);
+  ok = ok && stopped;
+  printf("events: %u events, %s\n", count, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// ---------------------------------------------- s-curves 
+// accel should never change by more than the jerk limit in a tick (but for the last one, where we land on the target), 
+// and the same long move should take a little longer than the trapezoid, by about one ramp 
+boolean checkSCurve(void){
+  motionState_t state;
+  float jerkPerTick = simMaxJerk * (float)SIM_TICK_US / 1000000.0F;
+  float worstJerk = 0.0F;
+  uint32_t ticks[2] = { 0, 0 };
+  for(uint8_t pass = 0; pass < 2; pass ++){
+    motion_setPosition(0.0F);
+    for(uint32_t t = 0; t < 10; t ++) simTick();
+    if(pass == 0){
+      motion_setPositionTarget(5000.0F, simMaxVel, simMaxAccel);
+    } else {
+      motion_setPositionTargetJerk(5000.0F, simMaxVel, simMaxAccel, simMaxJerk);
+    }
+    float lastAccel = 0.0F;
+    for(uint32_t t = 0; t < 100000; t ++){
+      simTick();
+      motion_getCurrentStates(&state);
+      if(pass == 1 && state.pos != 5000.0F){
+        float jerk = fabsf(state.accel - lastAccel);
+        if(jerk > worstJerk) worstJerk = jerk;
+      }
+      lastAccel = state.accel;
+      if(state.pos == 5000.0F && state.vel == 0.0F){
+        ticks[pass] = t;
+        break;
+      }
+    }
+  }
+  // (a little slack, for rounding) 
+  boolean ok = ticks[0] != 0 && ticks[1] != 0 && worstJerk <= jerkPerTick * 1.01F && ticks[1] > ticks[0] && ticks[1] < ticks[0] + msToTicks(40);
+  printf("s-curve: worst jerk %.1f of %.1f steps/s^2 per tick, %u ticks vs %u trapezoidal, %s\n",
+    worstJerk, jerkPerTick, ticks[1], ticks[0], ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// ---------------------------------------------- paths 
+// a synchronizer hands each of its axes the same line, w/ the same rates along it, so they all run the same profile: 
+// here we run one path once for each axis (in turn, since there's only one integrator), and they should finish on the same tick, 
+// and never leave the path between them... once w/ the corners planned as synchronizer.js does, and once stopping at each 
+const float pathXY[][2] = { {0.0F, 0.0F}, {1000.0F, 0.0F}, {1000.0F, 800.0F}, {300.0F, 1500.0F}, {0.0F, 1500.0F}, {600.0F, 1500.0F}, {1200.0F, 1540.0F}, {0.0F, 0.0F} };
+#define PATH_POINTS (sizeof(pathXY) / sizeof(pathXY[0]))
+// the host's junction deviation, in steps here, 
+#define PATH_DEVIATION 1.0F
+
+// as in synchronizer.js: we round the corner on an arc that comes this close to it, as fast as that allows at the path's accel, 
+// (less, if the corner's direction puts more than an axis' max accel on one axis) 
+float pathJunction(const float* prevUnit, const float* unit, float vel, float accel){
+  float cosTheta = -(prevUnit[0] * unit[0] + prevUnit[1] * unit[1]);
+  if(cosTheta < -0.999999F) return vel;
+  if(cosTheta > 0.999999F) return 0.0F;
+  float junctionUnit[2] = { unit[0] - prevUnit[0], unit[1] - prevUnit[1] };
+  float norm = sqrtf(junctionUnit[0] * junctionUnit[0] + junctionUnit[1] * junctionUnit[1]);
+  for(uint8_t a = 0; a < 2; a ++){
+    float share = fabsf(junctionUnit[a] / norm);
+    if(share * accel > simMaxAccel) accel = simMaxAccel / share;
+  }
+  float sinHalf = sqrtf(0.5F * (1.0F - cosTheta));
+  return fminf(vel, sqrtf(accel * PATH_DEVIATION * sinHalf / (1.0F - sinHalf)));
+}
+
+// runs the path on one axis, returns its track, 
+std::vector<float> runPathAxis(uint8_t axis, boolean planned){
+  const float vel = simMaxVel * 0.5F;
+  const float accel = simMaxAccel * 0.5F;
+  std::vector<float> track;
+  // (at rest, whatever we were doing before) 
+  motion_setPosition(pathXY[0][axis]);
+  motion_setPositionTarget(pathXY[0][axis], simMaxVel, simMaxAccel);
+  for(uint32_t t = 0; t < 10; t ++) simTick();
+  motionEvent_t stale;
+  while(motion_getEvent(&stale));
+  float prevUnit[2] = { 0.0F, 0.0F };
+  for(size_t p = 1; p < PATH_POINTS; p ++){
+    float dx = pathXY[p][0] - pathXY[p - 1][0];
+    float dy = pathXY[p][1] - pathXY[p - 1][1];
+    float length = sqrtf(dx * dx + dy * dy);
+    float unit[2] = { dx / length, dy / length };
+    float junction = (p > 1 && planned) ? pathJunction(prevUnit, unit, vel, accel) : 0.0F;
+    motion_addPathSegment(pathXY[p][axis], length, vel, accel, junction);
+    prevUnit[0] = unit[0];
+    prevUnit[1] = unit[1];
+  }
+  // an axis that sits still for a while looks the same as one that's done, so we wait for the end-of-queue event, 
+  motionState_t state;
+  motionEvent_t evt;
+  boolean done = false;
+  for(uint32_t t = 0; t < 200000 && !done; t ++){
+    simTick();
+    motion_getCurrentStates(&state);
+    track.push_back(state.pos);
+    while(motion_getEvent(&evt)) done = done || (evt.type == MOTION_EVENT_TARGET_REACHED);
+  }
+  return track;
+}
+
+// the distance from a point to the nearest line on the path, 
+float pathDeviation(float x, float y){
+  float best = INFINITY;
+  for(size_t p = 1; p < PATH_POINTS; p ++){
+    float ax = pathXY[p - 1][0], ay = pathXY[p - 1][1];
+    float dx = pathXY[p][0] - ax, dy = pathXY[p][1] - ay;
+    float along = fmaxf(0.0F, fminf(1.0F, ((x - ax) * dx + (y - ay) * dy) / (dx * dx + dy * dy)));
+    float ex = x - (ax + along * dx), ey = y - (ay + along * dy);
+    best = fminf(best, sqrtf(ex * ex + ey * ey));
+  }
+  return best;
+}
+
+boolean checkPaths(void){
+  uint32_t ticks[2] = { 0, 0 };
+  float worstDeviation = 0.0F;
+  boolean together = true;
+  for(uint8_t pass = 0; pass < 2; pass ++){
+    int64_t stepsBefore = stepsForward - stepsBackward;
+    std::vector<float> x = runPathAxis(0, pass == 0);
+    int64_t xSteps = (stepsForward - stepsBackward) - stepsBefore;
+    std::vector<float> y = runPathAxis(1, pass == 0);
+    if(x.size() != y.size() || llabs(xSteps - (int64_t)(pathXY[PATH_POINTS - 1][0] - pathXY[0][0])) > 1) together = false;
+    for(size_t t = 0; t < x.size() && t < y.size(); t ++){
+      float deviation = pathDeviation(x[t], y[t]);
+      if(deviation > worstDeviation) worstDeviation = deviation;
+    }
+    ticks[pass] = x.size();
+  }
+  boolean ok = together && worstDeviation < 0.01F && ticks[0] < ticks[1];
+  printf("paths: %u ticks w/ planned corners vs %u stopping, worst deviation %.4f steps, axes %s, %s\n",
+    ticks[0], ticks[1], worstDeviation, together ? "together" : "APART", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char** argv){
+  motion_init(SIM_TICK_US);
+  printf("%s: %d us tick, max vel %.0f steps/s, max accel %.0f steps/s^2\n", SIM_BOARD, SIM_TICK_US, simMaxVel, simMaxAccel);
+  printf("%-18s %10s %8s %10s %10s %10s %10s %10s\n", "scenario", "ticks", "ns/tick", "steps", "pos err", "step err", "overshoot", "result");
+  int failures = 0;
+  for(simScenario_t& scn : scenarios){
+    std::vector<simCommand_t> script;
+    std::vector<uint32_t> held;
+    scn.build(script);
+    // each scenario starts from rest at zero,
+    motion_setPosition(0.0F);
+    simResult_t res = runObserved(script, held);
+    // stepper_step() is our ground truth: it should agree w/ the integrator's position,
+    float posError = fabsf(res.finalPos - res.finalTarget);
+    float stepError = fabsf((float)res.netSteps - res.finalPos);
+    boolean ok = !res.timedOut && res.finalVel == 0.0F && posError <= POS_TOLERANCE && stepError <= 1.0F;
+    // replay, to time,
+    motion_setPosition(0.0F);
+    double nsPerTick = runTimed(script, held);
+    printf("%-18s %10llu %8.1f %10llu %10.4f %10.4f %10.4f %10s\n",
+      scn.name, (unsigned long long)res.ticks, nsPerTick, (unsigned long long)res.totalSteps,
+      posError, stepError, res.worstOvershoot,
+      res.timedOut ? "TIMEOUT" : (ok ? "ok" : "FAIL"));
+    if(!ok) failures ++;
+  }
+  if(!checkTelemetry()) failures ++;
+  if(!checkTimedStart()) failures ++;
+  if(!checkCommandRing()) failures ++;
+  if(!checkTiming()) failures ++;
+  if(!checkHoming()) failures ++;
+  if(!checkLimitStop()) failures ++;
+  if(!checkEvents()) failures ++;
+  if(!checkSCurve()) failures ++;
+#ifdef MOTION_MODE_QUEUE
+  if(!checkPaths()) failures ++;
+#endif
+  // settle back at zero, 
+  motion_setPositionTarget(0.0F, simMaxVel, simMaxAccel);
+  for(uint32_t t = 0; t < 50000; t ++) simTick();
+  printf("%u critical sections requested\n", sim_criticalSections);
+  return failures ? 1 : 0;
+}
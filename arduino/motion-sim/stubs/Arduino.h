@@ -0,0 +1,137 @@
+/*
+Arduino.h (host stub)
+
+just enough of the arduino core, SAMD21 registers and RP2040 sdk to compile
+the motion state machines on a linux host, see ../motion-sim.cpp
+
+Jake Read at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the squidworks and ponyo
+projects. Copyright is retained and must be preserved. The work is provided as
+is; no warranty is provided, and users accept all liability.
+*/
+
+#ifndef SIM_ARDUINO_H_
+#define SIM_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef bool boolean;
+
+// same as the samd core: a macro, so it works on int64's and floats alike
+#ifdef abs
+#undef abs
+#endif
+#define abs(x) ((x)>0?(x):-(x))
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+// interrupts are a no-op here: the sim calls the ISR from the same thread,
+// but we count how often the firmware asks for a critical section
+extern uint32_t sim_criticalSections;
+inline void noInterrupts(void){ sim_criticalSections ++; }
+inline void interrupts(void){}
+
+inline void pinMode(uint8_t pin, uint8_t mode){}
+inline void digitalWrite(uint8_t pin, uint8_t val){}
+inline int digitalRead(uint8_t pin){ return HIGH; }
+
+// time, in sim-ticks, advanced by the harness
+extern uint32_t sim_micros;
+inline uint32_t micros(void){ return sim_micros; }
+inline uint32_t millis(void){ return sim_micros / 1000; }
+
+// the cpu clock, as the board packages define it 
+#ifndef F_CPU
+#if defined(ARDUINO_ARCH_SAMD)
+#define F_CPU 48000000L
+#else
+#define F_CPU 133000000L
+#endif
+#endif
+
+// SysTick counts down at the cpu clock, wrapping at LOAD: here, it's derived from sim time, 
+// so that ISRs (which the sim calls w/o advancing time) cost nothing, and intervals are exact 
+typedef struct sim_systick_t {
+  volatile uint32_t CTRL;
+  volatile uint32_t LOAD;
+  struct val_t {
+    operator uint32_t() const;
+  } VAL;
+} sim_systick_t;
+
+extern sim_systick_t sim_SysTick;
+#define SysTick (&sim_SysTick)
+
+inline sim_systick_t::val_t::operator uint32_t() const {
+  uint64_t cycles = (uint64_t)sim_micros * (F_CPU / 1000000);
+  return sim_SysTick.LOAD - (uint32_t)(cycles % ((uint64_t)sim_SysTick.LOAD + 1));
+}
+
+// ---------------------------------------------- SAMD21 peripherals
+// a register is a word w/ an optional bitfield view, we only model the bits we touch
+typedef struct { volatile uint32_t reg; } sim_reg_t;
+typedef struct { volatile uint32_t reg; struct { uint32_t SYNCBUSY; uint32_t MC0; } bit; } sim_bitreg_t;
+
+typedef struct {
+  sim_reg_t DIRSET;
+  sim_reg_t DIRCLR;
+  sim_reg_t OUTSET;
+  sim_reg_t OUTCLR;
+  sim_reg_t IN;
+  sim_reg_t PINCFG[32];
+  sim_reg_t PMUX[16];
+} sim_portGroup_t;
+
+typedef struct { sim_portGroup_t Group[2]; } sim_port_t;
+typedef struct { sim_reg_t CLKCTRL; sim_reg_t GENCTRL; sim_bitreg_t STATUS; } sim_gclk_t;
+typedef struct { sim_reg_t APBCMASK; } sim_pm_t;
+typedef struct {
+  struct {
+    sim_reg_t CTRLA;
+    sim_bitreg_t STATUS;
+    sim_bitreg_t INTENSET;
+    sim_bitreg_t INTFLAG;
+    sim_reg_t CC[2];
+  } COUNT16;
+} sim_tc_t;
+
+extern sim_port_t sim_PORT;
+extern sim_gclk_t sim_GCLK;
+extern sim_pm_t sim_PM;
+extern sim_tc_t sim_TC5;
+
+#define PORT (&sim_PORT)
+#define GCLK (&sim_GCLK)
+#define PM (&sim_PM)
+#define TC5 (&sim_TC5)
+
+#define GCLK_CLKCTRL_CLKEN 0
+#define GCLK_CLKCTRL_GEN_GCLK4 0
+#define GCLK_CLKCTRL_ID_TC4_TC5 0
+#define PM_APBCMASK_TC5 0
+#define TC_CTRLA_MODE_COUNT16 0
+#define TC_CTRLA_WAVEGEN_MFRQ 0
+#define TC_CTRLA_PRESCALER_DIV8 0
+#define TC_CTRLA_ENABLE 0
+
+#define TC5_IRQn 0
+inline void NVIC_DisableIRQ(int irq){}
+inline void NVIC_ClearPendingIRQ(int irq){}
+inline void NVIC_SetPriority(int irq, uint32_t prio){}
+inline void NVIC_EnableIRQ(int irq){}
+
+#endif
@@ -0,0 +1,17 @@
+// host stub for the rp2040 sdk irq api, see ../Arduino.h
+#ifndef SIM_HARDWARE_IRQ_H_
+#define SIM_HARDWARE_IRQ_H_
+
+#include <stdint.h>
+
+#define TIMER_IRQ_0 0
+#define TIMER_IRQ_1 1
+#define TIMER_IRQ_2 2
+#define TIMER_IRQ_3 3
+
+typedef void (*irq_handler_t)(void);
+
+inline void irq_set_exclusive_handler(uint32_t num, irq_handler_t handler){}
+inline void irq_set_enabled(uint32_t num, bool enabled){}
+
+#endif
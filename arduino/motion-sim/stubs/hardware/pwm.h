@@ -0,0 +1,5 @@
+// host stub for the rp2040 sdk pwm api, the motion sim never drives pwm
+#ifndef SIM_HARDWARE_PWM_H_
+#define SIM_HARDWARE_PWM_H_
+
+#endif
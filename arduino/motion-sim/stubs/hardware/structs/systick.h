@@ -0,0 +1,25 @@
+// host stub for the rp2040 sdk's SysTick registers, see ../../Arduino.h
+#ifndef SIM_HARDWARE_STRUCTS_SYSTICK_H_
+#define SIM_HARDWARE_STRUCTS_SYSTICK_H_
+
+#include "Arduino.h"
+
+// as SysTick->VAL there, the current value comes from sim time, and writes to it are ignored 
+typedef struct sim_systick_hw_t {
+  volatile uint32_t csr;
+  volatile uint32_t rvr;
+  struct cvr_t {
+    operator uint32_t() const;
+    cvr_t& operator=(uint32_t val){ return *this; }
+  } cvr;
+} sim_systick_hw_t;
+
+extern sim_systick_hw_t sim_systick_hw;
+#define systick_hw (&sim_systick_hw)
+
+inline sim_systick_hw_t::cvr_t::operator uint32_t() const {
+  uint64_t cycles = (uint64_t)sim_micros * (F_CPU / 1000000);
+  return sim_systick_hw.rvr - (uint32_t)(cycles % ((uint64_t)sim_systick_hw.rvr + 1));
+}
+
+#endif
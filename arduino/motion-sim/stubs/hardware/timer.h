@@ -0,0 +1,20 @@
+// host stub for the rp2040 sdk timer, see ../Arduino.h
+#ifndef SIM_HARDWARE_TIMER_H_
+#define SIM_HARDWARE_TIMER_H_
+
+#include <stdint.h>
+
+typedef struct {
+  volatile uint32_t alarm[4];
+  volatile uint32_t timerawl;
+  volatile uint32_t intr;
+  volatile uint32_t inte;
+} sim_timer_hw_t;
+
+extern sim_timer_hw_t sim_timer_hw;
+#define timer_hw (&sim_timer_hw)
+
+inline void hw_set_bits(volatile uint32_t* addr, uint32_t mask){ *addr |= mask; }
+inline void hw_clear_bits(volatile uint32_t* addr, uint32_t mask){ *addr &= ~mask; }
+
+#endif
@@ -0,0 +1,18 @@
+// host stub for the rp2040 sdk, see ../Arduino.h
+#ifndef SIM_PICO_STDLIB_H_
+#define SIM_PICO_STDLIB_H_
+
+#include <stdint.h>
+#include "hardware/timer.h"
+
+typedef struct {
+  volatile uint32_t gpio_in;
+  volatile uint32_t gpio_out;
+  volatile uint32_t gpio_set;
+  volatile uint32_t gpio_clr;
+} sim_sio_hw_t;
+
+extern sim_sio_hw_t sim_sio_hw;
+#define sio_hw (&sim_sio_hw)
+
+#endif
@@ -14,7 +14,12 @@
 #define TXT_SIZE 1 //Define Size 
 
 #define SCREEN_ADDRESS 0x3C
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT);
+// the library would drop the bus back to 100kHz after each of its own transfers, we keep it at 400 
+Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1, 400000, 400000);
+
+#define SCREEN_PAGES (SCREEN_HEIGHT / 8)
+// the longest string we'll draw, the rest is dropped 
+#define TXT_MAX 200
 
 // message-passing memory allocation 
 #define OSAP_STACK_SIZE 10
@@ -25,27 +30,132 @@ OSAP osap("oled", messageStack, OSAP_STACK_SIZE);
 // ---------------------------------------------- 0th Vertex: OSAP USB Serial
 VPort_ArduinoSerial vp_arduinoSerial(&osap, "usbSerial", &Serial);
 
+// ---------------------------------------------- Partial Updates 
+// we draw into the library's framebuffer, but never call display.display(): we keep a copy of what's on the panel, 
+// and flushLoop() sends only the columns (in each 8-pixel page) that differ, a few bytes per loop(), so osap stays responsive 
+uint8_t shown[SCREEN_WIDTH * SCREEN_PAGES];
+boolean framebufferChanged = false;
+
+// the page we're in the middle of sending, and its remaining columns, 
+int8_t flushPage = -1;
+uint8_t flushColumn = 0;
+uint8_t flushEnd = 0;
+uint8_t scanPage = 0;
+// each data transfer is a control byte and this many, (it fits in any Wire buffer) 
+#define FLUSH_CHUNK 16
+
+void markChanged(void) {
+  framebufferChanged = true;
+}
+
+// finds the first and last columns in this page that differ from the panel, returns false if none do 
+boolean pageDiff(uint8_t page, uint8_t* first, uint8_t* last) {
+  uint8_t* buffer = display.getBuffer() + page * SCREEN_WIDTH;
+  uint8_t* panel = shown + page * SCREEN_WIDTH;
+  int16_t f = -1, l = -1;
+  for(uint8_t c = 0; c < SCREEN_WIDTH; c ++){
+    if(buffer[c] != panel[c]){
+      if(f < 0) f = c;
+      l = c;
+    }
+  }
+  if(f < 0) return false;
+  *first = f;
+  *last = l;
+  return true;
+}
+
+void flushLoop(void) {
+  if(flushPage < 0){
+    if(!framebufferChanged) return;
+    // the next page (round-robin) w/ anything to send, 
+    for(uint8_t i = 0; i < SCREEN_PAGES; i ++){
+      uint8_t page = (scanPage + i) % SCREEN_PAGES;
+      if(pageDiff(page, &flushColumn, &flushEnd)){
+        flushPage = page;
+        scanPage = (page + 1) % SCREEN_PAGES;
+        break;
+      }
+    }
+    if(flushPage < 0){
+      // everything's up to date, 
+      framebufferChanged = false;
+      return;
+    }
+    // horizontal addressing (the library sets it up), so this window is just the columns we want in one page 
+    Wire.beginTransmission(SCREEN_ADDRESS);
+    Wire.write((uint8_t)0x00);
+    Wire.write((uint8_t)SSD1306_COLUMNADDR);
+    Wire.write(flushColumn);
+    Wire.write(flushEnd);
+    Wire.write((uint8_t)SSD1306_PAGEADDR);
+    Wire.write((uint8_t)flushPage);
+    Wire.write((uint8_t)flushPage);
+    Wire.endTransmission();
+    return;
+  }
+  // then a chunk of data, 
+  uint8_t* buffer = display.getBuffer() + flushPage * SCREEN_WIDTH;
+  uint8_t* panel = shown + flushPage * SCREEN_WIDTH;
+  Wire.beginTransmission(SCREEN_ADDRESS);
+  Wire.write((uint8_t)0x40);
+  uint8_t count = 0;
+  while(count < FLUSH_CHUNK && flushColumn <= flushEnd){
+    // anything drawn behind us gets picked up on the next pass 
+    panel[flushColumn] = buffer[flushColumn];
+    Wire.write(panel[flushColumn]);
+    flushColumn ++;
+    count ++;
+  }
+  Wire.endTransmission();
+  if(flushColumn > flushEnd) flushPage = -1;
+}
+
 // ---------------------------------------------- 1th Vertex: String input Endpoint 
+char txt[TXT_MAX + 1];
+
 EP_ONDATA_RESPONSES onStringData(uint8_t* data, uint16_t len) {
+  if(len < 1) return EP_ONDATA_REJECT;
   // first byte is the text size
   uint8_t txt_size = data[0];
   // the rest is the text
   // add null terminator
-  char* txt = (char*) malloc(len);
-  memcpy(txt, data+1, len-1);
-  txt[len-1] = '\0';
+  uint16_t txt_len = min((uint16_t)(len - 1), (uint16_t)TXT_MAX);
+  memcpy(txt, data+1, txt_len);
+  txt[txt_len] = '\0';
   
   display.clearDisplay();
   display.setCursor(X_POS, Y_POS);
   display.setTextSize(txt_size);
   display.print(txt);
-  display.display();
+  markChanged();
 
   return EP_ONDATA_ACCEPT;
 }
 
 Endpoint stringEndpoint(&osap, "stringEndpoint", onStringData);
 
+// ---------------------------------------------- 2nd Vertex: Bitmap Endpoint 
+// <x (uint8), page (uint8), width (uint8), pages (uint8), width * pages bytes> in the SSD1306's own format: 
+// each byte is a column of 8 pixels (LSB on top), pages are rows of those, and they're written straight into the framebuffer 
+EP_ONDATA_RESPONSES onBitmapData(uint8_t* data, uint16_t len) {
+  if(len < 4) return EP_ONDATA_REJECT;
+  uint8_t x = data[0];
+  uint8_t page = data[1];
+  uint8_t width = data[2];
+  uint8_t pages = data[3];
+  if(x + width > SCREEN_WIDTH || page + pages > SCREEN_PAGES) return EP_ONDATA_REJECT;
+  if(len != 4 + width * pages) return EP_ONDATA_REJECT;
+  uint8_t* buffer = display.getBuffer();
+  for(uint8_t p = 0; p < pages; p ++){
+    memcpy(buffer + (page + p) * SCREEN_WIDTH + x, data + 4 + p * width, width);
+  }
+  markChanged();
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint bitmapEndpoint(&osap, "bitmapEndpoint", onBitmapData);
+
 void setup() {
   osap.init();
   vp_arduinoSerial.begin();
@@ -54,6 +164,8 @@ void setup() {
 
   display.clearDisplay();
   display.display();
+  // which is now what's on the panel, 
+  memset(shown, 0, sizeof(shown));
 
   display.clearDisplay();
   display.clearDisplay();
@@ -63,4 +175,5 @@ void setup() {
 
 void loop() {
   osap.loop();
+  flushLoop();
 }
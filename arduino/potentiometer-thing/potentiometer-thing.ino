@@ -1,6 +1,7 @@
 #include <osap.h>
 #include <vt_endpoint.h>
 #include <vp_arduinoSerial.h>
+#include <core/ts.h>
 
 #define PIN_POT1 8
 #define PIN_POT2 7
@@ -14,31 +15,95 @@ OSAP osap("potentiometer", messageStack, OSAP_STACK_SIZE);
 // ---------------------------------------------- 0th Vertex: OSAP USB Serial
 VPort_ArduinoSerial vp_arduinoSerial(&osap, "usbSerial", &Serial);
 
+// ---------------------------------------------- Sampling 
+// we read each pot continuously (alternating) at 12 bits and sum blocks of 16 reads, 
+// oversampling 16x gets us two more bits (with the ADC's noise as dither), so values are 14 bits: 0 - 16380 
+#define POT_COUNT 2
+#define POT_OVERSAMPLE 16
+#define POT_OVERSAMPLE_SHIFT 2
+
+const uint8_t potPins[POT_COUNT] = { PIN_POT1, PIN_POT2 };
+uint16_t potValues[POT_COUNT];
+uint16_t potSums[POT_COUNT];
+uint8_t potSampleCount = 0;
+uint8_t potIndex = 0;
+
+uint32_t potSampleInterval = 250;   // us, between reads (of either pot) 
+uint32_t lastPotSample = 0;
+
+// pushes go out when either value moves this far (in 14-bit counts) from what we last pushed, 0 turns them off 
+uint16_t potDeadband = 16;
+uint16_t potPushed[POT_COUNT];
+
+void writePotValues(uint8_t* buf, uint16_t* wptr) {
+  for(uint8_t p = 0; p < POT_COUNT; p ++){
+    ts_writeUint16(potValues[p], buf, wptr);
+  }
+}
+
 // ---------------------------------------------- 1 Vertex
+// returns <pot1, pot2 (uint16, 14 bits)> from the latest filtered values 
 boolean prePotQuery(void);
 
 Endpoint tofEndpoint(&osap, "potentiometerQuery", prePotQuery);
 
 boolean prePotQuery(void) {
-  uint8_t buf[4];
-  uint16_t value1 = analogRead(PIN_POT1);
-  uint16_t value2 = analogRead(PIN_POT2);
-  buf[0] = value1 & 0xFF;
-  buf[1] = value1 >> 8 & 0xFF;
-  buf[2] = value2 & 0xFF;
-  buf[3] = value2 >> 8 & 0xFF;
-  tofEndpoint.write(buf, 4);
+  uint8_t buf[POT_COUNT * 2];
+  uint16_t wptr = 0;
+  writePotValues(buf, &wptr);
+  tofEndpoint.write(buf, wptr);
   return true;
 }
 
+// ---------------------------------------------- 2nd Vertex: Change Endpoint 
+// pushes <pot1, pot2> as above, when either one moves past the deadband 
+Endpoint changeEndpoint(&osap, "potentiometerChange");
+
+// ---------------------------------------------- 3rd Vertex: Deadband 
+EP_ONDATA_RESPONSES onDeadbandData(uint8_t* data, uint16_t len) {
+  uint16_t rptr = 0;
+  potDeadband = ts_readUint16(data, &rptr);
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint deadbandEndpoint(&osap, "potentiometerDeadband", onDeadbandData);
+
+void potLoop(void) {
+  if(micros() - lastPotSample < potSampleInterval) return;
+  lastPotSample = micros();
+  potSums[potIndex] += analogRead(potPins[potIndex]);
+  potIndex ++;
+  if(potIndex < POT_COUNT) return;
+  potIndex = 0;
+  potSampleCount ++;
+  if(potSampleCount < POT_OVERSAMPLE) return;
+  potSampleCount = 0;
+  // a whole block, for each pot, 
+  boolean moved = false;
+  for(uint8_t p = 0; p < POT_COUNT; p ++){
+    potValues[p] = potSums[p] >> POT_OVERSAMPLE_SHIFT;
+    potSums[p] = 0;
+    if(abs((int32_t)potValues[p] - (int32_t)potPushed[p]) >= potDeadband) moved = true;
+  }
+  if(moved && potDeadband > 0){
+    uint8_t buf[POT_COUNT * 2];
+    uint16_t wptr = 0;
+    writePotValues(buf, &wptr);
+    changeEndpoint.write(buf, wptr);
+    for(uint8_t p = 0; p < POT_COUNT; p ++) potPushed[p] = potValues[p];
+  }
+}
+
 void setup() {
   osap.init();
   vp_arduinoSerial.begin();
 
   pinMode(PIN_POT1, INPUT);
   pinMode(PIN_POT2, INPUT);
+  analogReadResolution(12);
 }
 
 void loop() {
   osap.loop();
+  potLoop();
 }
@@ -1,6 +1,7 @@
 #include <osap.h>
 #include <vt_endpoint.h>
 #include <vp_arduinoSerial.h>
+#include <core/ts.h>
 
 // ---------------------------------------------- Pins
 #define PIN_R 14
@@ -17,12 +18,111 @@ OSAP osap("rgbb", messageStack, OSAP_STACK_SIZE);
 // ---------------------------------------------- 0th Vertex: OSAP USB Serial
 VPort_ArduinoSerial vp_arduinoSerial(&osap, "usbSerial", &Serial);
 
+// ---------------------------------------------- Output 
+// what's on the pins (as PWM values, i.e. after the js' inversion), animations start from here 
+uint8_t rgbNow[3] = { 255, 255, 255 };
+
+void writeRGB(uint8_t* rgb){
+  for(uint8_t c = 0; c < 3; c ++) rgbNow[c] = rgb[c];
+  analogWrite(PIN_R, rgb[0]);
+  analogWrite(PIN_G, rgb[1]);
+  analogWrite(PIN_B, rgb[2]);
+}
+
+// ---------------------------------------------- Animation 
+// a short list of keyframes, each one eases from the last color to its own over its duration, 
+// then the whole thing repeats some number of times (or forever), and we hold the last color when it's done 
+#define KEYFRAME_MAX 16
+#define EASE_STEP 0       // jump to the color, and hold it for the duration 
+#define EASE_LINEAR 1
+#define EASE_IN_OUT 2
+#define EASE_IN 3
+#define EASE_OUT 4
+
+typedef struct keyframe_t {
+  uint8_t rgb[3];
+  uint16_t duration;    // ms 
+  uint8_t easing;
+} keyframe_t;
+
+keyframe_t keyframes[KEYFRAME_MAX];
+uint8_t keyframeCount = 0;
+uint8_t animationLoops = 0;   // 0 is forever 
+
+boolean animating = false;
+uint8_t animationFrame = 0;
+uint8_t animationPass = 0;
+uint32_t frameStart = 0;
+uint8_t frameFrom[3];
+
+// we update the LEDs at this interval, and interpolate from the actual time, so a slow loop() doesn't stretch anything 
+uint32_t animationInterval = 10;   // ms 
+uint32_t lastAnimationUpdate = 0;
+
+// t and the result are 0.16, 
+uint32_t ease(uint8_t easing, uint32_t t){
+  switch(easing){
+    case EASE_STEP:
+      return 65536;
+    case EASE_IN_OUT:
+      // smoothstep, t^2 * (3 - 2t) 
+      return (uint32_t)(((uint64_t)((t * t) >> 16) * ((3 << 16) - 2 * t)) >> 16);
+    case EASE_IN:
+      return (t * t) >> 16;
+    case EASE_OUT:
+      return 65536 - (uint32_t)(((uint64_t)(65536 - t) * (65536 - t)) >> 16);
+    case EASE_LINEAR:
+    default:
+      return t;
+  }
+}
+
+void startAnimation(void){
+  if(keyframeCount == 0) return;
+  animationFrame = 0;
+  animationPass = 0;
+  frameStart = millis();
+  for(uint8_t c = 0; c < 3; c ++) frameFrom[c] = rgbNow[c];
+  animating = true;
+}
+
+void animationLoop(void){
+  if(!animating) return;
+  if(millis() - lastAnimationUpdate < animationInterval) return;
+  lastAnimationUpdate = millis();
+  // catch up thru any frames that have finished, 
+  while(millis() - frameStart >= keyframes[animationFrame].duration){
+    frameStart += keyframes[animationFrame].duration;
+    for(uint8_t c = 0; c < 3; c ++) frameFrom[c] = keyframes[animationFrame].rgb[c];
+    animationFrame ++;
+    if(animationFrame >= keyframeCount){
+      animationFrame = 0;
+      animationPass ++;
+      if(animationLoops != 0 && animationPass >= animationLoops){
+        animating = false;
+        writeRGB(frameFrom);
+        return;
+      }
+    }
+  }
+  // and interpolate in this one, 
+  keyframe_t* frame = &keyframes[animationFrame];
+  uint32_t t = ((millis() - frameStart) << 16) / frame->duration;
+  uint32_t e = ease(frame->easing, t);
+  uint8_t rgb[3];
+  for(uint8_t c = 0; c < 3; c ++){
+    int32_t delta = (int32_t)frame->rgb[c] - (int32_t)frameFrom[c];
+    rgb[c] = frameFrom[c] + ((delta * (int32_t)e) >> 16);
+  }
+  writeRGB(rgb);
+}
+
 // ---------------------------------------------- 1th Vertex: RGB Inputs Endpoint 
 EP_ONDATA_RESPONSES onRGBData(uint8_t* data, uint16_t len){
-  // we did the float -> int conversion in js 
-  analogWrite(PIN_R, data[0]);
-  analogWrite(PIN_G, data[1]);
-  analogWrite(PIN_B, data[2]);
+  // we did the float -> int conversion in js, 
+  // and setting a color directly cancels any animation 
+  animating = false;
+  writeRGB(data);
   return EP_ONDATA_ACCEPT;
 }
 
@@ -31,6 +131,47 @@ Endpoint rgbEndpoint(&osap, "rgbValues", onRGBData);
 // ---------------------------------------------- 2nd Vertex: Button Endpoint 
 Endpoint buttonEndpoint(&osap, "buttonState");
 
+// ---------------------------------------------- 3rd Vertex: Animation Upload 
+// <flags (uint8), loops (uint8, 0 is forever), count (uint8), count * <r, g, b (uint8), duration (uint16, ms), easing (uint8)>>, 
+// flags bit 0 starts it right away, otherwise it waits for a trigger 
+#define ANIMATION_FLAG_START 1
+#define KEYFRAME_BYTES 6
+
+EP_ONDATA_RESPONSES onAnimationData(uint8_t* data, uint16_t len){
+  if(len < 3) return EP_ONDATA_REJECT;
+  uint16_t rptr = 0;
+  uint8_t flags = data[rptr ++];
+  uint8_t loops = data[rptr ++];
+  uint8_t count = data[rptr ++];
+  if(count == 0 || count > KEYFRAME_MAX || len != 3 + count * KEYFRAME_BYTES) return EP_ONDATA_REJECT;
+  animating = false;
+  for(uint8_t k = 0; k < count; k ++){
+    for(uint8_t c = 0; c < 3; c ++) keyframes[k].rgb[c] = data[rptr ++];
+    keyframes[k].duration = max(ts_readUint16(data, &rptr), (uint16_t)1);
+    keyframes[k].easing = data[rptr ++];
+  }
+  keyframeCount = count;
+  animationLoops = loops;
+  if(flags & ANIMATION_FLAG_START) startAnimation();
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint animationEndpoint(&osap, "animationKeyframes", onAnimationData);
+
+// ---------------------------------------------- 4th Vertex: Animation Trigger 
+// 1 (re)starts the uploaded animation from its first keyframe, 0 cancels it (and holds whatever color it was at) 
+EP_ONDATA_RESPONSES onTriggerData(uint8_t* data, uint16_t len){
+  if(len < 1) return EP_ONDATA_REJECT;
+  if(data[0] > 0){
+    startAnimation();
+  } else {
+    animating = false;
+  }
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint triggerEndpoint(&osap, "animationTrigger", onTriggerData);
+
 void setup() {
   // uuuh... 
   osap.init();
@@ -55,6 +196,8 @@ boolean lastButtonState = false;
 void loop() {
   // do graph stuff
   osap.loop();
+  // and lights, 
+  animationLoop();
   // debounce and set button states, 
   if(lastButtonCheck + debounceDelay < millis()){
     lastButtonCheck = millis();
@@ -3,6 +3,7 @@
 #include <vp_arduinoSerial.h>
 #include <core/ts.h>
 #include <Servo.h>
+#include <motionStateMachine.h>
 
 #define PIN_SERVO 8
 
@@ -17,10 +18,42 @@ OSAP osap("servo", messageStack, OSAP_STACK_SIZE);
 // ---------------------------------------------- 0th Vertex: OSAP USB Serial
 VPort_ArduinoSerial vp_arduinoSerial(&osap, "usbSerial", &Serial);
 
+// ---------------------------------------------- profiled pulses 
+// the motion core's trapezoidal integrator runs here in microseconds of pulse width, and each 50Hz frame 
+// we hand the servo wherever the profile is, so a smooth move is one packet and the slew (i.e. current draw) is limited 
+#define SERVO_PULSE_CENTER 1500
+#define SERVO_FRAME_MS 20
+#define SERVO_DEFAULT_MAX_VEL 2000.0F     // us / sec 
+#define SERVO_DEFAULT_MAX_ACCEL 8000.0F   // us / sec^2 
+
+// the integrator calls this per microsecond, but we read its position once a frame instead 
+void stepper_step(boolean dir) { }
+
+uint32_t lastFrame = 0;
+uint16_t lastPulse = SERVO_PULSE_CENTER;
+
+void frameLoop(void) {
+  if(millis() - lastFrame < SERVO_FRAME_MS) return;
+  lastFrame = millis();
+  motionState_t state;
+  motion_getCurrentStates(&state);
+  uint16_t pulse = constrain(lroundf(state.pos), 0, 65535);
+  if(pulse != lastPulse){
+    lastPulse = pulse;
+    servo.writeMicroseconds(pulse);
+  }
+}
+
 // ---------------------------------------------- 1th Vertex: String input Endpoint 
+// a pulse width (uint16, us), which we jump to, (the profile picks up from there) 
 EP_ONDATA_RESPONSES onServoData(uint8_t* data, uint16_t len) {
-  uint16_t pulse_us = ts_readUint16(data, 0);
+  if(motion_getCommandSpace() < 2) return EP_ONDATA_WAIT;
+  uint16_t rptr = 0;
+  uint16_t pulse_us = ts_readUint16(data, &rptr);
 
+  motion_setPosition(pulse_us);
+  motion_setPositionTarget(pulse_us, SERVO_DEFAULT_MAX_VEL, SERVO_DEFAULT_MAX_ACCEL);
+  lastPulse = pulse_us;
   servo.writeMicroseconds(pulse_us);
 
   return EP_ONDATA_ACCEPT;
@@ -28,12 +61,72 @@ EP_ONDATA_RESPONSES onServoData(uint8_t* data, uint16_t len) {
 
 Endpoint stringEndpoint(&osap, "servoEndpoint", onServoData);
 
+// ---------------------------------------------- 2nd Vertex
+// as the stepper's targetState: <mode (uint8), pos (float32), maxVel, maxAccel> or <mode, vel, maxAccel>, in us and seconds 
+EP_ONDATA_RESPONSES onTargetData(uint8_t* data, uint16_t len) {
+  if(motion_getCommandSpace() == 0) return EP_ONDATA_WAIT;
+  uint16_t pt = 1;
+  if(data[0] == MOTION_MODE_POS){
+    float targ = ts_readFloat32(data, &pt);
+    float maxVel = ts_readFloat32(data, &pt);
+    float maxAccel = ts_readFloat32(data, &pt);
+    motion_setPositionTarget(targ, maxVel, maxAccel);
+  } else if (data[0] == MOTION_MODE_VEL){
+    float targ = ts_readFloat32(data, &pt);
+    float maxAccel = ts_readFloat32(data, &pt);
+    motion_setVelocityTarget(targ, maxAccel);
+  } else {
+    return EP_ONDATA_REJECT;
+  }
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint targetEndpoint(&osap, "targetState", onTargetData);
+
+// ---------------------------------------------- 3rd Vertex
+// as the stepper's motionState, and then a done flag (uint8): the profile is stopped at its target, and nothing's waiting 
+boolean beforeMotionStateQuery(void);
+
+Endpoint motionStateEndpoint(&osap, "motionState", beforeMotionStateQuery);
+
+uint8_t motionStateData[33];
+
+boolean beforeMotionStateQuery(void) {
+  motionState_t state;
+  motion_getCurrentStates(&state);
+  boolean done = (state.vel == 0.0F && fabsf(state.distanceToTarget) < 1.0F && motion_getCommandSpace() == MOTION_COMMAND_SIZE - 1);
+  uint16_t wptr = 0;
+  ts_writeFloat32(state.pos, motionStateData, &wptr);
+  ts_writeFloat32(state.vel, motionStateData, &wptr);
+  ts_writeFloat32(state.accel, motionStateData, &wptr);
+  ts_writeFloat32(state.distanceToTarget, motionStateData, &wptr);
+  ts_writeFloat32(state.maxVel, motionStateData, &wptr);
+  ts_writeFloat32(state.maxAccel, motionStateData, &wptr);
+  ts_writeFloat32(state.twoDA, motionStateData, &wptr);
+  ts_writeFloat32(state.vSquared, motionStateData, &wptr);
+  motionStateData[wptr ++] = done ? 1 : 0;
+  motionStateEndpoint.write(motionStateData, wptr);
+  return true;
+}
+
 void setup() {
   osap.init();
   vp_arduinoSerial.begin();
   servo.attach(PIN_SERVO);
+  // the motion core clocks TC4 and TC5 from GCLK4, which we start here at 48MHz: that's the same as the servo library 
+  // sets up for its own timer (TC4), so that keeps working, and the integrator takes TC5 
+  GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(4)|
+                      GCLK_GENCTRL_GENEN |
+                      GCLK_GENCTRL_SRC_DFLL48M |
+                      GCLK_GENCTRL_IDC;
+  while(GCLK->STATUS.bit.SYNCBUSY);
+  // at 10kHz, it tops out at 10k us / sec, 
+  motion_init(100);
+  motion_setPosition(SERVO_PULSE_CENTER);
+  motion_setPositionTarget(SERVO_PULSE_CENTER, SERVO_DEFAULT_MAX_VEL, SERVO_DEFAULT_MAX_ACCEL);
 }
 
 void loop() {
   osap.loop();
+  frameLoop();
 }
@@ -1,4 +1,4 @@
-#include "motionStateMachine.h"
+#include <motionStateMachine.h>
 #include "stepperDriver.h"
 #include <osap.h>
 #include <vt_endpoint.h>
@@ -16,17 +16,40 @@ VPort_ArduinoSerial vp_arduinoSerial(&osap, "usbSerial", &Serial);
 
 // ---------------------------------------------- 1th Vertex: Target Requests (pos, or velocity)
 EP_ONDATA_RESPONSES onTargetData(uint8_t* data, uint16_t len){
-  uint16_t wptr = 0;
-  // there's no value in getting clever here: we have two possible requests...
-  if(data[wptr ++] == MOTION_MODE_POS){
+  // targets are handed to the integrator thru a little queue, if that's full, hang on 
+  if(motion_getCommandSpace() == 0) return EP_ONDATA_WAIT;
+  uint16_t wptr = 1;
+  // there's no value in getting clever here: we have three possible requests... 
+  // any of which may have a trailing "execute at" time, on the host's clock (see the timeSync vertex) 
+  uint32_t executeAt = 0;
+  if(data[0] == MOTION_MODE_POS){
+    float targ = ts_readFloat32(data, &wptr);
+    float maxVel = ts_readFloat32(data, &wptr);
+    float maxAccel = ts_readFloat32(data, &wptr);
+    if(wptr + 4 <= len && motion_hostToDeviceTime(ts_readUint32(data, &wptr), &executeAt)){
+      motion_setPositionTargetAt(targ, maxVel, maxAccel, executeAt);
+    } else {
+      motion_setPositionTarget(targ, maxVel, maxAccel);
+    }
+  } else if (data[0] == MOTION_MODE_SCURVE){
+    // a position w/ a jerk limit as well 
     float targ = ts_readFloat32(data, &wptr);
     float maxVel = ts_readFloat32(data, &wptr);
     float maxAccel = ts_readFloat32(data, &wptr);
-    motion_setPositionTarget(targ, maxVel, maxAccel);
-  } else if (data[wptr ++] == MOTION_MODE_VEL){
+    float maxJerk = ts_readFloat32(data, &wptr);
+    if(wptr + 4 <= len && motion_hostToDeviceTime(ts_readUint32(data, &wptr), &executeAt)){
+      motion_setPositionTargetJerkAt(targ, maxVel, maxAccel, maxJerk, executeAt);
+    } else {
+      motion_setPositionTargetJerk(targ, maxVel, maxAccel, maxJerk);
+    }
+  } else if (data[0] == MOTION_MODE_VEL){
     float targ = ts_readFloat32(data, &wptr);
     float maxAccel = ts_readFloat32(data, &wptr);
-    motion_setVelocityTarget(targ, maxAccel);
+    if(wptr + 4 <= len && motion_hostToDeviceTime(ts_readUint32(data, &wptr), &executeAt)){
+      motion_setVelocityTargetAt(targ, maxAccel, executeAt);
+    } else {
+      motion_setVelocityTarget(targ, maxAccel);
+    }
   }
   return EP_ONDATA_ACCEPT;
 }
@@ -41,16 +64,33 @@ boolean beforeMotionStateQuery(void);
 
 Endpoint stateEndpoint(&osap, "motionState", onMotionStateData, beforeMotionStateQuery);
 
-uint8_t stateData[12];
+// the frame is <pos, vel, accel, distanceToTarget, maxVel, maxAccel, twoDA, vSquared (float32), pending (uint8), eventCount (uint32)>,
+// if you add to it, add to this length too, and the assert keeps it inside the buffer
+#define MOTION_STATE_FRAME_LEN (8 * 4 + 1 + 4)
+uint8_t stateData[64];
+static_assert(MOTION_STATE_FRAME_LEN <= sizeof(stateData), "motionState frame doesn't fit in stateData");
 
 boolean beforeMotionStateQuery(void){
+  // commands still in the ring (i.e. a timed target that hasn't started yet) go first, so that vel == 0 w/ nothing pending means we're really at rest
+  uint8_t pending = MOTION_COMMAND_SIZE - 1 - motion_getCommandSpace();
+  // then the event count, so that if nothing's pending, rest events numbered from here are about the current target
+  uint32_t eventCount = motion_getEventCount();
   motionState_t state;
   motion_getCurrentStates(&state);
   uint16_t rptr = 0;
   ts_writeFloat32(state.pos, stateData, &rptr);
   ts_writeFloat32(state.vel, stateData, &rptr);
   ts_writeFloat32(state.accel, stateData, &rptr);
-  stateEndpoint.write(stateData, 12);
+  ts_writeFloat32(state.distanceToTarget, stateData, &rptr);
+  ts_writeFloat32(state.maxVel, stateData, &rptr);
+  ts_writeFloat32(state.maxAccel, stateData, &rptr);
+  ts_writeFloat32(state.twoDA, stateData, &rptr);
+  ts_writeFloat32(state.vSquared, stateData, &rptr);
+  stateData[rptr ++] = pending;
+  ts_writeUint32(eventCount, stateData, &rptr);
+  // (and if it's grown without that, we'd rather send nothing than a frame the host misreads)
+  if(rptr != MOTION_STATE_FRAME_LEN) return false;
+  stateEndpoint.write(stateData, rptr);
   // in-fill current posn, velocity, and acceleration
   return true;
 }
@@ -60,6 +100,7 @@ EP_ONDATA_RESPONSES onPositionSetData(uint8_t* data, uint16_t len){
   // should do maxAccel, maxVel, and (optionally) setPosition
   // upstream should've though of this, so,
   uint16_t rptr = 0;
+  if(motion_getCommandSpace() == 0) return EP_ONDATA_WAIT;
   float pos = ts_readFloat32(data, &rptr);
   motion_setPosition(pos);
   return EP_ONDATA_ACCEPT;
@@ -70,40 +111,315 @@ Endpoint positionSetEndpoint(&osap, "setPosition", onPositionSetData);
 // ---------------------------------------------- 4th Vertex: Settings catch-all,
 
 EP_ONDATA_RESPONSES onSettingsData(uint8_t* data, uint16_t len){
-  // it's just <cscale> for the time being,
+  // it's <cscale, (microsteps)>, the latter as 1/n of a full step: 1 thru 64, in powers of two,
+  // our positions are in microsteps, so the host should re-set those (at rest) when it changes this
   uint16_t rptr = 0;
   float cscale = ts_readFloat32(data, &rptr);
+  if(len > rptr && !stepper_setMicrosteps(data[rptr])) return EP_ONDATA_REJECT;
   stepper_setCScale(cscale);
   return EP_ONDATA_ACCEPT;
 }
 
 Endpoint settingsEndpoint(&osap, "settings", onSettingsData);
 
-// ---------------------------------------------- 5th Vertex: Limit / Switch Output... non-op at the moment,
+// ---------------------------------------------- 5th Vertex: Limit / Switch Output
 
-// fair warning, this is unused at the moment... and not set-up,
-// also the limit pin is config'd to look at the interrupt on a scope at the moment, see motionStateMachine.cpp
+// the debounced state goes out from the loop, but the press edge also goes straight to the integrator,
+// from a pin interrupt, see the 11th vertex
 Endpoint buttonEndpoint(&osap, "buttonState");
 
+void onLimitEdge(void){
+  motion_limitTrigger();
+}
+
+// ---------------------------------------------- 6th Vertex: Segment Queue, for sequential motion
+// each segment is <end, maxVel, maxAccel, pathLength, junctionVel>, and we can take a few per packet:
+// w/ a zero pathLength it's our own move, as a position target, otherwise it's our share of a synchronizer's line,
+// and the rates (and the fastest we can take the corner into it) are along that line, see motion_addPathSegment()
+#define SEGMENT_BYTES 20
+
+EP_ONDATA_RESPONSES onSegmentData(uint8_t* data, uint16_t len){
+  uint16_t count = len / SEGMENT_BYTES;
+  // we'll never fit this,
+  if(count >= MOTION_QUEUE_SIZE) return EP_ONDATA_REJECT;
+  // this is our flow control: the packet waits in the stack 'till the integrator makes some room
+  if(motion_getQueueSpace() < count) return EP_ONDATA_WAIT;
+  // and the first one takes a command slot, to swap the integrator into the queue (it's simplest to always have one)
+  if(motion_getCommandSpace() == 0) return EP_ONDATA_WAIT;
+  uint16_t rptr = 0;
+  for(uint16_t s = 0; s < count; s ++){
+    float end = ts_readFloat32(data, &rptr);
+    float maxVel = ts_readFloat32(data, &rptr);
+    float maxAccel = ts_readFloat32(data, &rptr);
+    float pathLength = ts_readFloat32(data, &rptr);
+    float junctionVel = ts_readFloat32(data, &rptr);
+    if(pathLength > 0.0F){
+      motion_addPathSegment(end, pathLength, maxVel, maxAccel, junctionVel);
+    } else {
+      motion_addSegment(end, maxVel, maxAccel);
+    }
+  }
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint segmentEndpoint(&osap, "segmentQueue", onSegmentData);
+
+// ---------------------------------------------- 7th Vertex: Motion Telemetry 
+// the integrator samples its states every n'th tick, we ship those up in batches from the loop, 
+// writing to this endpoint sets the decimation (as a uint16, in ticks per sample), 0 turns it off 
+EP_ONDATA_RESPONSES onTelemetryData(uint8_t* data, uint16_t len){
+  uint16_t rptr = 0;
+  uint16_t decimation = ts_readUint16(data, &rptr);
+  motion_setTelemetryDecimation(decimation);
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint telemetryEndpoint(&osap, "motionTelemetry", onTelemetryData);
+
+// frames are <sampleNum (uint32), count (uint8), count * <pos, vel, accel> (float32)> 
+uint8_t telemetryData[5 + MOTION_TELEMETRY_BATCH * 12];
+motionSample_t telemetryBatch[MOTION_TELEMETRY_BATCH];
+
+// partial batches go out after this long, so that slow sample rates still trickle in, 
+uint32_t telemetryFlushInterval = 50;
+uint32_t lastTelemetryFlush = 0;
+
+void telemetryLoop(void){
+  uint8_t available = motion_getTelemetryCount();
+  if(available == 0) return;
+  if(available < MOTION_TELEMETRY_BATCH && lastTelemetryFlush + telemetryFlushInterval > millis()) return;
+  lastTelemetryFlush = millis();
+  uint8_t count = motion_drainTelemetry(telemetryBatch, MOTION_TELEMETRY_BATCH);
+  uint16_t wptr = 0;
+  ts_writeUint32(telemetryBatch[0].sampleNum, telemetryData, &wptr);
+  telemetryData[wptr ++] = count;
+  for(uint8_t s = 0; s < count; s ++){
+    ts_writeFloat32(telemetryBatch[s].pos, telemetryData, &wptr);
+    ts_writeFloat32(telemetryBatch[s].vel, telemetryData, &wptr);
+    ts_writeFloat32(telemetryBatch[s].accel, telemetryData, &wptr);
+  }
+  telemetryEndpoint.write(telemetryData, wptr);
+}
+
+// ---------------------------------------------- 8th Vertex: Time Sync 
+// the host queries our clock (in microseconds), and times the round trip: 
+// then it writes back <hostTime, deviceTime> for its best exchange, i.e. what time it was on its clock when ours read deviceTime 
+EP_ONDATA_RESPONSES onTimeSyncData(uint8_t* data, uint16_t len){
+  uint16_t rptr = 0;
+  uint32_t hostTime = ts_readUint32(data, &rptr);
+  uint32_t deviceTime = ts_readUint32(data, &rptr);
+  motion_syncClock(hostTime, deviceTime);
+  return EP_ONDATA_ACCEPT;
+}
+
+boolean beforeTimeSyncQuery(void);
+
+Endpoint timeSyncEndpoint(&osap, "timeSync", onTimeSyncData, beforeTimeSyncQuery);
+
+boolean beforeTimeSyncQuery(void){
+  uint8_t timeData[4];
+  uint16_t wptr = 0;
+  ts_writeUint32(motion_getTime(), timeData, &wptr);
+  timeSyncEndpoint.write(timeData, wptr);
+  return true;
+}
+
+// ---------------------------------------------- 9th Vertex: Group Targets
+// one frame w/ targets for a few axes, and we pick out our own slice (the host only sends us ours, since we're each on our own link,
+// but on a bus, one frame could go to everyone),
+// <u8 mode, u8 count, u8 timed, (u32 executeAt, if timed)> then count x <u8 axis, f32 targ, (f32 maxVel, if pos), f32 maxAccel, (f32 maxJerk, if s-curve)>
+// or <GROUP_ASSIGN_AXIS, u8 axis> to tell us which axis we are, 'till then we ignore group frames
+#define GROUP_ASSIGN_AXIS 255
+#define GROUP_AXIS_NONE 255
+
+uint8_t groupAxis = GROUP_AXIS_NONE;
+
+EP_ONDATA_RESPONSES onGroupTargetData(uint8_t* data, uint16_t len){
+  if(len < 2) return EP_ONDATA_REJECT;
+  if(data[0] == GROUP_ASSIGN_AXIS){
+    groupAxis = data[1];
+    return EP_ONDATA_ACCEPT;
+  }
+  if(len < 3 || (data[0] != MOTION_MODE_POS && data[0] != MOTION_MODE_SCURVE && data[0] != MOTION_MODE_VEL)) return EP_ONDATA_REJECT;
+  uint8_t count = data[1];
+  boolean timed = data[2];
+  uint16_t rptr = 3;
+  uint32_t hostTime = 0;
+  if(timed){
+    if(len < 7) return EP_ONDATA_REJECT;
+    hostTime = ts_readUint32(data, &rptr);
+  }
+  // slices are <u8 axis, f32 pos, f32 vel, f32 accel>, w/ f32 jerk on the end for s-curves, or <u8 axis, f32 vel, f32 accel>
+  uint16_t sliceBytes = (data[0] == MOTION_MODE_POS) ? 13 : ((data[0] == MOTION_MODE_SCURVE) ? 17 : 9);
+  if(rptr + count * sliceBytes > len) return EP_ONDATA_REJECT;
+  // find our slice, if we aren't in this frame, it's someone else's move
+  uint8_t a = 0;
+  for(; a < count; a ++){
+    if(data[rptr] == groupAxis) break;
+    rptr += sliceBytes;
+  }
+  if(groupAxis == GROUP_AXIS_NONE || a == count) return EP_ONDATA_ACCEPT;
+  // same flow control as the 1th vertex,
+  if(motion_getCommandSpace() == 0) return EP_ONDATA_WAIT;
+  rptr ++;
+  uint32_t executeAt = 0;
+  timed = timed && motion_hostToDeviceTime(hostTime, &executeAt);
+  if(data[0] == MOTION_MODE_POS){
+    float targ = ts_readFloat32(data, &rptr);
+    float maxVel = ts_readFloat32(data, &rptr);
+    float maxAccel = ts_readFloat32(data, &rptr);
+    if(timed){
+      motion_setPositionTargetAt(targ, maxVel, maxAccel, executeAt);
+    } else {
+      motion_setPositionTarget(targ, maxVel, maxAccel);
+    }
+  } else if(data[0] == MOTION_MODE_SCURVE){
+    float targ = ts_readFloat32(data, &rptr);
+    float maxVel = ts_readFloat32(data, &rptr);
+    float maxAccel = ts_readFloat32(data, &rptr);
+    float maxJerk = ts_readFloat32(data, &rptr);
+    if(timed){
+      motion_setPositionTargetJerkAt(targ, maxVel, maxAccel, maxJerk, executeAt);
+    } else {
+      motion_setPositionTargetJerk(targ, maxVel, maxAccel, maxJerk);
+    }
+  } else {
+    float targ = ts_readFloat32(data, &rptr);
+    float maxAccel = ts_readFloat32(data, &rptr);
+    if(timed){
+      motion_setVelocityTargetAt(targ, maxAccel, executeAt);
+    } else {
+      motion_setVelocityTarget(targ, maxAccel);
+    }
+  }
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint groupTargetEndpoint(&osap, "groupTarget", onGroupTargetData);
+
+// ---------------------------------------------- 10th Vertex: Motion Timing
+// the integrator's ISR times itself (in cpu cycles), queries get the stats and writes (of anything) start them over,
+// <u32 cpuHz, u32 tickCycles, u32 count,
+//  u32 costMin, u32 costMax, f32 costMean, u32 costHist[8],
+//  u32 intervalMin, u32 intervalMax, f32 intervalMean, u32 intervalHist[8]>
+EP_ONDATA_RESPONSES onTimingData(uint8_t* data, uint16_t len){
+  motion_resetTiming();
+  return EP_ONDATA_ACCEPT;
+}
+
+boolean beforeTimingQuery(void);
+
+Endpoint timingEndpoint(&osap, "motionTiming", onTimingData, beforeTimingQuery);
+
+uint8_t timingData[12 + 2 * (12 + 4 * MOTION_TIMING_BINS)];
+
+boolean beforeTimingQuery(void){
+  motionTiming_t timing;
+  motion_getTiming(&timing);
+  uint16_t wptr = 0;
+  ts_writeUint32(timing.cpuHz, timingData, &wptr);
+  ts_writeUint32(timing.tickCycles, timingData, &wptr);
+  ts_writeUint32(timing.count, timingData, &wptr);
+  ts_writeUint32(timing.costMin, timingData, &wptr);
+  ts_writeUint32(timing.costMax, timingData, &wptr);
+  ts_writeFloat32(timing.costMean, timingData, &wptr);
+  for(uint8_t b = 0; b < MOTION_TIMING_BINS; b ++){
+    ts_writeUint32(timing.costHist[b], timingData, &wptr);
+  }
+  ts_writeUint32(timing.intervalMin, timingData, &wptr);
+  ts_writeUint32(timing.intervalMax, timingData, &wptr);
+  ts_writeFloat32(timing.intervalMean, timingData, &wptr);
+  for(uint8_t b = 0; b < MOTION_TIMING_BINS; b ++){
+    ts_writeUint32(timing.intervalHist[b], timingData, &wptr);
+  }
+  timingEndpoint.write(timingData, wptr);
+  return true;
+}
+
+// ---------------------------------------------- 11th Vertex: Homing & Limits
+// <HOMING_START, f32 seekVel, f32 latchVel, f32 maxAccel, f32 backoff, f32 maxTravel> homes on the limit switch,
+// seekVel's sign is the direction, and the integrator does the rest, see motion_home()
+// <HOMING_LIMIT_STOP, u8 enable> has limit hits stop us dead, when we aren't homing
+// queries get <u8 phase, u8 switchDown, u32 limitCount, f32 limitPos>
+#define HOMING_START 0
+#define HOMING_LIMIT_STOP 1
+
+EP_ONDATA_RESPONSES onHomingData(uint8_t* data, uint16_t len){
+  if(len < 2) return EP_ONDATA_REJECT;
+  if(data[0] == HOMING_LIMIT_STOP){
+    motion_setLimitStop(data[1]);
+    return EP_ONDATA_ACCEPT;
+  }
+  if(data[0] != HOMING_START || len < 21) return EP_ONDATA_REJECT;
+  if(motion_getCommandSpace() == 0) return EP_ONDATA_WAIT;
+  uint16_t rptr = 1;
+  float seekVel = ts_readFloat32(data, &rptr);
+  float latchVel = ts_readFloat32(data, &rptr);
+  float maxAccel = ts_readFloat32(data, &rptr);
+  float backoff = ts_readFloat32(data, &rptr);
+  float maxTravel = ts_readFloat32(data, &rptr);
+  motion_home(seekVel, latchVel, maxAccel, backoff, maxTravel);
+  // if we're sitting on the switch already, there's no edge coming, so we make one
+  if(!digitalRead(PIN_BUT)) motion_limitTrigger();
+  return EP_ONDATA_ACCEPT;
+}
+
+boolean beforeHomingQuery(void);
+
+Endpoint homingEndpoint(&osap, "homing", onHomingData, beforeHomingQuery);
+
+boolean beforeHomingQuery(void){
+  motionLimitState_t limit;
+  motion_getLimitState(&limit);
+  uint8_t homingData[10];
+  uint16_t wptr = 0;
+  homingData[wptr ++] = limit.homePhase;
+  homingData[wptr ++] = !digitalRead(PIN_BUT);
+  ts_writeUint32(limit.limitCount, homingData, &wptr);
+  ts_writeFloat32(limit.limitPos, homingData, &wptr);
+  homingEndpoint.write(homingData, wptr);
+  return true;
+}
+
+// ---------------------------------------------- 12th Vertex: Motion Events
+// the integrator says when it's reached a target (or a velocity), hit a limit, or given up on something,
+// and we push those out as they happen, routed like the buttonState, so that the host doesn't have to poll
+// <u8 type, u8 code, u32 eventNum, f32 pos, f32 vel>, see MOTION_EVENT_ in motionStateMachine.h
+Endpoint eventEndpoint(&osap, "motionEvents");
+
+// one per loop,
+void eventLoop(void){
+  motionEvent_t evt;
+  if(!motion_getEvent(&evt)) return;
+  uint8_t eventData[14];
+  uint16_t wptr = 0;
+  eventData[wptr ++] = evt.type;
+  eventData[wptr ++] = evt.code;
+  ts_writeUint32(evt.eventNum, eventData, &wptr);
+  ts_writeFloat32(evt.pos, eventData, &wptr);
+  ts_writeFloat32(evt.vel, eventData, &wptr);
+  eventEndpoint.write(eventData, wptr);
+}
+
 void setup() {
   Serial.begin(0);
   // ~ important: the stepper code initializes GCLK4, which we use as timer-interrupt
   // in the motion system, so it aught to be initialized first !
   stepper_init();
   // another note on the motion system:
-  // at the moment, we have a relatively small absolute-maximum speed: say the integrator interval is 250us,
-  // we have 0.00025 seconds between ticks, for a max of 4000 steps / second...
-  // we are then microstepping at 1/4th steps, for 800 steps per motor revolution, (from a base of 200)
-  // meaning we can make only 5 revs / sec, or 300 rippums (RPM),
-  // with i.e. a 20-tooth GT2 belt, we have 40mm of travel per revolution, making only 200mm/sec maximum traverse
-  // this is not pitiful, but not too rad, and more importantly is that we will want to communicate these limits
+  // we run the same fixed-point integrator as the D21 board, on the same 100us (10kHz) interval,
+  // for a max of 10000 steps / second... at 1/4th steps, 800 steps per motor revolution (from a base of 200)
+  // that's 12.5 revs / sec, or 750 rippums (RPM), the RP2040 has plenty of headroom to go faster,
+  // but we want everyone on the same interval, and we will want to communicate these limits
   // to users of the motor - so we should outfit a sort of settings-grab function, or something ?
-  motion_init(250);
+  motion_init(100);
   // uuuh...
   osap.init();
   // run the commos
   vp_arduinoSerial.begin();
   pinMode(PIN_BUT, INPUT_PULLUP);
+  // it's active low, so presses are falling edges
+  attachInterrupt(digitalPinToInterrupt(PIN_BUT), onLimitEdge, FALLING);
 }
 
 uint32_t debounceDelay = 1;
@@ -113,6 +429,10 @@ boolean lastButtonState = false;
 void loop() {
   // do graph stuff
   osap.loop();
+  // ship any motion samples, 
+  telemetryLoop();
+  // and motion events,
+  eventLoop();
   // if(lastIntegration + integratorInterval < micros()){
   //   // stepper_step(1, true);
   //   lastIntegration = micros();
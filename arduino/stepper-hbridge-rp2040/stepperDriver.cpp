@@ -54,22 +54,73 @@ uint16_t slice_num_b;
 uint16_t channel_a;
 uint16_t channel_b;
 
-// LUT, 0-1022, 64 entries, sin w/ 511 at midpoint 
-// full sweep of electrical phase is actually 4 'steps' - 
-// so making a full step means incrementing 16 times through this LUT, 
-// half step is 8, quarter step 4, eighth step 2, sixteenth microstepping is one, fin 
-const uint16_t LUT_1022[64] = {
-    511,561,611,659,707,752,795,835,872,906,936,962,983,1000,1012,1020,
-    1022,1020,1012,1000,983,962,936,906,872,835,795,752,707,659,611,561,
-    511,461,411,363,315,270,227,187,150,116,86,60,39,22,10,2,
-    0,2,10,22,39,60,86,116,150,187,227,270,315,363,411,461,
-};
-// on init / cscale, we write new values into this thing, which is where
-// we actually pull currents from, for the h-bridges 
-uint16_t LUT_CURRENTS[64];
-// one electrical phase is 64 pts, so stick us 90' out of phase from one another... 
-volatile uint8_t lutPtrA = 16;
-volatile uint8_t lutPtrB = 0;
+// the sine LUT is built at startup, w/ integer maths: a quarter wave, 65 points (0 to 90 degrees, inclusive), in 2.30 fixed point, 
+// from the recurrence sin((n+1)t) = 2cos(t)sin(nt) - sin((n-1)t), for t = 1/256th of an electrical cycle, 
+// these are cos(t) and sin(t), in 2.30: 
+#define SINE_COS_T 1073418433
+#define SINE_SIN_T 26350943
+int32_t LUT_SINE[65];
+
+// a full electrical phase is 4 'steps', now 256 LUT entries, so one full step is 64 of them: 
+// microstepping at 1/n of a full step walks the table 64/n entries at a time, n can be 1 thru 64 (powers of two) 
+#define LUT_ENTRIES_PER_STEP 64
+volatile uint8_t lutIncrement = 16;   // 1/4 steps, as this has always been 
+
+// PWM periods are 256 counts (up from 128), still at 375kHz, so currents are 0-256 
+#define PWM_TOP 256
+
+// for each position in the table, the current (for one phase, at that position), 
+// and both phases' gate states, as one set of pins to set and one to clear: phase A runs a quarter wave (64 entries) ahead of B, 
+// these are all rebuilt on init, and currents again on cscale 
+uint16_t LUT_CURRENTS[256];
+uint32_t LUT_GATE_SET[256];
+uint32_t LUT_GATE_CLR[256];
+// our position in the table (it's phase B's, A's is 64 ahead), wraps w/ the uint8_t 
+volatile uint8_t lutPtr = 0;
+
+// sin at 1/256th's of a cycle, from the quarter wave, in 2.30 
+int32_t stepper_sine(uint8_t i){
+  uint8_t k = i & 63;
+  switch(i >> 6){
+    case 0: return LUT_SINE[k];
+    case 1: return LUT_SINE[64 - k];
+    case 2: return -LUT_SINE[k];
+    default: return -LUT_SINE[64 - k];
+  }
+}
+
+void stepper_buildTables(void){
+  // the quarter wave, 
+  LUT_SINE[0] = 0;
+  LUT_SINE[1] = SINE_SIN_T;
+  for(uint8_t n = 1; n < 64; n ++){
+    LUT_SINE[n + 1] = (int32_t)((((int64_t)SINE_COS_T * LUT_SINE[n]) >> 29) - LUT_SINE[n - 1]);
+  }
+  // and gates, per the sign of each phase: 
+  // transition low first, to avoid a brake condition for however many ns, so we always write clr before set 
+  for(uint16_t i = 0; i < 256; i ++){
+    int32_t a = stepper_sine((uint8_t)(i + 64));
+    int32_t b = stepper_sine((uint8_t)i);
+    uint32_t set = 0;
+    uint32_t clr = 0;
+    if(a > 0){
+      set |= AIN1_BM; clr |= AIN2_BM;   // A_UP 
+    } else if (a < 0){
+      set |= AIN2_BM; clr |= AIN1_BM;   // A_DOWN 
+    } else {
+      clr |= AIN1_BM | AIN2_BM;         // A_OFF 
+    }
+    if(b > 0){
+      set |= BIN1_BM; clr |= BIN2_BM;
+    } else if (b < 0){
+      set |= BIN2_BM; clr |= BIN1_BM;
+    } else {
+      clr |= BIN1_BM | BIN2_BM;
+    }
+    LUT_GATE_SET[i] = set;
+    LUT_GATE_CLR[i] = clr;
+  }
+}
 
 void stepper_init(void){
   // -------------------------------------------- DIR PINS 
@@ -78,6 +129,8 @@ void stepper_init(void){
   pinMode(AIN2_PIN, OUTPUT);
   pinMode(BIN1_PIN, OUTPUT);
   pinMode(BIN2_PIN, OUTPUT);
+  // -------------------------------------------- LUTs 
+  stepper_buildTables();
 
   gpio_set_function(APWM_PIN, GPIO_FUNC_PWM);
   gpio_set_function(BPWM_PIN, GPIO_FUNC_PWM);
@@ -87,18 +140,18 @@ void stepper_init(void){
   channel_b = pwm_gpio_to_channel(BPWM_PIN);
 
   uint32_t f_sys = clock_get_hz(clk_sys);
-  float divider = (float)f_sys / (128*375000UL);  // pwm clock at 375kHz
+  float divider = (float)f_sys / (PWM_TOP*375000UL);  // pwm clock at 375kHz
 
   pwm_set_clkdiv(slice_num_a, divider);
   pwm_set_clkdiv(slice_num_b, divider);
 
   // pwm period
-  pwm_set_wrap(slice_num_a, 127);
-  pwm_set_wrap(slice_num_b, 127);
+  pwm_set_wrap(slice_num_a, PWM_TOP - 1);
+  pwm_set_wrap(slice_num_b, PWM_TOP - 1);
 
-  // PWM duty cycle over 128
-  pwm_set_chan_level(slice_num_a, channel_a, 15);
-  pwm_set_chan_level(slice_num_b, channel_b, 15);
+  // PWM duty cycle over PWM_TOP
+  pwm_set_chan_level(slice_num_a, channel_a, 30);
+  pwm_set_chan_level(slice_num_b, channel_b, 30);
 
   // Set the PWM running
   pwm_set_enabled(slice_num_a, true);
@@ -110,34 +163,20 @@ void stepper_init(void){
 
 void stepper_publishCurrents(void){
   // position in LUT
-  pwm_set_chan_level(slice_num_a, channel_a, LUT_CURRENTS[lutPtrA] >> 3);
-  pwm_set_chan_level(slice_num_b, channel_b, LUT_CURRENTS[lutPtrB] >> 3);
+  pwm_set_chan_level(slice_num_a, channel_a, LUT_CURRENTS[(uint8_t)(lutPtr + 64)]);
+  pwm_set_chan_level(slice_num_b, channel_b, LUT_CURRENTS[lutPtr]);
 }
 
-void stepper_step(uint8_t microSteps, boolean dir){
-  // step LUT ptrs thru table, increment and wrap w/ bit logic 
+void stepper_step(boolean dir){
+  // step the LUT ptr thru the table, it wraps by itself 
   if(dir){
-    lutPtrA += microSteps; lutPtrA = lutPtrA & 0b00111111;
-    lutPtrB += microSteps; lutPtrB = lutPtrB & 0b00111111;
-  } else {
-    lutPtrA -= microSteps; lutPtrA = lutPtrA & 0b00111111;
-    lutPtrB -= microSteps; lutPtrB = lutPtrB & 0b00111111;
-  }
-  // depending on sign of phase, set up / down on gates 
-  if(LUT_1022[lutPtrA] > 511){
-    A_UP;
-  } else if (LUT_1022[lutPtrA] < 511){
-    A_DOWN;
-  } else {
-    A_OFF;
-  }
-  if(LUT_1022[lutPtrB] > 511){
-    B_UP;
-  } else if (LUT_1022[lutPtrB] < 511){
-    B_DOWN;
+    lutPtr += lutIncrement;
   } else {
-    B_OFF;
+    lutPtr -= lutIncrement;
   }
+  // gates are precomputed, so this is one clear and one set, for both phases 
+  sio_hw->gpio_clr = LUT_GATE_CLR[lutPtr];
+  sio_hw->gpio_set = LUT_GATE_SET[lutPtr];
   stepper_publishCurrents();
 }
 
@@ -145,21 +184,21 @@ void stepper_setCScale(float scale){
   // scale max 1.0, min 0.0,
   if(scale > 1.0F) scale = 1.0F;
   if(scale < 0.0F) scale = 0.0F;
-  // for each item in the LUTs,
-  for(uint8_t i = 0; i < 64; i ++){
-    if(LUT_1022[i] > 511){
-      // top half, no invert, but shift-down and scale 
-      LUT_CURRENTS[i] = (LUT_1022[i] - 511) * 2.0F * scale;
-    } else if (LUT_1022[i] < 511){
-      // lower half, invert and shift down 
-      float temp = LUT_1022[i];   // get lut as float, 
-      temp = (temp * -2.0F + 1022) * scale; // scale (flipping) and offset back up 
-      LUT_CURRENTS[i] = temp; // set table element, 
-    } else {
-      // the midpoint: off, 
-      LUT_CURRENTS[i] = 0;
-    }
+  // to 0.16 fixed point, and then it's integers from here: 
+  // currents are |sin| * scale * PWM_TOP, rounded, (2.30 * 0.16 * 9 bits fits in 64) 
+  int64_t scaleQ16 = (int64_t)(scale * 65536.0F);
+  for(uint16_t i = 0; i < 256; i ++){
+    int64_t sine = stepper_sine((uint8_t)i);
+    if(sine < 0) sine = -sine;
+    LUT_CURRENTS[i] = (uint16_t)((sine * scaleQ16 * PWM_TOP + ((int64_t)1 << 45)) >> 46);
   }
   // re-publish currents,
   stepper_publishCurrents();
 }
+
+boolean stepper_setMicrosteps(uint8_t microsteps){
+  // 1/n of a full step, n a power of two, up to the table's resolution 
+  if(microsteps == 0 || microsteps > LUT_ENTRIES_PER_STEP || (microsteps & (microsteps - 1)) != 0) return false;
+  lutIncrement = LUT_ENTRIES_PER_STEP / microsteps;
+  return true;
+}
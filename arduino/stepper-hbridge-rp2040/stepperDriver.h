@@ -24,7 +24,9 @@ is; no warranty is provided, and users accept all liability.
 #define PIN_BUT 27
 
 void stepper_init(void);
-void stepper_step(uint8_t microSteps, boolean dir);
+void stepper_step(boolean dir);
 void stepper_setCScale(float scale);
+// microstepping, as 1/n of a full step: 1 thru 64, powers of two, returns false (and leaves it) otherwise 
+boolean stepper_setMicrosteps(uint8_t microsteps);
 
 #endif 
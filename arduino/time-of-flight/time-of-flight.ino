@@ -16,21 +16,77 @@ OSAP osap("timeOfFlight", messageStack, OSAP_STACK_SIZE);
 // ---------------------------------------------- 0th Vertex: OSAP USB Serial
 VPort_ArduinoSerial vp_arduinoSerial(&osap, "usbSerial", &Serial);
 
+// ---------------------------------------------- Ranging 
+// the sensor ranges continuously on its own, and we pick up each result from loop() when it's ready, 
+// so that queries never wait on the I2C bus or the 50ms timing budget 
+typedef struct tofResult_t {
+  uint32_t sampleNum;   // counts results since startup, 0 is 'none yet' 
+  uint32_t time;        // micros() when we read it out 
+  uint16_t range;       // mm 
+  uint8_t status;       // the VL53L1X's RangeStatus, 0 is valid 
+  float signalRate;     // peak signal count rate, MCPS 
+} tofResult_t;
+
+tofResult_t latest = { 0, 0, 0, VL53L1X::None, 0.0F };
+
+// ready-checks are one I2C read, so we don't do them on every loop 
+uint32_t tofPollInterval = 2000;  // us 
+uint32_t lastTofPoll = 0;
+
+boolean tofPush = false;
+
+void writeResult(uint8_t* buf, uint16_t* wptr) {
+  // <range (uint16), status (uint8), signalRate (float32), age (uint32, us), sampleNum (uint32)> 
+  ts_writeUint16(latest.range, buf, wptr);
+  buf[(*wptr) ++] = latest.status;
+  ts_writeFloat32(latest.signalRate, buf, wptr);
+  ts_writeUint32(micros() - latest.time, buf, wptr);
+  ts_writeUint32(latest.sampleNum, buf, wptr);
+}
+
+#define TOF_RESULT_BYTES 15
+
 // ---------------------------------------------- 1 Vertex
 boolean preTOFQuery(void);
 
 Endpoint tofEndpoint(&osap, "tofQuery", preTOFQuery);
 
 boolean preTOFQuery(void) {
-  uint8_t buf[2];
-  sensor.read();
-  uint16_t value = sensor.ranging_data.range_mm;
-  buf[0] = value & 0xFF;
-  buf[1] = value >> 8 & 0xFF;
-  tofEndpoint.write(buf, 2);
+  uint8_t buf[TOF_RESULT_BYTES];
+  uint16_t wptr = 0;
+  writeResult(buf, &wptr);
+  tofEndpoint.write(buf, wptr);
   return true;
 }
 
+// ---------------------------------------------- 2nd Vertex: Push 
+// write a 1 (uint8) to push every new result (as above) to this endpoint's routes, 0 to stop 
+EP_ONDATA_RESPONSES onPushData(uint8_t* data, uint16_t len) {
+  tofPush = (len > 0 && data[0] > 0);
+  return EP_ONDATA_ACCEPT;
+}
+
+Endpoint pushEndpoint(&osap, "tofPush", onPushData);
+
+void tofLoop(void) {
+  if(micros() - lastTofPoll < tofPollInterval) return;
+  lastTofPoll = micros();
+  if(!sensor.dataReady()) return;
+  // non-blocking: the result is already there 
+  sensor.read(false);
+  latest.sampleNum ++;
+  latest.time = micros();
+  latest.range = sensor.ranging_data.range_mm;
+  latest.status = sensor.ranging_data.range_status;
+  latest.signalRate = sensor.ranging_data.peak_signal_count_rate_MCPS;
+  if(tofPush){
+    uint8_t buf[TOF_RESULT_BYTES];
+    uint16_t wptr = 0;
+    writeResult(buf, &wptr);
+    pushEndpoint.write(buf, wptr);
+  }
+}
+
 void setup() {
   osap.init();
   vp_arduinoSerial.begin();
@@ -47,4 +103,5 @@ void setup() {
 
 void loop() {
   osap.loop();
+  tofLoop();
 }
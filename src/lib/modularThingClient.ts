@@ -9,6 +9,7 @@ import accelerometer from "./virtualThings/accelerometer";
 import oled from "./virtualThings/oled";
 import potentiometer from "./virtualThings/potentiometer";
 import servo from "./virtualThings/servo";
+import dcEncoder from "./virtualThings/dcEncoder";
 
 import VPortWebSerial from "./osapjs/vport/vPortWebSerial";
 
@@ -25,7 +26,8 @@ const constructors = {
   oled,
   accelerometer,
   potentiometer,
-  servo
+  servo,
+  dcencoder: dcEncoder
 };
 
 export type Thing = {
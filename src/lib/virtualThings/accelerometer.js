@@ -13,14 +13,137 @@ no warranty is provided, and users accept all liability.
 import { TS } from "../osapjs/core/ts.js"
 import PK from "../osapjs/core/packets.js"
 
+// the IMU's output rates, the firmware picks the first of these at-or-above what we ask for,
+// (the LSM6DSO goes to 6660, but the firmware can't drain its FIFO over I2C past 1660, so it doesn't take those)
+const IMU_RATES = [12.5, 26, 52, 104, 208, 416, 833, 1660]
+
 export default function(osap, vt, name) {
 
   let routeToFirmware = PK.VC2VMRoute(vt.route);
   let accGyroQuery = osap.query(PK.route(routeToFirmware).sib(1).end());
 
-  const setup = async () => { }
+  // the 2nd vertex streams batches out of the IMU's FIFO, we write a rate to it,
+  let streamEndpoint = osap.endpoint(`imuStreamMirror_${name}`);
+  streamEndpoint.addRoute(PK.route(routeToFirmware).sib(2).end());
+  let streamRxEndpoint = osap.endpoint(`imuStreamCatcher_${name}`);
+  let streamRate = 0;
+  let onSamplesHandler = (samples) => {
+    console.warn(`default imu stream handler in ${name}, ${samples.length} samples`);
+  }
+  streamRxEndpoint.onData = (data) => {
+    let sampleNum = TS.read("uint32", data, 0);
+    let count = data[4];
+    let overrun = (data[5] & 1) > 0;
+    let samples = [];
+    for (let s = 0; s < count; s++) {
+      let ptr = 6 + s * 12;
+      let values = [];
+      for (let v = 0; v < 6; v++) values.push(TS.read("int16", data, ptr + v * 2));
+      samples.push({
+        sampleNum: sampleNum + s,
+        time: (sampleNum + s) / streamRate,
+        // as readAccGyro, [x, y, z, xTheta, yTheta, zTheta]
+        values,
+      });
+    }
+    // overrun means the IMU's FIFO filled up, so some samples are missing just before this batch
+    onSamplesHandler(samples, overrun);
+  }
+
+  // the 3rd vertex runs an orientation filter on the board, at the IMU's rate: we write a rate (and gains) to it, and query it
+  let orientationEndpoint = osap.endpoint(`orientationMirror_${name}`);
+  orientationEndpoint.addRoute(PK.route(routeToFirmware).sib(3).end());
+  let orientationQuery = osap.query(PK.route(routeToFirmware).sib(3).end());
+
+  const setup = async () => {
+    try {
+      // route the stream from the 2nd vertex back up to us,
+      let source = vt.children[2];
+      try {
+        await osap.mvc.removeEndpointRoute(source.route, 0);
+      } catch (err) { }
+      await osap.mvc.setEndpointRoute(source.route, PK.route().sib(0).pfwd().sib(0).pfwd().sib(streamRxEndpoint.indice).end());
+    } catch (err) {
+      throw err;
+    }
+  }
+
+  // rates are in Hz, up to 1660, and get rounded up to the IMU's next,
+  // returns the rate we got
+  let streamSamples = async (rate, handler) => {
+    try {
+      if (handler) onSamplesHandler = handler;
+      let actual = 0;
+      if (rate > 0) {
+        actual = IMU_RATES.find(r => r >= rate);
+        if (actual == undefined) throw new Error(`the IMU's top rate is ${IMU_RATES[IMU_RATES.length - 1]} Hz, not ${rate}`);
+      }
+      let datagram = new Uint8Array(2);
+      TS.write("uint16", Math.ceil(rate), datagram, 0);
+      await streamEndpoint.write(datagram, "acked");
+      streamRate = actual;
+      return actual;
+    } catch (err) {
+      console.error(err);
+    }
+  }
+
+  let stopStream = async () => {
+    await streamSamples(0);
+  }
+
+  // kp (1/s) is how hard gravity corrects the gyro's tilt, ki (1/s^2) how quickly it learns the gyro's bias,
+  // the stream (if it's running) moves to this rate too, returns the rate we got
+  let startOrientation = async (rate = 104, kp = 2, ki = 0.05) => {
+    try {
+      let actual = IMU_RATES.find(r => r >= rate);
+      if (rate <= 0 || actual == undefined) throw new Error(`orientation rates are from ${IMU_RATES[0]} to ${IMU_RATES[IMU_RATES.length - 1]} Hz, not ${rate}`);
+      let datagram = new Uint8Array(10);
+      TS.write("uint16", Math.ceil(rate), datagram, 0);
+      TS.write("float32", kp, datagram, 2);
+      TS.write("float32", ki, datagram, 6);
+      await orientationEndpoint.write(datagram, "acked");
+      if (streamRate != 0) streamRate = actual;
+      return actual;
+    } catch (err) {
+      console.error(err);
+    }
+  }
+
+  let stopOrientation = async () => {
+    try {
+      let datagram = new Uint8Array(2);
+      TS.write("uint16", 0, datagram, 0);
+      await orientationEndpoint.write(datagram, "acked");
+    } catch (err) {
+      console.error(err);
+    }
+  }
+
+  // angles are in degrees, and yaw is relative to where we started (there's no magnetometer)
+  let getOrientation = async () => {
+    try {
+      let data = await orientationQuery.pull();
+      let quaternion = [];
+      for (let i = 0; i < 4; i++) quaternion.push(TS.read("int16", data, 4 + i * 2) / 16384);
+      return {
+        sampleNum: TS.read("uint32", data, 0),
+        quaternion,
+        roll: TS.read("float32", data, 12),
+        pitch: TS.read("float32", data, 16),
+        yaw: TS.read("float32", data, 20),
+      }
+    } catch (err) {
+      console.error(err);
+    }
+  }
 
   return {
+    streamSamples,
+    stopStream,
+    startOrientation,
+    stopOrientation,
+    getOrientation,
     readAccGyro: async () => {
       try {
         const data = await accGyroQuery.pull();
@@ -44,6 +167,36 @@ export default function(osap, vt, name) {
         name: "readAccGyro",
         args: [],
         return: "[x, y, z, xTheta, yTheta, zTheta]"
+      },
+      {
+        name: "streamSamples",
+        args: [
+          "rate: number (Hz)",
+          "handler: (samples, overrun) => void"
+        ],
+        return: "number (the rate we got, in Hz)"
+      },
+      {
+        name: "stopStream",
+        args: []
+      },
+      {
+        name: "startOrientation",
+        args: [
+          "rate: number (Hz)",
+          "kp: number (1/s)",
+          "ki: number (1/s^2)"
+        ],
+        return: "number (the rate we got, in Hz)"
+      },
+      {
+        name: "stopOrientation",
+        args: []
+      },
+      {
+        name: "getOrientation",
+        args: [],
+        return: "{ sampleNum, quaternion: [w, x, y, z], roll, pitch, yaw } (degrees)"
       }
     ]
   }
@@ -28,9 +28,38 @@ export default function(osap, vt, name) {
   // endpoint-query packets... to whatever is at the given route
   let padQuery = osap.query(PK.route(routeToFirmware).sib(2).end());
 
+  // the 3rd vertex pushes touches and releases, which the board detects on its own,
+  let padEventRxEndpoint = osap.endpoint(`padEventCatcher_${name}`)
+  let onPadEventHandler = (pad, touched) => {
+    console.warn(`default pad event handler in ${name}, pad ${pad} ${touched ? "touched" : "released"}`);
+  }
+  let touchMask = 0
+  padEventRxEndpoint.onData = (data) => {
+    // <pad, touched, mask, time (us)>: the mask has every pad's state, so we catch up on any events that got overwritten
+    let mask = data[2]
+    let changed = (touchMask ^ mask) | (1 << data[0])
+    touchMask = mask
+    for (let p = 0; p < N_PADS; p++) {
+      if (changed & (1 << p)) onPadEventHandler(p, (mask & (1 << p)) > 0)
+    }
+  }
+
+  // and the 4th is touch detection config,
+  let padConfigEndpoint = osap.endpoint(`padConfigMirror_${name}`)
+  padConfigEndpoint.addRoute(PK.route(routeToFirmware).sib(4).end());
+
   // we should have a setup function:
   const setup = async () => {
-    // though we sometimes don't need it... esp if all direct-write
+    try {
+      // route pad events from the 3rd vertex back up to us,
+      let source = vt.children[3]
+      try {
+        await osap.mvc.removeEndpointRoute(source.route, 0)
+      } catch (err) { }
+      await osap.mvc.setEndpointRoute(source.route, PK.route().sib(0).pfwd().sib(0).pfwd().sib(padEventRxEndpoint.indice).end())
+    } catch (err) {
+      throw err
+    }
   }
 
   return {
@@ -64,6 +93,35 @@ export default function(osap, vt, name) {
         console.error(err)
       }
     },
+    // raw readings, the board's baselines for each, and which pads it thinks are touched
+    readPads: async () => {
+      try {
+        let data = await padQuery.pull();
+        let raw = [], baseline = [], touched = []
+        for (let p = 0; p < N_PADS; p++) {
+          raw.push(TS.read("uint16", data, p * 2))
+          baseline.push(TS.read("uint16", data, N_PADS * 2 + p * 2))
+          touched.push((data[N_PADS * 4] & (1 << p)) > 0)
+        }
+        return { raw, baseline, touched }
+      } catch (err) {
+        console.error(err)
+      }
+    },
+    onPadEvent: (fn) => { onPadEventHandler = fn; },
+    // thresholds are raw counts above each pad's baseline: a touch is above touchThreshold, a release below releaseThreshold,
+    // and either has to hold for debounceScans scans of that pad
+    setTouchConfig: async (touchThreshold = 100, releaseThreshold = 60, debounceScans = 3) => {
+      try {
+        let datagram = new Uint8Array(5)
+        TS.write("uint16", touchThreshold, datagram, 0)
+        TS.write("uint16", releaseThreshold, datagram, 2)
+        datagram[4] = debounceScans
+        await padConfigEndpoint.write(datagram, "acked")
+      } catch (err) {
+        console.error(err)
+      }
+    },
     setup,
     vt,
     api: [
@@ -82,6 +140,25 @@ export default function(osap, vt, name) {
         ],
         return: "0 to 1"
       },
+      {
+        name: "readPads",
+        args: [],
+        return: "{ raw: [], baseline: [], touched: [] }"
+      },
+      {
+        name: "onPadEvent",
+        args: [
+          "function: (pad, touched) => {}"
+        ]
+      },
+      {
+        name: "setTouchConfig",
+        args: [
+          "touchThreshold: counts above baseline",
+          "releaseThreshold: counts above baseline",
+          "debounceScans: int"
+        ]
+      },
     ]
   }
 }
@@ -0,0 +1,572 @@
+/*
+dcEncoder.js
+
+a "virtual thing" - of course
+
+Jake Read, Leo McElroy and Quentin Bolsee at the Center for Bits and Atoms
+(c) Massachusetts Institute of Technology 2023
+
+This work may be reproduced, modified, distributed, performed, and
+displayed for any purpose, but must acknowledge the open systems assembly protocol (OSAP) and modular-things projects.
+Copyright is retained and must be preserved. The work is provided as is;
+no warranty is provided, and users accept all liability.
+*/
+
+import PK from "../osapjs/core/packets.js"
+import { TS } from "../osapjs/core/ts.js"
+import TIME from "../osapjs/core/time.js"
+
+export default function dcEncoder(osap, vt, name) {
+  let onTelemetryHandler = (samples) => {
+    console.warn(`default telemetry handler in ${name}, ${samples.length} samples`);
+  }
+
+  let routeToFirmware = PK.VC2VMRoute(vt.route)
+  // -------------------------------------------- 1: position target, in encoder counts
+  let targetEndpoint = osap.endpoint(`targetMirror_${name}`)
+  targetEndpoint.addRoute(PK.route(routeToFirmware).sib(1).end())
+  // -------------------------------------------- 2: PID gains
+  let pidEndpoint = osap.endpoint(`pidMirror_${name}`)
+  pidEndpoint.addRoute(PK.route(routeToFirmware).sib(2).end())
+  // -------------------------------------------- 3: control loop rate
+  let rateEndpoint = osap.endpoint(`rateMirror_${name}`)
+  rateEndpoint.addRoute(PK.route(routeToFirmware).sib(3).end())
+  // -------------------------------------------- 4: cascaded (position -> velocity) gains
+  let cascadeEndpoint = osap.endpoint(`cascadeMirror_${name}`)
+  cascadeEndpoint.addRoute(PK.route(routeToFirmware).sib(4).end())
+  // -------------------------------------------- 5: velocity target, in counts / sec
+  let velocityEndpoint = osap.endpoint(`velocityMirror_${name}`)
+  velocityEndpoint.addRoute(PK.route(routeToFirmware).sib(5).end())
+  // -------------------------------------------- 6: telemetry, we write the sample rate, it streams samples back
+  let telemetryEndpoint = osap.endpoint(`telemetryMirror_${name}`)
+  telemetryEndpoint.addRoute(PK.route(routeToFirmware).sib(6).end())
+  let telemetryRxEndpoint = osap.endpoint(`telemetryCatcher_${name}`)
+  // sample times are sampleNum * decimation / the loop's rate
+  let controlRate = 5000
+  let telemetryDecimation = 0
+  telemetryRxEndpoint.onData = (data) => {
+    let sampleNum = TS.read("uint32", data, 0)
+    let count = data[4]
+    let samples = []
+    for (let s = 0; s < count; s++) {
+      let ptr = 5 + s * 10
+      samples.push({
+        sampleNum: sampleNum + s,
+        time: (sampleNum + s) * telemetryDecimation / controlRate,
+        pos: TS.read("int32", data, ptr),
+        vel: TS.read("float32", data, ptr + 4),
+        effort: TS.read("int16", data, ptr + 8),
+      })
+    }
+    onTelemetryHandler(samples)
+  }
+  // -------------------------------------------- 7: state, a query
+  let stateQuery = osap.query(PK.route(routeToFirmware).sib(7).end())
+  // -------------------------------------------- 8 - 12: profiled motion, laid out as the stepper's, so that synchronizer.js can drive us
+  let profileTargetEndpoint = osap.endpoint(`profileTargetMirror_${name}`)
+  profileTargetEndpoint.addRoute(PK.route(routeToFirmware).sib(8).end())
+  let motionStateQuery = osap.query(PK.route(routeToFirmware).sib(9).end())
+  let positionSetEndpoint = osap.endpoint(`setPositionMirror_${name}`)
+  positionSetEndpoint.addRoute(PK.route(routeToFirmware).sib(10).end())
+  let timeSyncQuery = osap.query(PK.route(routeToFirmware).sib(11).end())
+  let timeSyncEndpoint = osap.endpoint(`timeSyncMirror_${name}`)
+  timeSyncEndpoint.addRoute(PK.route(routeToFirmware).sib(11).end())
+  let segmentEndpoint = osap.endpoint(`segmentQueueMirror_${name}`)
+  segmentEndpoint.addRoute(PK.route(routeToFirmware).sib(12).end())
+  // the firmware holds segments back 'till it has queue space, so acks can take a while
+  segmentEndpoint.setTimeoutLength(30000)
+
+  const setup = async () => {
+    try {
+      // route telemetry from the 6th endpoint back up to us,
+      let telemetrySource = vt.children[6]
+      try {
+        await osap.mvc.removeEndpointRoute(telemetrySource.route, 0)
+      } catch (err) { }
+      await osap.mvc.setEndpointRoute(telemetrySource.route, PK.route().sib(0).pfwd().sib(0).pfwd().sib(telemetryRxEndpoint.indice).end())
+    } catch (err) {
+      throw err
+    }
+  }
+
+  let setTarget = async (counts) => {
+    try {
+      let datagram = new Uint8Array(4)
+      TS.write("int32", Math.round(counts), datagram, 0)
+      await targetEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // runs the velocity loop alone, 'till the next setTarget
+  let setVelocity = async (countsPerSecond) => {
+    try {
+      let datagram = new Uint8Array(4)
+      TS.write("float32", countsPerSecond, datagram, 0)
+      await velocityEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // i and d are per-millisecond, setting these puts position control back on the PID
+  let setPIDGains = async (kp, ki, kd) => {
+    try {
+      let datagram = new Uint8Array(12)
+      let wptr = 0
+      wptr += TS.write("float32", kp, datagram, wptr)
+      wptr += TS.write("float32", ki, datagram, wptr)
+      wptr += TS.write("float32", kd, datagram, wptr)
+      await pidEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // posKp is counts/sec per count of error, velKp is effort per count/sec, velKi is that per ms,
+  // and the position loop never asks for more than maxVel (counts / sec)
+  let setCascadeGains = async (posKp, velKp, velKi, maxVel) => {
+    try {
+      let datagram = new Uint8Array(16)
+      let wptr = 0
+      wptr += TS.write("float32", posKp, datagram, wptr)
+      wptr += TS.write("float32", velKp, datagram, wptr)
+      wptr += TS.write("float32", velKi, datagram, wptr)
+      wptr += TS.write("float32", maxVel, datagram, wptr)
+      await cascadeEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // the firmware rejects rates outside of 100 - 20000 Hz
+  let setRate = async (hz) => {
+    try {
+      let datagram = new Uint8Array(4)
+      TS.write("uint32", Math.round(hz), datagram, 0)
+      await rateEndpoint.write(datagram, "acked")
+      controlRate = Math.round(hz)
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let getState = async () => {
+    try {
+      let data = await stateQuery.pull()
+      return {
+        pos: TS.read("int32", data, 0),
+        vel: TS.read("float32", data, 4),
+        effort: TS.read("int16", data, 8),
+        mode: data[10] == 0 ? "position" : "velocity",
+      }
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // in units (see setCountsPerUnit), from the encoder
+  let getPosition = async () => {
+    try {
+      let state = await getState()
+      return state.pos / cpu
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let getVelocity = async () => {
+    try {
+      let state = await getState()
+      return state.vel / cpu
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // stream pos, vel, effort samples at ~ this rate (samples / sec), in batches, to the handler
+  let streamTelemetry = async (rate, handler) => {
+    try {
+      if (handler) onTelemetryHandler = handler
+      let decimation = rate > 0 ? Math.max(1, Math.round(controlRate / rate)) : 0
+      if (decimation > 65535) decimation = 65535
+      telemetryDecimation = decimation
+      let datagram = new Uint8Array(2)
+      TS.write("uint16", decimation, datagram, 0)
+      await telemetryEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let stopTelemetry = async () => {
+    await streamTelemetry(0)
+  }
+
+  // -------------------------------------------- Profiled Motion
+
+  // the firmware's trapezoidal integrator walks the control loop's target along, so that moves ramp instead of jumping,
+  // positions here are in units, w/ this many encoder counts per unit,
+  let cpu = 1
+  // the integrator runs at 10kHz, and moves the setpoint at most one count per tick
+  let absMaxVelocity = 10000 / cpu
+  let absMaxAccel = 100000
+  let lastVel = 1000
+  let lastAccel = 10000
+
+  let setCountsPerUnit = (_cpu) => {
+    cpu = _cpu
+    if (absMaxVelocity > 10000 / cpu) { absMaxVelocity = 10000 / cpu }
+  }
+
+  let setAbsMaxVelocity = (maxVel) => {
+    if (maxVel > 10000 / cpu) maxVel = 10000 / cpu
+    absMaxVelocity = maxVel
+  }
+
+  let setAbsMaxAccel = (maxAccel) => { absMaxAccel = maxAccel }
+
+  // modal rates for target / absolute, (setVelocity is the velocity loop's target)
+  let setMaxVelocity = (vel) => {
+    if (vel > absMaxVelocity) vel = absMaxVelocity
+    lastVel = vel
+  }
+
+  let setAccel = (accel) => {
+    if (accel > absMaxAccel) accel = absMaxAccel
+    lastAccel = accel
+  }
+
+  let getAbsMaxVelocity = () => { return absMaxVelocity }
+  let getAbsMaxAccel = () => { return absMaxAccel }
+
+  // the profile's states: pos is the encoder's, vel and accel the setpoint's
+  let getMotionState = async () => {
+    try {
+      let data = await motionStateQuery.pull()
+      return {
+        pos: TS.read("float32", data, 0) / cpu,
+        vel: TS.read("float32", data, 4) / cpu,
+        accel: TS.read("float32", data, 8) / cpu,
+        // timed targets wait in the firmware's command ring 'till they start,
+        pending: data.length > 32 ? data[32] : 0,
+      }
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // the profile is done when the setpoint stops and nothing's waiting to start, (the loop may still be settling)
+  let awaitMotionEnd = async () => {
+    try {
+      return new Promise(async (resolve, reject) => {
+        let check = () => {
+          motionStateQuery.pull().then((data) => {
+            let vel = TS.read("float32", data, 4) / cpu
+            let pending = data.length > 32 ? data[32] : 0
+            if (pending == 0 && vel < 0.001 && vel > -0.001) {
+              resolve()
+            } else {
+              setTimeout(check, 10)
+            }
+          }).catch(reject)
+        }
+        check()
+      })
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // as the stepper's: a few round trips to the firmware's clock, we keep the quickest
+  let lastClockSync = null
+  let syncClock = async (exchanges = 8) => {
+    try {
+      let best = null
+      for (let e = 0; e < exchanges; e++) {
+        let sent = TIME.getTimeStamp()
+        let data = await timeSyncQuery.pull()
+        let rxd = TIME.getTimeStamp()
+        if (best == null || rxd - sent < best.rtt) {
+          best = {
+            rtt: rxd - sent,
+            hostTime: Math.round((sent + rxd) * 500) >>> 0,
+            deviceTime: TS.read("uint32", data, 0),
+          }
+        }
+      }
+      let datagram = new Uint8Array(8)
+      TS.write("uint32", best.hostTime, datagram, 0)
+      TS.write("uint32", best.deviceTime, datagram, 4)
+      await timeSyncEndpoint.write(datagram, "acked")
+      lastClockSync = TIME.getTimeStamp()
+      return best.rtt
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let getLastClockSync = () => { return lastClockSync }
+
+  // sets a profiled position target, w/ rates to use on the way, and an optional time (from hostMicros()) to start at
+  let target = async (pos, vel, accel, executeAt) => {
+    try {
+      vel ? lastVel = vel : vel = lastVel;
+      accel ? lastAccel = accel : accel = lastAccel;
+      if (accel > absMaxAccel) { accel = absMaxAccel; lastAccel = accel; }
+      if (vel > absMaxVelocity) { vel = absMaxVelocity; lastVel = vel; }
+      if (vel <= 0 || accel <= 0) throw new Error(`y'all are trying to go somewhere, but modal velocity or accel are negative, this won't do...`)
+      let datagram = new Uint8Array(executeAt != undefined ? 17 : 13)
+      let wptr = 0
+      datagram[wptr++] = 0 // MOTION_MODE_POS
+      wptr += TS.write("float32", pos * cpu, datagram, wptr)
+      wptr += TS.write("float32", vel * cpu, datagram, wptr)
+      wptr += TS.write("float32", accel * cpu, datagram, wptr)
+      if (executeAt != undefined) wptr += TS.write("uint32", executeAt >>> 0, datagram, wptr)
+      await profileTargetEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let absolute = async (pos, vel, accel, executeAt) => {
+    try {
+      await target(pos, vel, accel, executeAt)
+      await awaitMotionEnd()
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let relative = async (delta, vel, accel) => {
+    try {
+      let pos = delta + await getPosition()
+      await absolute(pos, vel, accel)
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // a profiled velocity, ramped at accel
+  let velocity = async (vel, accel, executeAt) => {
+    try {
+      accel ? lastAccel = accel : accel = lastAccel;
+      if (accel > absMaxAccel) { accel = absMaxAccel; lastAccel = accel; }
+      if (vel > absMaxVelocity) vel = absMaxVelocity
+      if (vel < -absMaxVelocity) vel = -absMaxVelocity
+      let datagram = new Uint8Array(executeAt != undefined ? 13 : 9)
+      let wptr = 0
+      datagram[wptr++] = 1 // MOTION_MODE_VEL
+      wptr += TS.write("float32", vel * cpu, datagram, wptr)
+      wptr += TS.write("float32", accel * cpu, datagram, wptr)
+      if (executeAt != undefined) wptr += TS.write("uint32", executeAt >>> 0, datagram, wptr)
+      await profileTargetEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // queues a move, that carries on into the next w/o stopping, resolves when it's queued
+  // (or, w/ a pathLength, this motor's share of a synchronizer's line, as the stepper's)
+  let segment = async (pos, vel, accel, pathLength, junctionVel) => {
+    try {
+      // a synchronizer's line: rates are the line's, in its units, so we hand them thru as they are (and don't touch our modal rates)
+      if (pathLength > 0) {
+        let datagram = new Uint8Array(20)
+        let wptr = 0
+        wptr += TS.write("float32", pos * cpu, datagram, wptr)
+        wptr += TS.write("float32", vel, datagram, wptr)
+        wptr += TS.write("float32", accel, datagram, wptr)
+        wptr += TS.write("float32", pathLength, datagram, wptr)
+        wptr += TS.write("float32", junctionVel ? junctionVel : 0, datagram, wptr)
+        await segmentEndpoint.write(datagram, "acked")
+        return
+      }
+      vel ? lastVel = vel : vel = lastVel;
+      accel ? lastAccel = accel : accel = lastAccel;
+      if (accel > absMaxAccel) { accel = absMaxAccel; lastAccel = accel; }
+      if (vel > absMaxVelocity) { vel = absMaxVelocity; lastVel = vel; }
+      if (vel <= 0 || accel <= 0) throw new Error(`y'all are trying to go somewhere, but modal velocity or accel are negative, this won't do...`)
+      // <pos, vel, accel, pathLength, junctionVel>, and w/o a path, those last two are left at zero
+      let datagram = new Uint8Array(20)
+      let wptr = 0
+      wptr += TS.write("float32", pos * cpu, datagram, wptr)
+      wptr += TS.write("float32", vel * cpu, datagram, wptr)
+      wptr += TS.write("float32", accel * cpu, datagram, wptr)
+      await segmentEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let stop = async () => {
+    try {
+      await velocity(0)
+      await awaitMotionEnd()
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // re-numbers the encoder, and holds there
+  let setPosition = async (pos) => {
+    try {
+      await stop()
+      let datagram = new Uint8Array(4)
+      TS.write("float32", pos * cpu, datagram, 0)
+      await positionSetEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  return {
+    target,
+    absolute,
+    relative,
+    velocity,
+    segment,
+    stop,
+    awaitMotionEnd,
+    setPosition,
+    setMaxVelocity,
+    setAccel,
+    setCountsPerUnit,
+    setAbsMaxVelocity,
+    setAbsMaxAccel,
+    getAbsMaxVelocity,
+    getAbsMaxAccel,
+    getMotionState,
+    getVelocity,
+    syncClock,
+    getLastClockSync,
+    setTarget,
+    setVelocity,
+    setPIDGains,
+    setCascadeGains,
+    setRate,
+    getState,
+    getPosition,
+    streamTelemetry,
+    stopTelemetry,
+    setup,
+    vt,
+    api: [
+      {
+        name: "absolute",
+        args: [
+          "pos: number",
+          "vel?: number",
+          "accel?: number"
+        ]
+      },
+      {
+        name: "relative",
+        args: [
+          "delta: number",
+          "vel?: number",
+          "accel?: number"
+        ]
+      },
+      {
+        name: "velocity",
+        args: [
+          "vel: number",
+          "accel?: number"
+        ]
+      },
+      {
+        name: "stop",
+        args: []
+      },
+      {
+        name: "setPosition",
+        args: [
+          "pos: number"
+        ]
+      },
+      {
+        name: "setCountsPerUnit",
+        args: [
+          "cpu: number"
+        ]
+      },
+      {
+        name: "setMaxVelocity",
+        args: [
+          "vel: number"
+        ]
+      },
+      {
+        name: "setAccel",
+        args: [
+          "accel: number"
+        ]
+      },
+      {
+        name: "setTarget",
+        args: [
+          "counts: int32"
+        ]
+      },
+      {
+        name: "setVelocity",
+        args: [
+          "countsPerSecond: number"
+        ]
+      },
+      {
+        name: "setPIDGains",
+        args: [
+          "kp: number",
+          "ki: number (per ms)",
+          "kd: number (per ms)"
+        ]
+      },
+      {
+        name: "setCascadeGains",
+        args: [
+          "posKp: number",
+          "velKp: number",
+          "velKi: number (per ms)",
+          "maxVel: number (counts / sec)"
+        ]
+      },
+      {
+        name: "setRate",
+        args: [
+          "hz: 100 to 20000"
+        ]
+      },
+      {
+        name: "getState",
+        args: [],
+        return: `
+          {
+            pos: number (counts),
+            vel: number (counts / sec),
+            effort: -255 to 255,
+            mode: "position" | "velocity"
+          }
+        `
+      },
+      {
+        name: "getPosition",
+        args: [],
+        return: "number (units)"
+      },
+      {
+        name: "streamTelemetry",
+        args: [
+          "rate: number (samples / sec)",
+          "handler: (samples) => void"
+        ]
+      },
+      {
+        name: "stopTelemetry",
+        args: []
+      }
+    ]
+  }
+}
@@ -23,9 +23,26 @@ export default function mosfetThing(osap, vt, name) {
   let gateEndpointMirror = osap.endpoint("gateEndpointMirror")
   gateEndpointMirror.addRoute(PK.route(routeToFirmware).sib(1).end())
 
+  // the 2nd vertex queues timed pulses, and the 3rd tells us how they're going
+  let pulseEndpointMirror = osap.endpoint(`pulseQueueMirror_${name}`)
+  pulseEndpointMirror.addRoute(PK.route(routeToFirmware).sib(2).end())
+  let pulseStateQuery = osap.query(PK.route(routeToFirmware).sib(3).end())
+
+  const PULSE_QUEUE_MAX = 31
+  // longer phrases go in pieces of half the queue, so that each lands while the last is still playing,
+  // and every piece after the first has the count's top bit set, to carry on timing from the pulse before it
+  const PULSE_CHUNK = 16
+  const PULSE_CONTINUES = 0x80
+  const PULSE_MAX_US = 60000000
+
   // we should have a setup function:
   const setup = async () => { }
 
+  let getPulseState = async () => {
+    let data = await pulseStateQuery.pull()
+    return { space: data[0], busy: data[1] > 0 }
+  }
+
   return {
     setGate: async (value) => {
       try {
@@ -39,6 +56,40 @@ export default function mosfetThing(osap, vt, name) {
         console.error(err)
       }
     },
+    // pulses are [{ delay, duration, value }], with times in seconds: each one starts delay after the last one started,
+    // holds the gate at value (0 to 1) for duration, then turns it off, and the board times them (to a few us),
+    // so a whole phrase can go in one call: if it's longer than the queue, it's sent in pieces, and the board keeps the
+    // timing across them, but each piece has to arrive before its first pulse is due, (or that one, and the rest, start late)
+    queuePulses: async (pulses) => {
+      try {
+        let chunkSize = pulses.length > PULSE_QUEUE_MAX ? PULSE_CHUNK : PULSE_QUEUE_MAX
+        for (let start = 0; start < pulses.length; start += chunkSize) {
+          let chunk = pulses.slice(start, start + chunkSize)
+          let datagram = new Uint8Array(1 + chunk.length * 9)
+          datagram[0] = chunk.length | (start > 0 ? PULSE_CONTINUES : 0)
+          chunk.forEach((pulse, p) => {
+            let ptr = 1 + p * 9
+            TS.write("uint32", Math.max(0, Math.min(PULSE_MAX_US, Math.round((pulse.delay || 0) * 1000000))), datagram, ptr)
+            TS.write("uint32", Math.max(0, Math.min(PULSE_MAX_US, Math.round(pulse.duration * 1000000))), datagram, ptr + 4)
+            datagram[ptr + 8] = Math.max(0, Math.min(255, 255 * (pulse.value == undefined ? 1 : pulse.value)))
+          })
+          // the board holds this 'till it has room,
+          await pulseEndpointMirror.write(datagram, "acked")
+        }
+      } catch (err) {
+        console.error(err)
+      }
+    },
+    getPulseState,
+    awaitPulses: async () => {
+      try {
+        while ((await getPulseState()).busy) {
+          await new Promise(resolve => setTimeout(resolve, 10))
+        }
+      } catch (err) {
+        console.error(err)
+      }
+    },
     setup,
     vt,
     api: [
@@ -47,6 +98,21 @@ export default function mosfetThing(osap, vt, name) {
         args: [
           "value: 0 to 1"
         ],
+      },
+      {
+        name: "queuePulses",
+        args: [
+          "pulses: [{ delay: seconds, duration: seconds, value: 0 to 1 }]"
+        ]
+      },
+      {
+        name: "getPulseState",
+        args: [],
+        return: "{ space, busy }"
+      },
+      {
+        name: "awaitPulses",
+        args: []
       }
     ]
   }
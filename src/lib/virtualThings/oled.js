@@ -18,6 +18,12 @@ export default function(osap, vt, name) {
   const routeToFirmware = PK.VC2VMRoute(vt.route)
   const oledEndpointMirror = osap.endpoint("oledEndpointMirror")
   oledEndpointMirror.addRoute(PK.route(routeToFirmware).sib(1).end());
+  // the 2nd vertex takes raw bitmaps, straight into the framebuffer
+  const bitmapEndpointMirror = osap.endpoint(`oledBitmapMirror_${name}`)
+  bitmapEndpointMirror.addRoute(PK.route(routeToFirmware).sib(2).end());
+
+  const SCREEN_WIDTH = 128
+  const SCREEN_HEIGHT = 64
 
   const setup = async () => { }
 
@@ -37,14 +43,34 @@ export default function(osap, vt, name) {
         console.error(err);
       }
     },
-    // writeBuffer: async (buf) => {
-    //   try {
-    //     // const datagram = new Uint8Array(10);
-    //     await oledEndpointMirror.write(buf, "acked");
-    //   } catch (err) {
-    //     console.error(err);
-    //   }
-    // },
+    // pixels are row-major, width * height, anything truthy is lit: y and height are rounded out to 8-pixel pages,
+    // and the board only re-sends the columns that changed, so redrawing a whole frame is cheap if little of it moved
+    writeBitmap: async (pixels, width = SCREEN_WIDTH, height = SCREEN_HEIGHT, x = 0, y = 0) => {
+      try {
+        if (x + width > SCREEN_WIDTH || y + height > SCREEN_HEIGHT) throw new Error(`a ${width}x${height} bitmap at ${x}, ${y} is off the screen`);
+        const firstPage = Math.floor(y / 8)
+        const lastPage = Math.floor((y + height - 1) / 8)
+        // one page (8 rows) per message,
+        for (let page = firstPage; page <= lastPage; page++) {
+          const datagram = new Uint8Array(4 + width)
+          datagram[0] = x
+          datagram[1] = page
+          datagram[2] = width
+          datagram[3] = 1
+          for (let c = 0; c < width; c++) {
+            let byte = 0
+            for (let bit = 0; bit < 8; bit++) {
+              const row = page * 8 + bit - y
+              if (row >= 0 && row < height && pixels[row * width + c]) byte |= (1 << bit)
+            }
+            datagram[4 + c] = byte
+          }
+          await bitmapEndpointMirror.write(datagram, "acked")
+        }
+      } catch (err) {
+        console.error(err);
+      }
+    },
     setup,
     vt,
     api: [
@@ -54,13 +80,17 @@ export default function(osap, vt, name) {
           "text: string",
           "textSize=2: 1 to 16"
         ]
+      },
+      {
+        name: "writeBitmap",
+        args: [
+          "pixels: array (width x height), row-major",
+          "width=128",
+          "height=64",
+          "x=0",
+          "y=0"
+        ]
       }
-      // {
-      //   name: "writeBuffer",
-      //   args: [
-      //     "buffer: Uint*Array(160 x 128)"
-      //   ]
-      // }
     ]
   }
 }
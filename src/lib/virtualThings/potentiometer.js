@@ -23,6 +23,31 @@ export default function(osap, vt, name) {
   // this is the '1th' vertex, so we address it like-this:
   let potQuery = osap.query(PK.route(routeToFirmware).sib(1).end());
 
+  // the board oversamples to 14 bits,
+  const FULL_SCALE = 16380;
+
+  // the 2nd vertex pushes both values whenever either moves past the deadband,
+  let changeRxEndpoint = osap.endpoint(`potentiometerCatcher_${name}`)
+  let onChangeHandler = (values) => { }
+  changeRxEndpoint.onData = (data) => {
+    onChangeHandler([TS.read("uint16", data, 0) / FULL_SCALE, TS.read("uint16", data, 2) / FULL_SCALE]);
+  }
+
+  // and the 3rd sets that deadband,
+  let deadbandEndpoint = osap.endpoint(`potentiometerDeadbandMirror_${name}`)
+  deadbandEndpoint.addRoute(PK.route(routeToFirmware).sib(3).end());
+
+  const setup = async () => {
+    try {
+      let source = vt.children[2]
+      try {
+        await osap.mvc.removeEndpointRoute(source.route, 0)
+      } catch (err) { }
+      await osap.mvc.setEndpointRoute(source.route, PK.route().sib(0).pfwd().sib(0).pfwd().sib(changeRxEndpoint.indice).end())
+    } catch (err) {
+      throw err
+    }
+  }
 
   return {
     readPotentiometer: async (index) => {
@@ -30,9 +55,20 @@ export default function(osap, vt, name) {
       const val0 = TS.read("uint16", data, 0);
       const val1 = TS.read("uint16", data, 2);
       const vals = [ val0, val1 ];
-      return vals[index]/1028;
+      return vals[index]/FULL_SCALE;
     },
-    setup: () => {},
+    onPotentiometerChange: (fn) => { onChangeHandler = fn; },
+    // as a fraction of full scale, 0 turns change pushes off
+    setDeadband: async (deadband) => {
+      try {
+        let datagram = new Uint8Array(2);
+        TS.write("uint16", Math.round(Math.max(0, Math.min(1, deadband)) * FULL_SCALE), datagram, 0);
+        await deadbandEndpoint.write(datagram, "acked");
+      } catch (err) {
+        console.error(err);
+      }
+    },
+    setup,
     vt,
     api: [
       {
@@ -41,6 +77,18 @@ export default function(osap, vt, name) {
           "index: int 0 to 1"
         ],
         return: "0 to 1"
+      },
+      {
+        name: "onPotentiometerChange",
+        args: [
+          "function: ([value0, value1]) => {}"
+        ]
+      },
+      {
+        name: "setDeadband",
+        args: [
+          "deadband: 0 to 1 (0 is off)"
+        ]
       }
     ]
   }
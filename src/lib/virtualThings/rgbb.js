@@ -29,6 +29,18 @@ export default function rgbbThing(osap, vt, name) {
   let rgbEndpointMirror = osap.endpoint("rgbEndpointMirror")
   rgbEndpointMirror.addRoute(PK.route(routeToFirmware).sib(1).end())
 
+  // the 3rd vertex takes keyframe animations, and the 4th starts and stops them
+  let animationEndpointMirror = osap.endpoint(`animationMirror_${name}`)
+  animationEndpointMirror.addRoute(PK.route(routeToFirmware).sib(3).end())
+  let triggerEndpointMirror = osap.endpoint(`animationTriggerMirror_${name}`)
+  triggerEndpointMirror.addRoute(PK.route(routeToFirmware).sib(4).end())
+
+  const EASINGS = { step: 0, linear: 1, inOut: 2, in: 3, out: 4 }
+  const KEYFRAME_MAX = 16
+
+  // same conversion as setRGB, since the LED is common-anode
+  const toPWM = (r, g, b) => [255 - r * 255, 255 - g * 255, 255 - (b * 255) / 2]
+
   // this is where we'll rx button states:
   let buttonRxEndpoint = osap.endpoint(`buttonCatcher_${name}`)
   buttonRxEndpoint.onData = (data) => {
@@ -74,6 +86,45 @@ export default function rgbbThing(osap, vt, name) {
         console.error(err)
       }
     },
+    // keyframes are [{ color: [r, g, b] (0 to 1), duration (seconds), easing ("linear", "inOut", "in", "out" or "step") }],
+    // each one eases from the previous color into its own, and the whole list plays loops times (0 is forever),
+    // the board runs it, so this is one packet for the lot
+    playAnimation: async (keyframes, loops = 1, start = true) => {
+      try {
+        if (keyframes.length < 1 || keyframes.length > KEYFRAME_MAX) throw new Error(`animations are 1 to ${KEYFRAME_MAX} keyframes, not ${keyframes.length}`)
+        let datagram = new Uint8Array(3 + keyframes.length * 6)
+        datagram[0] = start ? 1 : 0
+        datagram[1] = loops
+        datagram[2] = keyframes.length
+        keyframes.forEach((frame, k) => {
+          let ptr = 3 + k * 6
+          let easing = EASINGS[frame.easing || "linear"]
+          if (easing == undefined) throw new Error(`no easing named ${frame.easing}`)
+          datagram.set(toPWM(...frame.color), ptr)
+          TS.write("uint16", Math.max(1, Math.min(65535, Math.round(frame.duration * 1000))), datagram, ptr + 3)
+          datagram[ptr + 5] = easing
+        })
+        await animationEndpointMirror.write(datagram, "acked")
+      } catch (err) {
+        console.error(err)
+      }
+    },
+    // restarts the last animation we sent,
+    triggerAnimation: async () => {
+      try {
+        await triggerEndpointMirror.write(new Uint8Array([1]), "acked")
+      } catch (err) {
+        console.error(err)
+      }
+    },
+    // stops it, holding whatever color it's at
+    cancelAnimation: async () => {
+      try {
+        await triggerEndpointMirror.write(new Uint8Array([0]), "acked")
+      } catch (err) {
+        console.error(err)
+      }
+    },
     onButtonStateChange: (fn) => { onButtonStateChangeHandler = fn; },
     setup,
     vt,
@@ -86,6 +137,22 @@ export default function rgbbThing(osap, vt, name) {
           "blue: 0 to 1"
         ],
       },
+      {
+        name: "playAnimation",
+        args: [
+          "keyframes: [{ color: [r, g, b], duration: seconds, easing: 'linear' }]",
+          "loops=1: 0 is forever",
+          "start=true"
+        ]
+      },
+      {
+        name: "triggerAnimation",
+        args: []
+      },
+      {
+        name: "cancelAnimation",
+        args: []
+      },
       {
         name: "onButtonStateChange",
         args: [
@@ -23,6 +23,11 @@ export default function servo(osap, vt, name) {
   let servoPulseWidthMirror = osap.endpoint("servoPulseWidthMirror")
   servoPulseWidthMirror.addRoute(PK.route(routeToFirmware).sib(1).end())
 
+  // the 2nd vertex takes profiled targets, which the board runs at its 50Hz frame, and the 3rd tells us how it's going
+  let targetEndpointMirror = osap.endpoint(`servoTargetMirror_${name}`)
+  targetEndpointMirror.addRoute(PK.route(routeToFirmware).sib(2).end())
+  let motionStateQuery = osap.query(PK.route(routeToFirmware).sib(3).end())
+
   // we should have a setup function:
   const setup = async () => {
     try {
@@ -61,6 +66,66 @@ export default function servo(osap, vt, name) {
     }
   }
 
+  // pulse-width per degree, and back,
+  let usPerDegree = () => (pulseBounds[1] - pulseBounds[0]) / (angleBounds[1] - angleBounds[0])
+  let angleToPulse = (ang) => (ang - angleBounds[0]) * usPerDegree() + pulseBounds[0]
+  let pulseToAngle = (us) => (us - pulseBounds[0]) / usPerDegree() + angleBounds[0]
+
+  // in degrees / sec and degrees / sec^2,
+  let maxVel = 180
+  let maxAccel = 720
+
+  // in pulse-width (us) terms, the board does the profile, so this is one packet per move
+  let targetMicroseconds = async (us, _maxVel, _maxAccel) => {
+    try {
+      let datagram = new Uint8Array(13)
+      datagram[0] = 0 // MOTION_MODE_POS
+      TS.write("float32", us, datagram, 1)
+      TS.write("float32", Math.abs(_maxVel), datagram, 5)
+      TS.write("float32", Math.abs(_maxAccel), datagram, 9)
+      await targetEndpointMirror.write(datagram, "acked")
+    } catch (err) {
+      throw err
+    }
+  }
+
+  let targetAngle = async (ang, _maxVel = maxVel, _maxAccel = maxAccel) => {
+    try {
+      let lo = Math.min(angleBounds[0], angleBounds[1])
+      let hi = Math.max(angleBounds[0], angleBounds[1])
+      ang = Math.max(lo, Math.min(hi, ang))
+      let scale = Math.abs(usPerDegree())
+      await targetMicroseconds(angleToPulse(ang), _maxVel * scale, _maxAccel * scale)
+    } catch (err) {
+      throw err
+    }
+  }
+
+  let getMotionState = async () => {
+    try {
+      let data = await motionStateQuery.pull()
+      let pulse = TS.read("float32", data, 0)
+      return {
+        pulse,
+        angle: pulseToAngle(pulse),
+        vel: TS.read("float32", data, 4) / usPerDegree(),
+        done: data[32] > 0,
+      }
+    } catch (err) {
+      throw err
+    }
+  }
+
+  let awaitMotionEnd = async () => {
+    try {
+      while (!(await getMotionState()).done) {
+        await new Promise(resolve => setTimeout(resolve, 20))
+      }
+    } catch (err) {
+      throw err
+    }
+  }
+
   let setCalibration = (_pulseBounds, _angleBounds) => {
     if (!Array.isArray(_pulseBounds) || !Array.isArray(_angleBounds)) {
       throw new Error(`input args for setCalibration are both arrays`)
@@ -73,6 +138,12 @@ export default function servo(osap, vt, name) {
     writeMicroseconds,
     writeAngle,
     setCalibration,
+    targetAngle,
+    targetMicroseconds,
+    setMaxVelocity: (vel) => { maxVel = Math.abs(vel) },
+    setMaxAccel: (accel) => { maxAccel = Math.abs(accel) },
+    getMotionState,
+    awaitMotionEnd,
     setup,
     vt,
     api: [
@@ -94,6 +165,43 @@ export default function servo(osap, vt, name) {
           "pulseBounds: array",
           "angleBounds: array"
         ]
+      },
+      {
+        name: "targetAngle",
+        args: [
+          "angle: num",
+          "maxVel: degrees / sec (optional)",
+          "maxAccel: degrees / sec^2 (optional)"
+        ]
+      },
+      {
+        name: "targetMicroseconds",
+        args: [
+          "us: num",
+          "maxVel: us / sec",
+          "maxAccel: us / sec^2"
+        ]
+      },
+      {
+        name: "setMaxVelocity",
+        args: [
+          "vel: degrees / sec"
+        ]
+      },
+      {
+        name: "setMaxAccel",
+        args: [
+          "accel: degrees / sec^2"
+        ]
+      },
+      {
+        name: "getMotionState",
+        args: [],
+        return: "{ pulse, angle, vel, done }"
+      },
+      {
+        name: "awaitMotionEnd",
+        args: []
       }
     ]
   }
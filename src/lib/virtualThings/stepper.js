@@ -11,12 +11,20 @@ no warranty is provided, and users accept all liability.
 
 import PK from "../osapjs/core/packets.js"
 import { TS } from "../osapjs/core/ts.js"
+import TIME from "../osapjs/core/time.js"
+
+// the host clock that firmware timestamps are sync'd to, in (wrapping) 32-bit microseconds
+export const hostMicros = () => { return Math.round(TIME.getTimeStamp() * 1000) >>> 0 }
 
 export default function stepper(osap, vt, name) {
   // local state
   let onButtonStateChangeHandler = (state) => {
     console.warn(`default button state change in ${name}, to ${state}`);
   }
+  let onTelemetryHandler = (samples) => {
+    console.warn(`default telemetry handler in ${name}, ${samples.length} samples`);
+  }
+  let onMotionEventHandler = (evt) => { }
 
   // the "vt.route" goes to our partner's "root vertex" - but we
   // want to address relative siblings, so I use this utility:
@@ -35,11 +43,76 @@ export default function stepper(osap, vt, name) {
   // -------------------------------------------- 4: settings,
   let settingsEndpoint = osap.endpoint(`settingsMirror_${name}`)
   settingsEndpoint.addRoute(PK.route(routeToFirmware).sib(4).end())
-  // -------------------------------------------- 5: a button, not yet programmed
+  // -------------------------------------------- 5: a button, or limit switch, the firmware pushes its state
   let buttonRxEndpoint = osap.endpoint(`buttonCatcher_${name}`)
   buttonRxEndpoint.onData = (data) => {
     onButtonStateChangeHandler(data[0] > 0 ? true : false);
   }
+  // -------------------------------------------- 6: segment queue, for sequential motion
+  let segmentEndpoint = osap.endpoint(`segmentQueueMirror_${name}`)
+  segmentEndpoint.addRoute(PK.route(routeToFirmware).sib(6).end())
+  // the firmware holds segments back 'till it has queue space, so acks can take a while
+  segmentEndpoint.setTimeoutLength(30000)
+  // -------------------------------------------- 7: motion telemetry, we write the sample rate, it streams samples back
+  let telemetryEndpoint = osap.endpoint(`telemetryMirror_${name}`)
+  telemetryEndpoint.addRoute(PK.route(routeToFirmware).sib(7).end())
+  let telemetryRxEndpoint = osap.endpoint(`telemetryCatcher_${name}`)
+  // the integrator runs at 10kHz, so sample times are sampleNum * decimation / 10000
+  let integratorRate = 10000
+  let telemetryDecimation = 0
+  telemetryRxEndpoint.onData = (data) => {
+    let sampleNum = TS.read("uint32", data, 0)
+    let count = data[4]
+    let samples = []
+    for (let s = 0; s < count; s++) {
+      let ptr = 5 + s * 12
+      samples.push({
+        sampleNum: sampleNum + s,
+        time: (sampleNum + s) * telemetryDecimation / integratorRate,
+        pos: TS.read("float32", data, ptr) / spu,
+        vel: TS.read("float32", data, ptr + 4) / spu,
+        accel: TS.read("float32", data, ptr + 8) / spu,
+      })
+    }
+    onTelemetryHandler(samples)
+  }
+  // -------------------------------------------- 8: time sync, we query the firmware's clock and write back what time it was on ours
+  let timeSyncQuery = osap.query(PK.route(routeToFirmware).sib(8).end())
+  let timeSyncEndpoint = osap.endpoint(`timeSyncMirror_${name}`)
+  timeSyncEndpoint.addRoute(PK.route(routeToFirmware).sib(8).end())
+  // -------------------------------------------- 9: group targets, one frame w/ slices for a few axes, see synchronizer.js
+  let groupTargetEndpoint = osap.endpoint(`groupTargetMirror_${name}`)
+  groupTargetEndpoint.addRoute(PK.route(routeToFirmware).sib(9).end())
+  // -------------------------------------------- 10: ISR timing, queries get stats, writes reset them
+  let timingQuery = osap.query(PK.route(routeToFirmware).sib(10).end())
+  let timingEndpoint = osap.endpoint(`timingMirror_${name}`)
+  timingEndpoint.addRoute(PK.route(routeToFirmware).sib(10).end())
+  // -------------------------------------------- 11: homing & limits, writes start homing (or set limit stops), queries get its state
+  let homingQuery = osap.query(PK.route(routeToFirmware).sib(11).end())
+  let homingEndpoint = osap.endpoint(`homingMirror_${name}`)
+  homingEndpoint.addRoute(PK.route(routeToFirmware).sib(11).end())
+  const HOMING_PHASES = ["idle", "seek", "backoff", "approach", "done", "failed"]
+  // -------------------------------------------- 12: motion events, the firmware pushes these when it gets somewhere (or doesn't)
+  let eventRxEndpoint = osap.endpoint(`motionEventCatcher_${name}`)
+  const MOTION_EVENTS = ["targetReached", "velocityReached", "limit", "fault"]
+  // awaitMotionEnd() waits on these, rather than polling: each waiter has the first eventNum it'll take,
+  // so a rest event left over from the last target doesn't count for this one
+  let restWaiters = []
+  eventRxEndpoint.onData = (data) => {
+    let evt = {
+      type: MOTION_EVENTS[data[0]],
+      code: data[1],
+      eventNum: TS.read("uint32", data, 2),
+      pos: TS.read("float32", data, 6) / spu,
+      vel: TS.read("float32", data, 10) / spu,
+    }
+    if (evt.type == "targetReached" || (evt.type == "velocityReached" && evt.vel == 0)) {
+      let waiters = restWaiters
+      restWaiters = waiters.filter(w => evt.eventNum < w.from)
+      for (let w of waiters) if (evt.eventNum >= w.from) w.resolve(evt)
+    }
+    onMotionEventHandler(evt)
+  }
   // -------------------------------------------- we need a setup,
   const setup = async () => {
     // erp, but this firmware actually is all direct-write, nothing streams back
@@ -60,6 +133,18 @@ export default function stepper(osap, vt, name) {
       }
       // so we build a route from that thing (the source) to us, using this mvc-api:
       await osap.mvc.setEndpointRoute(source.route, routeUp)
+      // and the same for telemetry, from the 7th endpoint,
+      let telemetrySource = vt.children[7]
+      try {
+        await osap.mvc.removeEndpointRoute(telemetrySource.route, 0)
+      } catch (err) { }
+      await osap.mvc.setEndpointRoute(telemetrySource.route, PK.route().sib(0).pfwd().sib(0).pfwd().sib(telemetryRxEndpoint.indice).end())
+      // and events, from the 12th,
+      let eventSource = vt.children[12]
+      try {
+        await osap.mvc.removeEndpointRoute(eventSource.route, 0)
+      } catch (err) { }
+      await osap.mvc.setEndpointRoute(eventSource.route, PK.route().sib(0).pfwd().sib(0).pfwd().sib(eventRxEndpoint.indice).end())
     } catch (err) {
       throw err
     }
@@ -75,6 +160,7 @@ export default function stepper(osap, vt, name) {
   let absMaxAccel = 10000
   let lastVel = absMaxVelocity
   let lastAccel = 100             // units / sec
+  let lastJerk = 0                // units / sec^3, zero for plain trapezoids
 
   let setPosition = async (pos) => {
     try {
@@ -101,6 +187,15 @@ export default function stepper(osap, vt, name) {
     lastAccel = accel
   }
 
+  // with a jerk limit, position targets ramp their accel in and out (s-curves) instead of switching it on and off,
+  // which is gentler on the machine, for a little more time per move: zero turns it back off
+  let setJerk = async (jerk) => {
+    if (!(jerk > 0)) jerk = 0
+    lastJerk = jerk
+  }
+
+  let getJerk = () => { return lastJerk }
+
   let setAbsMaxAccel = (maxAccel) => { absMaxAccel = maxAccel }
 
   let setAbsMaxVelocity = (maxVel) => {
@@ -111,8 +206,13 @@ export default function stepper(osap, vt, name) {
     absMaxVelocity = maxVel
   }
 
+  // the firmware starts up at these,
+  let currentScale = 0.05
+  let microsteps = 4
+
   let setCurrentScale = async (cscale) => {
     try {
+      currentScale = cscale
       let datagram = new Uint8Array(4)
       let wptr = 0
       wptr += TS.write("float32", cscale, datagram, wptr)  // it's 0-1, firmware checks
@@ -123,8 +223,34 @@ export default function stepper(osap, vt, name) {
     }
   }
 
+  // microstepping, as 1/n of a full step: 1 thru 64, powers of two, 4 by default,
+  // since positions (and spu) are counted in microsteps, we scale spu along w/ it, and re-set the position to match
+  let setMicrosteps = async (n) => {
+    try {
+      if (!Number.isInteger(n) || n < 1 || n > 64 || (n & (n - 1)) != 0) throw new Error(`microsteps should be 1 - 64, in powers of two, not ${n}`)
+      // nothing should be moving while we do this,
+      await stop()
+      let pos = await getPosition()
+      let datagram = new Uint8Array(5)
+      let wptr = 0
+      wptr += TS.write("float32", currentScale, datagram, wptr)
+      datagram[wptr++] = n
+      await settingsEndpoint.write(datagram, "acked")
+      setStepsPerUnit(spu * n / microsteps)
+      microsteps = n
+      // and tell the firmware where we are, in the new microsteps,
+      datagram = new Uint8Array(4)
+      TS.write("float32", pos * spu, datagram, 0)
+      await positionSetEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let getMicrosteps = () => { return microsteps }
+
   // tell me about your steps-per-unit,
-  // note that FW currently does 1/4 stepping: 800 steps / revolution
+  // note that FW starts up doing 1/4 stepping: 800 steps / revolution, see setMicrosteps
   let setStepsPerUnit = (_spu) => {
     spu = _spu
     if (absMaxVelocity > 4000 / spu) { absMaxVelocity = 4000 / spu }
@@ -143,6 +269,10 @@ export default function stepper(osap, vt, name) {
         pos: TS.read("float32", data, 0) / spu,
         vel: TS.read("float32", data, 4) / spu,
         accel: TS.read("float32", data, 8) / spu,
+        // targets the firmware has, but hasn't started on yet (timed starts wait in there),
+        pending: data.length > 32 ? data[32] : 0,
+        // and how many events it had sent when it answered,
+        eventCount: data.length > 36 ? TS.read("uint32", data, 33) : 0,
       }
     } catch (err) {
       console.error(err)
@@ -173,29 +303,69 @@ export default function stepper(osap, vt, name) {
 
   // -------------------------------------------- Operative
 
-  // await no motion,
+  // await no motion: the firmware pushes an event when it comes to rest, so we only ask once, in case we're there already,
+  // (and every so often after that, in case an event goes missing)
+  // a target w/ an execute-at time sits in the firmware's command ring 'till then, and we're still at rest, so that doesn't count,
+  // once it's applied, we wait for a rest event numbered after the state we read
   let awaitMotionEnd = async () => {
     try {
-      return new Promise(async (resolve, reject) => {
-        let check = () => {
-          getState().then((states) => {
-            // console.log(`${name}\t acc ${states.accel.toFixed(4)},\t vel ${states.vel.toFixed(4)},\t pos ${states.pos.toFixed(4)}`)
-            if (states.vel < 0.001 && states.vel > -0.001) {
-              resolve()
-            } else {
-              setTimeout(check, 10)
-            }
-          }).catch((err) => { throw err })
+      while (true) {
+        let states = await getState()
+        if (states.pending > 0) {
+          await TIME.delay(10)
+          continue
         }
-        check()
-      })
+        if (states.vel < 0.001 && states.vel > -0.001) return
+        let waiter = { from: states.eventCount }
+        let arrived = new Promise((resolve) => { waiter.resolve = resolve })
+        restWaiters.push(waiter)
+        let timeout = new Promise((resolve) => { setTimeout(() => resolve(null), 1000) })
+        let evt = await Promise.race([arrived, timeout])
+        restWaiters = restWaiters.filter(w => w !== waiter)
+        if (evt) return
+      }
     } catch (err) {
       console.error(err)
     }
   }
 
-  // sets the position-target, and delivers rates, accels to use while slewing-to
-  let target = async (pos, vel, accel) => {
+  // -------------------------------------------- Clock Sync
+
+  // a few round trips to the firmware's clock, we keep the quickest, and assume it read its clock halfway thru:
+  // the firmware uses that to map our times onto its own, and (over a few syncs) to learn how fast its clock runs
+  let lastClockSync = null
+  let syncClock = async (exchanges = 8) => {
+    try {
+      let best = null
+      for (let e = 0; e < exchanges; e++) {
+        let sent = TIME.getTimeStamp()
+        let data = await timeSyncQuery.pull()
+        let rxd = TIME.getTimeStamp()
+        if (best == null || rxd - sent < best.rtt) {
+          best = {
+            rtt: rxd - sent,
+            hostTime: Math.round((sent + rxd) * 500) >>> 0,
+            deviceTime: TS.read("uint32", data, 0),
+          }
+        }
+      }
+      let datagram = new Uint8Array(8)
+      TS.write("uint32", best.hostTime, datagram, 0)
+      TS.write("uint32", best.deviceTime, datagram, 4)
+      await timeSyncEndpoint.write(datagram, "acked")
+      lastClockSync = TIME.getTimeStamp()
+      return best.rtt
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let getLastClockSync = () => { return lastClockSync }
+
+  // sets the position-target, and delivers rates, accels to use while slewing-to,
+  // w/ an optional time (from hostMicros()) to start at, once clocks are sync'd,
+  // and an optional jerk for just this move (synchronizers scale it per-axis), otherwise it's the modal one from setJerk()
+  let target = async (pos, vel, accel, executeAt, jerk) => {
     try {
       // modal vel-and-accels, and guards
       vel ? lastVel = vel : vel = lastVel;
@@ -204,14 +374,18 @@ export default function stepper(osap, vt, name) {
       if (vel > absMaxVelocity) { vel = absMaxVelocity; lastVel = vel; }
       // also, warn against zero-or-negative velocities & accelerations
       if (vel <= 0 || accel <= 0) throw new Error(`y'all are trying to go somewhere, but modal velocity or accel are negative, this won't do...`)
-      // stuff a packet,
-      let datagram = new Uint8Array(13)
+      if (jerk == undefined) jerk = lastJerk
+      // stuff a packet, (w/ the jerk, if there is one)
+      let len = jerk > 0 ? 17 : 13
+      let datagram = new Uint8Array(executeAt != undefined ? len + 4 : len)
       let wptr = 0
-      datagram[wptr++] = 0 // MOTION_MODE_POS
+      datagram[wptr++] = jerk > 0 ? 4 : 0 // MOTION_MODE_SCURVE or MOTION_MODE_POS
       // write pos, vel, accel *every time* and convert-w-spu on the way out,
       wptr += TS.write("float32", pos * spu, datagram, wptr)  // write posn
       wptr += TS.write("float32", vel * spu, datagram, wptr)  // write max-vel-during
       wptr += TS.write("float32", accel * spu, datagram, wptr)  // write max-accel-during
+      if (jerk > 0) wptr += TS.write("float32", jerk * spu, datagram, wptr)  // and max-jerk
+      if (executeAt != undefined) wptr += TS.write("uint32", executeAt >>> 0, datagram, wptr)
       // and we can shippity ship it,
       await targetDataEndpoint.write(datagram, "acked")
     } catch (err) {
@@ -219,11 +393,104 @@ export default function stepper(osap, vt, name) {
     }
   }
 
+  // appends a move to the firmware's queue, it will carry on into the next segment without stopping
+  // (if that's in the same direction), resolves when the segment is queued, not when it's done
+  // w/ a pathLength, it's this motor's share of a synchronizer's line instead, see synchronizer.js
+  let segment = async (pos, vel, accel, pathLength, junctionVel) => {
+    try {
+      // a synchronizer's line: rates are the line's, in its units, so we hand them thru as they are (and don't touch our modal rates)
+      if (pathLength > 0) {
+        let datagram = new Uint8Array(20)
+        let wptr = 0
+        wptr += TS.write("float32", pos * spu, datagram, wptr)
+        wptr += TS.write("float32", vel, datagram, wptr)
+        wptr += TS.write("float32", accel, datagram, wptr)
+        wptr += TS.write("float32", pathLength, datagram, wptr)
+        wptr += TS.write("float32", junctionVel ? junctionVel : 0, datagram, wptr)
+        await segmentEndpoint.write(datagram, "acked")
+        return
+      }
+      vel ? lastVel = vel : vel = lastVel;
+      accel ? lastAccel = accel : accel = lastAccel;
+      if (accel > absMaxAccel) { accel = absMaxAccel; lastAccel = accel; }
+      if (vel > absMaxVelocity) { vel = absMaxVelocity; lastVel = vel; }
+      if (vel <= 0 || accel <= 0) throw new Error(`y'all are trying to go somewhere, but modal velocity or accel are negative, this won't do...`)
+      // <pos, vel, accel, pathLength, junctionVel>, and w/o a path, those last two are left at zero
+      let datagram = new Uint8Array(20)
+      let wptr = 0
+      wptr += TS.write("float32", pos * spu, datagram, wptr)
+      wptr += TS.write("float32", vel * spu, datagram, wptr)
+      wptr += TS.write("float32", accel * spu, datagram, wptr)
+      await segmentEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // -------------------------------------------- Group Targets
+
+  // a synchronizer's frames hold slices for a few axes, and the firmware picks its own slice out of them:
+  // so we tell the firmware which axis it is, and build our slice (in steps) for those frames
+  let groupAxis = null
+  let setGroupAxis = async (axis) => {
+    try {
+      let datagram = new Uint8Array(2)
+      datagram[0] = 255 // GROUP_ASSIGN_AXIS
+      datagram[1] = axis
+      await groupTargetEndpoint.write(datagram, "acked")
+      groupAxis = axis
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let getGroupAxis = () => { return groupAxis }
+
+  // <u8 axis, f32 pos, f32 vel, f32 accel, (f32 jerk)>, w/ the same modal rates, jerk and guards as .target(),
+  // the jerk is only there for s-curves, and a frame's slices all need to be the same length, so the synchronizer pads the rest w/ zero jerk
+  let groupTargetSlice = (pos, vel, accel, jerk) => {
+    vel ? lastVel = vel : vel = lastVel;
+    accel ? lastAccel = accel : accel = lastAccel;
+    if (accel > absMaxAccel) { accel = absMaxAccel; lastAccel = accel; }
+    if (vel > absMaxVelocity) { vel = absMaxVelocity; lastVel = vel; }
+    if (vel <= 0 || accel <= 0) throw new Error(`y'all are trying to go somewhere, but modal velocity or accel are negative, this won't do...`)
+    if (jerk == undefined) jerk = lastJerk
+    let slice = new Uint8Array(jerk > 0 ? 17 : 13)
+    let wptr = 0
+    slice[wptr++] = groupAxis
+    wptr += TS.write("float32", pos * spu, slice, wptr)
+    wptr += TS.write("float32", vel * spu, slice, wptr)
+    wptr += TS.write("float32", accel * spu, slice, wptr)
+    if (jerk > 0) wptr += TS.write("float32", jerk * spu, slice, wptr)
+    return slice
+  }
+
+  // <u8 axis, f32 vel, f32 accel>, as .velocity()
+  let groupVelocitySlice = (vel, accel) => {
+    accel ? lastAccel = accel : accel = lastAccel;
+    if (accel > absMaxAccel) { accel = absMaxAccel; lastAccel = accel; }
+    if (vel > absMaxVelocity) { vel = absMaxVelocity; lastVel = vel; }
+    let slice = new Uint8Array(9)
+    let wptr = 0
+    slice[wptr++] = groupAxis
+    wptr += TS.write("float32", vel * spu, slice, wptr)
+    wptr += TS.write("float32", accel * spu, slice, wptr)
+    return slice
+  }
+
+  let writeGroupFrame = async (frame) => {
+    try {
+      await groupTargetEndpoint.write(frame, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
   // goto-this-posn, using optional vel, accel, and wait for machine to get there
-  let absolute = async (pos, vel, accel) => {
+  let absolute = async (pos, vel, accel, executeAt, jerk) => {
     try {
       // sets motion target,
-      await target(pos, vel, accel)
+      await target(pos, vel, accel, executeAt, jerk)
       // then we could do... await-move-done ?
       await awaitMotionEnd()
       console.log(`abs move to ${pos} done`)
@@ -245,7 +512,7 @@ export default function stepper(osap, vt, name) {
   }
 
   // goto-this-speed, using optional accel,
-  let velocity = async (vel, accel) => {
+  let velocity = async (vel, accel, executeAt) => {
     try {
       // modal accel, and guards...
       accel ? lastAccel = accel : accel = lastAccel;
@@ -254,11 +521,12 @@ export default function stepper(osap, vt, name) {
       // note that we are *not* setting last-vel w/r/t this velocity... esp. since we often call this
       // w/ zero-vel, to stop...
       // now write the paquet,
-      let datagram = new Uint8Array(9)
+      let datagram = new Uint8Array(executeAt != undefined ? 13 : 9)
       let wptr = 0
       datagram[wptr++] = 1 // MOTION_MODE_VEL
       wptr += TS.write("float32", vel * spu, datagram, wptr)  // write max-vel-during
       wptr += TS.write("float32", accel * spu, datagram, wptr)  // write max-accel-during
+      if (executeAt != undefined) wptr += TS.write("uint32", executeAt >>> 0, datagram, wptr)
       // mkheeeey
       await targetDataEndpoint.write(datagram, "acked")
     } catch (err) {
@@ -266,6 +534,131 @@ export default function stepper(osap, vt, name) {
     }
   }
 
+  // stream pos, vel, accel samples at ~ this rate (samples / sec), in batches, to the handler,
+  // sample numbers count every sample taken, so gaps mean we dropped some
+  let streamTelemetry = async (rate, handler) => {
+    try {
+      if (handler) onTelemetryHandler = handler
+      let decimation = rate > 0 ? Math.max(1, Math.round(integratorRate / rate)) : 0
+      if (decimation > 65535) decimation = 65535
+      telemetryDecimation = decimation
+      let datagram = new Uint8Array(2)
+      TS.write("uint16", decimation, datagram, 0)
+      await telemetryEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let stopTelemetry = async () => {
+    await streamTelemetry(0)
+  }
+
+  // how long the firmware's motion ISR takes, and how regularly it runs, since the last reset:
+  // times in microseconds, histograms as counts, cost in eighths of the tick period (the last bin includes overruns),
+  // and interval in 1us bins around the nominal period (the middle bin is on time, the ends are 3us+ off)
+  let getTiming = async () => {
+    try {
+      let data = await timingQuery.pull()
+      let cpuHz = TS.read("uint32", data, 0)
+      let us = (cycles) => { return cycles * 1000000 / cpuHz }
+      let readStat = (ptr) => {
+        let hist = []
+        for (let b = 0; b < 8; b++) hist.push(TS.read("uint32", data, ptr + 12 + b * 4))
+        return {
+          min: us(TS.read("uint32", data, ptr)),
+          max: us(TS.read("uint32", data, ptr + 4)),
+          mean: us(TS.read("float32", data, ptr + 8)),
+          hist,
+        }
+      }
+      let tick = us(TS.read("uint32", data, 4))
+      let cost = readStat(12)
+      return {
+        tick,
+        count: TS.read("uint32", data, 8),
+        cost,
+        interval: readStat(56),
+        // worst-case fraction of the tick period that the ISR eats,
+        load: cost.max / tick,
+      }
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let resetTiming = async () => {
+    try {
+      await timingEndpoint.write(new Uint8Array(1), "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // -------------------------------------------- Homing
+
+  // the firmware seeks the switch (at vel, in this direction: 1 or -1), backs off, and comes back in slowly (at latchVel),
+  // where the switch trips that time is zero, and it parks backoff away from it... all on its own, so we just wait on it
+  let home = async (dir = -1, vel, latchVel, accel, backoff = 5, maxTravel = 1000) => {
+    try {
+      vel ? vel = Math.min(vel, absMaxVelocity) : vel = lastVel;
+      latchVel ? latchVel = Math.min(latchVel, vel) : latchVel = vel * 0.1;
+      accel ? accel = Math.min(accel, absMaxAccel) : accel = lastAccel;
+      if (vel <= 0 || accel <= 0) throw new Error(`homing needs some positive velocity and accel, not ${vel} and ${accel}`)
+      let datagram = new Uint8Array(21)
+      let wptr = 0
+      datagram[wptr++] = 0 // HOMING_START
+      wptr += TS.write("float32", (dir < 0 ? -vel : vel) * spu, datagram, wptr)
+      wptr += TS.write("float32", latchVel * spu, datagram, wptr)
+      wptr += TS.write("float32", accel * spu, datagram, wptr)
+      wptr += TS.write("float32", backoff * spu, datagram, wptr)
+      wptr += TS.write("float32", maxTravel * spu, datagram, wptr)
+      await homingEndpoint.write(datagram, "acked")
+      let state = await awaitHoming()
+      if (state.phase != "done") throw new Error(`${name}'s homing ended ${state.phase}, w/ a max travel of ${maxTravel} units`)
+      return state
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // if set, a limit switch hit (outside of homing) stops the motor dead, and drops any queued segments
+  let setLimitStop = async (enable) => {
+    try {
+      let datagram = new Uint8Array(2)
+      datagram[0] = 1 // HOMING_LIMIT_STOP
+      datagram[1] = enable ? 1 : 0
+      await homingEndpoint.write(datagram, "acked")
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // limitPos is where the motor was at the last switch press, in the units of the time
+  let getHomingState = async () => {
+    try {
+      let data = await homingQuery.pull()
+      return {
+        phase: HOMING_PHASES[data[0]],
+        switchDown: data[1] > 0,
+        limitCount: TS.read("uint32", data, 2),
+        limitPos: TS.read("float32", data, 6) / spu,
+      }
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  let awaitHoming = async () => {
+    let state = await getHomingState()
+    while (state.phase != "done" && state.phase != "failed" && state.phase != "idle") {
+      await new Promise((resolve) => setTimeout(resolve, 20))
+      state = await getHomingState()
+    }
+    await awaitMotionEnd()
+    return state
+  }
+
   // stop !
   let stop = async () => {
     try {
@@ -280,25 +673,47 @@ export default function stepper(osap, vt, name) {
   return {
     // operate w/
     target,
+    segment,
     absolute,
     relative,
     velocity,
     stop,
     awaitMotionEnd,
+    home,
+    awaitHoming,
+    setLimitStop,
+    getHomingState,
+    streamTelemetry,
+    stopTelemetry,
+    syncClock,
+    getLastClockSync,
+    getTiming,
+    resetTiming,
+    // group frames, for synchronizers
+    setGroupAxis,
+    getGroupAxis,
+    groupTargetSlice,
+    groupVelocitySlice,
+    writeGroupFrame,
     // setters...
     setPosition,
     setVelocity,
     setAccel,
+    setJerk,
     setAbsMaxAccel,
     setAbsMaxVelocity,
     setCurrentScale,
+    setMicrosteps,
     setStepsPerUnit,
     // inspect...
     getPosition,
     getVelocity,
     getAbsMaxVelocity,
     getAbsMaxAccel,
+    getJerk,
+    getMicrosteps,
     onButtonStateChange: (fn) => { onButtonStateChangeHandler = fn; },
+    onMotionEvent: (fn) => { onMotionEventHandler = fn; },
     // these are hidden
     setup,
     vt,
@@ -315,6 +730,12 @@ export default function stepper(osap, vt, name) {
           "delta: number",
         ]
       },
+      {
+        name: "segment",
+        args: [
+          "pos: number",
+        ]
+      },
       {
         name: "setVelocity",
         args: [
@@ -327,6 +748,12 @@ export default function stepper(osap, vt, name) {
           "accel: number",
         ]
       },
+      {
+        name: "setJerk",
+        args: [
+          "jerk: number (0 for none)",
+        ]
+      },
       {
         name: "setPosition",
         args: [
@@ -337,6 +764,69 @@ export default function stepper(osap, vt, name) {
         name: "stop",
         args: []
       },
+      {
+        name: "home",
+        args: [
+          "dir: 1 or -1",
+          "vel: number",
+          "latchVel: number",
+          "accel: number",
+          "backoff: number",
+          "maxTravel: number"
+        ],
+        return: "{ phase, switchDown, limitCount, limitPos }"
+      },
+      {
+        name: "setLimitStop",
+        args: [
+          "enable: boolean"
+        ]
+      },
+      {
+        name: "getHomingState",
+        args: [],
+        return: `
+          {
+            phase: "idle" | "seek" | "backoff" | "approach" | "done" | "failed",
+            switchDown: boolean,
+            limitCount: number,
+            limitPos: number
+          }
+        `
+      },
+      {
+        name: "streamTelemetry",
+        args: [
+          "rate: number (samples / sec)",
+          "handler: (samples) => void"
+        ]
+      },
+      {
+        name: "stopTelemetry",
+        args: []
+      },
+      {
+        name: "syncClock",
+        args: [],
+        return: "number (best round trip, ms)"
+      },
+      {
+        name: "getTiming",
+        args: [],
+        return: `
+          {
+            tick: number (us),
+            count: number,
+            cost: { min, max, mean (us), hist: number[8] },
+            interval: { min, max, mean (us), hist: number[8] },
+            load: number (worst cost / tick)
+          }
+        `
+      },
+      {
+        name: "resetTiming",
+        args: []
+      },
       {
         name: "awaitMotionEnd",
         args: []
@@ -363,6 +853,12 @@ export default function stepper(osap, vt, name) {
           "cscale: number 0 - 1",
         ]
       },
+      {
+        name: "setMicrosteps",
+        args: [
+          "microsteps: number 1 - 64, powers of two",
+        ]
+      },
       {
         name: "setStepsPerUnit",
         args: [
@@ -374,6 +870,12 @@ export default function stepper(osap, vt, name) {
         args: [
           "function: (buttonState) => {}"
         ]
+      },
+      {
+        name: "onMotionEvent",
+        args: [
+          "function: ({ type, code, eventNum, pos, vel }) => {}"
+        ]
       }
     ]
   }
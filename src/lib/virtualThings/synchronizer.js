@@ -40,6 +40,21 @@ machine.stop()
 - this is complex in surprising ways...
 */
 
+import TIME from "../osapjs/core/time.js"
+import { TS } from "../osapjs/core/ts.js"
+import { hostMicros } from "./stepper.js"
+
+// timed starts: each move is scheduled this far out, which needs to cover writing to every actuator,
+// and clocks are re-sync'd when they're older than this (they drift a little, and the firmware learns by how much)
+const START_LEAD_MS = 20
+const CLOCK_SYNC_INTERVAL_MS = 2000
+// group frames: this many axes' slices (at up to 17 bytes each) fit comfortably in one frame,
+const GROUP_MAX_AXES = 12
+// queued segments whose directions are this close (as the dot product of their unit vectors) are straight on, or a reversal,
+const SEGMENT_COLLINEAR = 0.999999
+// and we take the corners between the rest as if they were an arc that passes this close to the corner (in actuator units), see junctionVel()
+const JUNCTION_DEVIATION = 0.05
+
 // addition...
 let vectorAddition = (A, B) => {
   return A.map((a, i) => { return A[i] + B[i] })
@@ -71,6 +86,8 @@ let unitVector = (A, B) => {
   return unit
 }
 
+// actuators are steppers, or dc-encoder things (whose firmware runs the same integrator on their setpoint),
+// anything w/ the same target / absolute / velocity / ... fns will do, and the optional ones (clock sync, group frames) are used if all have 'em
 export default function createSynchronizer(actuators) {
   if (!Array.isArray(actuators)) throw new Error(`pls, an array of actuators`)
   // some state... our most-recently used accel & velocity,
@@ -78,8 +95,86 @@ export default function createSynchronizer(actuators) {
   // and what the machine. requests of them,
   let lastAccel = 100
   let lastVel = 100
+  // and jerk, for s-curves: null leaves each motor w/ its own (from its setJerk()), otherwise it's the path's, and we split it up as we do accels
+  let lastJerk = null
   // sometimes we know this, and that can speed things up, other times we are unawares
   let lastAbsolute = null
+  // and the direction (and rates) of the last queued segment, if the queue might still be running it
+  let lastSegmentUnit = null
+  let lastSegmentRates = null
+  let junctionDeviation = JUNCTION_DEVIATION
+
+  // -------------------------------------------- Timed Starts
+
+  // if all of our actuators keep sync'd clocks, we can schedule moves to start together, instead of whenever each packet lands,
+  let timed = actuators.every(actu => typeof actu.syncClock === "function")
+
+  let syncClocks = async () => {
+    await Promise.all(actuators.map(actu => actu.syncClock()))
+  }
+
+  // returns an "execute at" time for the next move, or undefined if we can't do that,
+  let startTime = async () => {
+    if (!timed) return undefined
+    let stale = actuators.some(actu => {
+      let last = actu.getLastClockSync()
+      return last == null || TIME.getTimeStamp() - last > CLOCK_SYNC_INTERVAL_MS
+    })
+    if (stale) await syncClocks()
+    return (hostMicros() + START_LEAD_MS * 1000) >>> 0
+  }
+
+  // -------------------------------------------- Group Frames
+
+  // a frame has a slice (target and rates) for each axis, and one executeAt for all of them, and each motor picks out its own slice...
+  // on first use, we tell each which axis it is,
+  let grouped = actuators.length <= GROUP_MAX_AXES && actuators.every(actu => typeof actu.setGroupAxis === "function")
+  let groupReady = false
+
+  let groupSetup = async () => {
+    if (!grouped) return false
+    if (!groupReady) {
+      await Promise.all(actuators.map((actu, i) => actu.setGroupAxis(i)))
+      groupReady = actuators.every((actu, i) => actu.getGroupAxis() == i)
+      // if that didn't work out, we carry on w/ per-motor packets,
+      if (!groupReady) grouped = false
+    }
+    return groupReady
+  }
+
+  // <u8 mode, u8 count, u8 timed, (u32 executeAt)> then the slices,
+  let groupFrame = (mode, slices, executeAt) => {
+    // position slices w/ a jerk on the end make it an s-curve frame (MOTION_MODE_SCURVE), and the rest get a zero jerk, (i.e. a trapezoid)
+    if (mode == 0 && slices.some(slice => slice.length == 17)) {
+      mode = 4
+      slices = slices.map(slice => {
+        if (slice.length == 17) return slice
+        let padded = new Uint8Array(17)
+        padded.set(slice, 0)
+        return padded
+      })
+    }
+    let timed = executeAt != undefined
+    let length = 3 + (timed ? 4 : 0) + slices.reduce((sum, slice) => sum + slice.length, 0)
+    let frame = new Uint8Array(length)
+    let wptr = 0
+    frame[wptr++] = mode
+    frame[wptr++] = slices.length
+    frame[wptr++] = timed ? 1 : 0
+    if (timed) wptr += TS.write("uint32", executeAt >>> 0, frame, wptr)
+    for (let slice of slices) {
+      frame.set(slice, wptr)
+      wptr += slice.length
+    }
+    return frame
+  }
+
+  // to be plain about it: every motor here is on its own link, so this is still one packet per motor, no fewer than per-motor targets,
+  // and the only thing we gain is the one executeAt they share... so each motor is sent just its own slice, rather than the whole frame
+  // (that'd be N slices to each of N motors), the whole frame only pays off on a bus, sent once on a broadcast route (osap's buildBroadcastRoute)
+  let writeGroupFrame = async (mode, slices, executeAt) => {
+    await Promise.all(actuators.map((actu, i) => actu.writeGroupFrame(groupFrame(mode, [slices[i]], executeAt))))
+  }
 
   // -------------------------------------------- Setters
 
@@ -99,6 +194,12 @@ export default function createSynchronizer(actuators) {
   // and the accel to use,
   let setAccel = (accel) => { lastAccel = accel }
 
+  // and the jerk, along the path: zero for trapezoids, or null to hand each motor's own jerk thru
+  let setJerk = (jerk) => { lastJerk = (jerk == null) ? null : Math.max(jerk, 0) }
+
+  // how far off the corner we let queued segments' junctions "round", bigger is faster thru corners, zero stops at each
+  let setJunctionDeviation = (deviation) => { junctionDeviation = Math.max(deviation, 0) }
+
   // -------------------------------------------- Getters
 
   let getPosition = async () => {
@@ -125,25 +226,65 @@ export default function createSynchronizer(actuators) {
     try {
       // just await all stop,
       await Promise.all(actuators.map(actu => actu.awaitMotionEnd()))
+      lastSegmentUnit = null
     } catch (err) {
       console.error(err)
     }
   }
 
   // todo... just aim at it, don't await end,
-  let target = async (pos, vels, accels) => {
+  let target = async (pos, vels, accels, jerks) => {
     try {
       // set all downstream...
       // we can't really do 'sync' stuff for a target, since we are asking each motor to slew from wherever it is to this new posn,
       // but we could optionally pass in arrays of vels / accels for the motors to use,
-      await Promise.all(actuators.map((actu, i) => { return actu.target(pos[i], vels ? vels[i] : undefined, accels ? accels[i] : undefined) }))
+      let executeAt = await startTime()
+      if (await groupSetup()) {
+        await writeGroupFrame(0, actuators.map((actu, i) => {
+          return actu.groupTargetSlice(pos[i], vels ? vels[i] : undefined, accels ? accels[i] : undefined, jerks ? jerks[i] : undefined)
+        }), executeAt)
+      } else {
+        await Promise.all(actuators.map((actu, i) => { return actu.target(pos[i], vels ? vels[i] : undefined, accels ? accels[i] : undefined, executeAt, jerks ? jerks[i] : undefined) }))
+      }
       // can't know this anymore,
       lastAbsolute = null
+      lastSegmentUnit = null
     } catch (err) {
       console.error(err)
     }
   }
 
+  // per-actuator rates for a straight line from lastAbsolute to nextAbsolute,
+  let lineRates = (nextAbsolute, vel, accel) => {
+    // we're also going to need to know about each motor's abs-max velocities:
+    let absMaxVelocities = actuators.map(actu => actu.getAbsMaxVelocity())
+    let absMaxAccels = actuators.map(actu => actu.getAbsMaxAccel())
+    // and a unit vector... I know this should be explicit unitize-an-existing-vector, alas,
+    let unit = unitVector(lastAbsolute, nextAbsolute)
+    // these are our candidate vels & accels for the move,
+    let velocities = unit.map((u, i) => { return Math.abs(unit[i] * vel) })
+    let accels = unit.map((u, i) => { return Math.abs(unit[i] * accel) })
+    // but some vels or accels might be too large, check thru and assign the biggest-squish to everything,
+    let scaleFactor = 1.0
+    for (let a in actuators) {
+      if (velocities[a] > absMaxVelocities[a]) {
+        let candidateScale = absMaxVelocities[a] / velocities[a]
+        if (candidateScale < scaleFactor) scaleFactor = candidateScale;
+      }
+      if (accels[a] > absMaxAccels[a]) {
+        let candidateScale = absMaxAccels[a] / accels[a]
+        if (candidateScale < scaleFactor) scaleFactor = candidateScale;
+      }
+    }
+    // apply that factor to *both* vels and accels,
+    velocities = velocities.map(v => v * scaleFactor)
+    accels = accels.map(a => a * scaleFactor)
+    // and jerks, which split up along the line as accels do (so that the axes' ramps line up),
+    let jerks = lastJerk == null ? actuators.map(() => undefined) : unit.map(u => Math.abs(u * lastJerk) * scaleFactor)
+    // and the same, along the line itself,
+    return { velocities, accels, jerks, pathVel: vel * scaleFactor, pathAccel: accel * scaleFactor }
+  }
+
   // goto this absolute actuator-position
   let absolute = async (pos, vel, accel) => {
     try {
@@ -154,36 +295,72 @@ export default function createSynchronizer(actuators) {
       if (!lastAbsolute) lastAbsolute = await getPosition()
       // where we're going...
       let nextAbsolute = pos
-      // we're also going to need to know about each motor's abs-max velocities:
-      let absMaxVelocities = actuators.map(actu => actu.getAbsMaxVelocity())
-      let absMaxAccels = actuators.map(actu => actu.getAbsMaxAccel())
-      // and a unit vector... I know this should be explicit unitize-an-existing-vector, alas,
-      let unit = unitVector(lastAbsolute, nextAbsolute)
-      // these are our candidate vels & accels for the move,
-      let velocities = unit.map((u, i) => { return Math.abs(unit[i] * vel) })
-      let accels = unit.map((u, i) => { return Math.abs(unit[i] * accel) })
-      // but some vels or accels might be too large, check thru and assign the biggest-squish to everything,
-      let scaleFactor = 1.0
-      for (let a in actuators) {
-        if (velocities[a] > absMaxVelocities[a]) {
-          let candidateScale = absMaxVelocities[a] / velocities[a]
-          if (candidateScale < scaleFactor) scaleFactor = candidateScale;
-        }
-        if (accels[a] > absMaxAccels[a]) {
-          let candidateScale = absMaxAccels[a] / accels[a]
-          if (candidateScale < scaleFactor) scaleFactor = candidateScale;
-        }
-      }
-      // apply that factor to *both* vels and accels,
-      velocities = velocities.map(v => v * scaleFactor)
-      accels = accels.map(a => a * scaleFactor)
+      let { velocities, accels, jerks } = lineRates(nextAbsolute, vel, accel)
       // ok, sheesh, I think we can write 'em, do this with promise.all so that
       // each message dispatches ~ at the same time, thusly arriving ~ at the same time, to get-sync'd
+      // (and w/ an execute-at time, so that they start together even if they don't arrive together)
+      let executeAt = await startTime()
+      if (await groupSetup()) {
+        await writeGroupFrame(0, actuators.map((actu, i) => {
+          return actu.groupTargetSlice(nextAbsolute[i], velocities[i], accels[i], jerks[i])
+        }), executeAt)
+        await awaitMotionEnd()
+      } else {
+        await Promise.all(actuators.map((actu, i) => {
+          return actu.absolute(nextAbsolute[i], velocities[i], accels[i], executeAt, jerks[i])
+        }))
+      }
+      // motors each await-motion-end, when we await-all .absolute, so by this point we have made the move... can do
+      lastAbsolute = pos
+      lastSegmentUnit = null
+    } catch (err) {
+      console.error(err)
+    }
+  }
+
+  // the fastest we can take the corner between two lines, w/ grbl's "junction deviation": we pretend to round it off on an arc
+  // that passes within junctionDeviation of the corner, and go as fast as that arc allows at the path's accel (no faster than either line),
+  // but the corner's accel points along (unit - prevUnit), so it's also no more than any one axis' max accel, along that direction
+  let junctionVel = (prevUnit, unit, prevRates, rates) => {
+    let vel = Math.min(prevRates.pathVel, rates.pathVel)
+    let accel = Math.min(prevRates.pathAccel, rates.pathAccel)
+    let cosTheta = -unit.reduce((sum, u, i) => sum + u * prevUnit[i], 0)
+    // straight on, or straight back,
+    if (cosTheta < -SEGMENT_COLLINEAR) return vel
+    if (cosTheta > SEGMENT_COLLINEAR) return 0
+    let absMaxAccels = actuators.map(actu => actu.getAbsMaxAccel())
+    let junctionUnit = unitVector(prevUnit, unit)
+    for (let a in actuators) {
+      let share = Math.abs(junctionUnit[a])
+      if (share * accel > absMaxAccels[a]) accel = absMaxAccels[a] / share
+    }
+    let sinHalfTheta = Math.sqrt(0.5 * (1 - cosTheta))
+    return Math.min(vel, Math.sqrt(accel * junctionDeviation * sinHalfTheta / (1 - sinHalfTheta)))
+  }
+
+  // queue a straight line to this absolute actuator-position, without waiting for the move to finish,
+  // each axis gets the whole line (its length, and rates along it) as well as its own end, and runs the same profile along it as the others,
+  // so that they stay on the line, and turn the corners together... the junction speed into each line is planned here, from the corner's angle,
+  // and the firmware plans the rest (how fast we can go, and still slow down in time for what's queued after)
+  let segment = async (pos, vel, accel) => {
+    try {
+      vel ? lastVel = vel : vel = lastVel;
+      accel ? lastAccel = accel : accel = lastAccel;
+      if (!lastAbsolute) lastAbsolute = await getPosition()
+      // nowhere to go,
+      let length = distance(lastAbsolute, pos)
+      if (length == 0) return
+      let unit = unitVector(lastAbsolute, pos)
+      let rates = lineRates(pos, vel, accel)
+      // from rest, if the queue isn't running a line that we know of,
+      let junction = lastSegmentUnit ? junctionVel(lastSegmentUnit, unit, lastSegmentRates, rates) : 0
       await Promise.all(actuators.map((actu, i) => {
-        return actu.absolute(nextAbsolute[i], velocities[i], accels[i])
+        return actu.segment(pos[i], rates.pathVel, rates.pathAccel, length, junction)
       }))
-      // motors each await-motion-end, when we await-all .absolute, so by this point we have made the move... can do
+      // dead-reckoned, since the queue will get us there,
       lastAbsolute = pos
+      lastSegmentUnit = unit
+      lastSegmentRates = rates
     } catch (err) {
       console.error(err)
     }
@@ -230,9 +407,16 @@ export default function createSynchronizer(actuators) {
       velocities = velocities.map(v => v * scaleFactor)
       accels = accels.map(a => a * scaleFactor)
       // ok, we have a set of accels, now we can do like...
-      await Promise.all(actuators.map((actu, i) => {
-        return actu.velocity(velocities[i], accels[i])
-      }))
+      let executeAt = await startTime()
+      if (await groupSetup()) {
+        await writeGroupFrame(1, actuators.map((actu, i) => {
+          return actu.groupVelocitySlice(velocities[i], accels[i])
+        }), executeAt)
+      } else {
+        await Promise.all(actuators.map((actu, i) => {
+          return actu.velocity(velocities[i], accels[i], executeAt)
+        }))
+      }
     } catch (err) {
       console.error(err)
     }
@@ -245,6 +429,7 @@ export default function createSynchronizer(actuators) {
       await Promise.all(actuators.map(actu => actu.stop()))
       // (2) collect new position, given that some unknown amount of decelleration occured
       lastAbsolute = await getPosition()
+      lastSegmentUnit = null
     } catch (err) {
       console.error(err)
     }
@@ -255,15 +440,19 @@ export default function createSynchronizer(actuators) {
     actuators,
     // operate w/
     target,
+    segment,
     absolute,
     relative,
     velocity,
     stop,
     awaitMotionEnd,
+    syncClocks,
     // setters
     setPosition,
     setVelocity,
     setAccel,
+    setJerk,
+    setJunctionDeviation,
     // getters,
     getPosition,
     getVelocity,
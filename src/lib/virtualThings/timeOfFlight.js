@@ -13,15 +13,92 @@ no warranty is provided, and users accept all liability.
 import { TS } from "../osapjs/core/ts.js"
 import PK from "../osapjs/core/packets.js"
 
+// the VL53L1X's range status codes, 0 is the only one that means the range is good
+const RANGE_STATUS = {
+  0: "valid",
+  1: "sigmaFail",
+  2: "signalFail",
+  3: "validMinRangeClipped",
+  4: "outOfBoundsFail",
+  5: "hardwareFail",
+  6: "validNoWrapCheckFail",
+  7: "wrapTargetFail",
+  9: "xtalkSignalFail",
+  10: "synchronizationInt",
+  13: "minRangeFail",
+  255: "none",
+}
+
+// <range (uint16), status (uint8), signalRate (float32), age (uint32, us), sampleNum (uint32)>
+const readResult = (data) => {
+  let status = data[2];
+  return {
+    distance: TS.read("uint16", data, 0),
+    status,
+    statusName: RANGE_STATUS[status] || "unknown",
+    valid: status == 0,
+    signalRate: TS.read("float32", data, 3),
+    age: TS.read("uint32", data, 7) / 1000000,
+    sampleNum: TS.read("uint32", data, 11),
+  }
+}
+
 export default function(osap, vt, name) {
 
   let routeToFirmware = PK.VC2VMRoute(vt.route);
   let tofQuery = osap.query(PK.route(routeToFirmware).sib(1).end());
   // why not just an endpoint?
 
-  const setup = async () => { }
+  // the 2nd vertex pushes each new range, if we switch it on,
+  let pushEndpoint = osap.endpoint(`tofPushMirror_${name}`);
+  pushEndpoint.addRoute(PK.route(routeToFirmware).sib(2).end());
+  let pushRxEndpoint = osap.endpoint(`tofPushCatcher_${name}`);
+  let onRangeHandler = (range) => {
+    console.warn(`default range handler in ${name}, ${range.distance}mm`);
+  }
+  pushRxEndpoint.onData = (data) => {
+    onRangeHandler(readResult(data));
+  }
+
+  const setup = async () => {
+    try {
+      let source = vt.children[2];
+      try {
+        await osap.mvc.removeEndpointRoute(source.route, 0);
+      } catch (err) { }
+      await osap.mvc.setEndpointRoute(source.route, PK.route().sib(0).pfwd().sib(0).pfwd().sib(pushRxEndpoint.indice).end());
+    } catch (err) {
+      throw err;
+    }
+  }
+
+  let setPush = async (enable) => {
+    try {
+      let datagram = new Uint8Array([enable ? 1 : 0]);
+      await pushEndpoint.write(datagram, "acked");
+    } catch (err) {
+      console.error(err);
+    }
+  }
 
   return {
+    // the latest result, which the board already has on hand: age is how long ago (s) it was measured
+    readRange: async () => {
+      try {
+        const data = await tofQuery.pull();
+        return readResult(data);
+      } catch (err) {
+        console.error(err)
+      }
+    },
+    // calls the handler w/ each new result (as readRange) as the sensor makes them, ~ every 50ms
+    onRange: async (handler) => {
+      onRangeHandler = handler;
+      await setPush(true);
+    },
+    stopRanges: async () => {
+      await setPush(false);
+    },
     readDistance: async () => {
       try {
         const data = await tofQuery.pull();
@@ -40,6 +117,19 @@ export default function(osap, vt, name) {
         name: "readDistance",
         args: [],
         return: "millimeters"
+      },
+      {
+        name: "readRange",
+        args: [],
+        return: "{ distance (mm), status, statusName, valid, signalRate (MCPS), age (s), sampleNum }"
+      },
+      {
+        name: "onRange",
+        args: ["handler: (range) => void"]
+      },
+      {
+        name: "stopRanges",
+        args: []
       }
     ]
   }